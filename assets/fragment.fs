@@ -7,6 +7,12 @@
 varying vec4 vDiffuse, vGlobal, vAmbient;
 varying vec3 vNormal, vDir, vHalfVector;
 varying float fDist;
+
+// When set, the diffuse and ambient colours are tinted by the colour looked up in the palette
+uniform bool boPalette;
+uniform sampler1D tPalette;
+varying float fPaletteCoord;
+
 const float fEpsilon = 1e-6;
 
 #define swap(A,B) {int C = A; A = B; B = C;}
@@ -120,19 +126,26 @@ void main () {
 	vec3 dir;
 	float fNDotL;
 	float fNDotHV;
-	vec4 vColour = vGlobal;
+	vec4 vColour;
+	vec4 vTint;
 	float fAttenuation;
 	float fHueSteps = 88.0;
 	float fSteps = 2.0;
 	vec3 vRGB;
 	vec3 vHSV;
 
+	vTint = vec4 (1.0);
+	if (boPalette) {
+		vTint = texture1D (tPalette, fPaletteCoord);
+	}
+	vColour = vGlobal * vTint;
+
 	// Calculate dot product between normal and light direction
 	fNDotL = max (dot (vNormal, normalize (vDir)), 0.0);
 
 	if (fNDotL > 0.0) {
 		fAttenuation = 1.0 / (gl_LightSource[0].constantAttenuation + gl_LightSource[0].linearAttenuation * fDist + gl_LightSource[0].quadraticAttenuation * fDist * fDist);
-		vColour += fAttenuation * (vDiffuse * fNDotL + vAmbient);
+		vColour += fAttenuation * (vDiffuse * fNDotL + vAmbient) * vTint;
 
 		vHalf = normalize (vHalfVector);
 		fNDotHV = max (dot (vNormal, vHalf), 0.0);
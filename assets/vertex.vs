@@ -4,15 +4,158 @@ varying vec4 vDiffuse, vGlobal, vAmbient;
 varying vec3 vNormal, vDir, vHalfVector;
 varying float fDist;
 
+// When set, gl_Vertex holds a ring number and angle on a template tube, which is expanded
+// into a bezier tube using the per-instance control points
+// vTubeFrame holds the axis the tube's frame starts with and the twist spread along it, found on the CPU
+uniform bool boTube;
+uniform int nTubePieces;
+attribute vec4 vTubeStart;
+attribute vec3 vTubeStartDir, vTubeEnd, vTubeEndDir;
+attribute vec3 vTubeStartCol, vTubeEndCol;
+attribute vec4 vTubeFrame;
+
+// When set, gl_Vertex holds a position quantised within the bounds of the knot,
+// and the normal is octahedrally encoded in vCompactNormal
+uniform bool boCompact;
+uniform vec3 vCompactOffset, vCompactScale;
+attribute vec2 vCompactNormal;
+
+// The radius of the tubes, added on along the normal
+// Vertices generated on the CPU lie on the centreline of the tube if this is set
+uniform float fTubeRadius;
+
+// When set, the first two colour components hold the index of a colour in the palette,
+// a byte in each, which the fragment shader looks up
+// Copies of the tubes drawn elsewhere in the knot may take their colours from further along the palette
+uniform bool boPalette;
+uniform float fPaletteScale;
+uniform float fPaletteOffset;
+varying float fPaletteCoord;
+
+// Evaluate the bezier at a step along it
+vec3 TubePosition (float fStep) {
+	float fStepInv;
+
+	fStepInv = 1.0 - fStep;
+
+	return (fStepInv * fStepInv * fStepInv * vTubeStart.xyz) + (3.0 * fStepInv * fStepInv * fStep * vTubeStartDir) + (3.0 * fStepInv * fStep * fStep * vTubeEndDir) + (fStep * fStep * fStep * vTubeEnd);
+}
+
+// The unit direction of the bezier at a step, keeping the previous direction where it has none
+vec3 TubeTangent (float fStep, vec3 vPrevious) {
+	float fStepInv;
+	vec3 vTangent;
+
+	fStepInv = 1.0 - fStep;
+	vTangent = (3.0 * fStepInv * fStepInv * (vTubeStartDir - vTubeStart.xyz)) + (6.0 * fStepInv * fStep * (vTubeEndDir - vTubeStartDir)) + (3.0 * fStep * fStep * (vTubeEnd - vTubeEndDir));
+	if (length (vTangent) > 1.0e-6) {
+		vTangent = normalize (vTangent);
+	}
+	else {
+		vTangent = vPrevious;
+	}
+
+	return vTangent;
+}
+
+// Carry the frame axis from one ring to the next by double reflection, as ReflectFrameAxis in tube.c does
+vec3 ReflectFrameAxis (vec3 vAxis, vec3 vPos, vec3 vTangent, vec3 vPosNext, vec3 vTangentNext) {
+	vec3 vReflect;
+	float fLengthSquared;
+
+	vReflect = vPosNext - vPos;
+	fLengthSquared = dot (vReflect, vReflect);
+	if (fLengthSquared > 1.0e-12) {
+		vAxis -= (2.0 * dot (vReflect, vAxis) / fLengthSquared) * vReflect;
+		vTangent -= (2.0 * dot (vReflect, vTangent) / fLengthSquared) * vReflect;
+	}
+
+	vReflect = vTangentNext - vTangent;
+	fLengthSquared = dot (vReflect, vReflect);
+	if (fLengthSquared > 1.0e-12) {
+		vAxis -= (2.0 * dot (vReflect, vAxis) / fLengthSquared) * vReflect;
+	}
+
+	return vAxis;
+}
+
+// Unfold an octahedrally encoded normal
+// The lower half of the octahedron is folded out over the corners of the square
+vec3 DecodeNormal (vec2 vEncoded) {
+	vec3 vNormal;
+
+	vNormal = vec3 (vEncoded, 1.0 - abs (vEncoded.x) - abs (vEncoded.y));
+	if (vNormal.z < 0.0) {
+		vNormal.xy = (1.0 - abs (vNormal.yx)) * vec2 ((vNormal.x >= 0.0) ? 1.0 : -1.0, (vNormal.y >= 0.0) ? 1.0 : -1.0);
+	}
+
+	return normalize (vNormal);
+}
+
 void main() {	
 	vec4 vEyeCoordsPos;
 	vec3 vPos;
+	vec4 vVertex;
+	vec3 vVertexNormal;
+	vec4 vVertexColour;
+	float fStep;
+	float fTwist;
+	vec3 vTangent;
+	vec3 vPosPrev;
+	vec3 vTangentPrev;
+	vec3 vAxisSin;
+	vec3 vAxisCos;
+	int nRing;
+	int nPiece;
+
+	if (boTube) {
+		// Follow the rotation-minimising frame from the start of the tube to this vertex's ring, one piece at a time,
+		// so that the ring is oriented exactly as the tessellator would orient it
+		nRing = int (gl_Vertex.x + 0.5);
+		vPos = TubePosition (0.0);
+		vTangent = TubeTangent (0.0, vec3 (1.0, 0.0, 0.0));
+		vAxisSin = vTubeFrame.xyz;
+		for (nPiece = 1; nPiece <= nRing; nPiece++) {
+			fStep = float (nPiece) / float (nTubePieces);
+			vPosPrev = vPos;
+			vTangentPrev = vTangent;
+			vPos = TubePosition (fStep);
+			vTangent = TubeTangent (fStep, vTangentPrev);
+			vAxisSin = ReflectFrameAxis (vAxisSin, vPosPrev, vTangentPrev, vPos, vTangent);
+		}
+		fStep = float (nRing) / float (nTubePieces);
+
+		// The twist is spread evenly along the tube
+		fTwist = vTubeFrame.w * fStep;
+		vAxisCos = cross (vTangent, vAxisSin);
+		vVertexNormal = (sin (gl_Vertex.y + fTwist) * vAxisSin) + (cos (gl_Vertex.y + fTwist) * vAxisCos);
+		vVertex = vec4 (vPos + (vTubeStart.w * vVertexNormal), 1.0);
+		vVertexColour = vec4 (mix (vTubeStartCol, vTubeEndCol, fStep), 1.0);
+	}
+	else if (boCompact) {
+		vVertex = vec4 (vCompactOffset + (vCompactScale * gl_Vertex.xyz), 1.0);
+		vVertexNormal = DecodeNormal (vCompactNormal);
+		vVertexColour = gl_Color;
+	}
+	else {
+		vVertex = gl_Vertex;
+		vVertexNormal = gl_Normal;
+		vVertexColour = gl_Color;
+	}
+	vVertex.xyz += fTubeRadius * vVertexNormal;
+
+	// Lighting is calculated in white and tinted by the palette colour
+	fPaletteCoord = 0.0;
+	if (boPalette) {
+		fPaletteCoord = (floor ((vVertexColour.r * 255.0) + 0.5) + (256.0 * floor ((vVertexColour.g * 255.0) + 0.5)) + fPaletteOffset + 0.5) * fPaletteScale;
+		vVertexColour = vec4 (1.0);
+	}
 
 	// Transform normal to eye space
-	vNormal = normalize (gl_NormalMatrix * gl_Normal);
+	vNormal = normalize (gl_NormalMatrix * vVertexNormal);
 
 	// Normalise light direction, which is stored in eye space
-	vEyeCoordsPos = gl_ModelViewMatrix * gl_Vertex;
+	vEyeCoordsPos = gl_ModelViewMatrix * vVertex;
 	vPos = vec3 (gl_LightSource[0].position - vEyeCoordsPos);
 	vDir = normalize (vPos);
 
@@ -26,10 +169,10 @@ void main() {
 	//vDiffuse = gl_FrontMaterial.diffuse * gl_LightSource[0].diffuse * gl_Color;
 	//vAmbient = gl_FrontMaterial.ambient * gl_LightSource[0].ambient * gl_Color;
 	//vGlobal = gl_LightModel.ambient * gl_FrontMaterial.ambient * gl_Color;
-	vDiffuse = gl_LightSource[0].diffuse * gl_Color;
-	vAmbient = gl_LightSource[0].ambient * gl_Color;
-	vGlobal = gl_LightModel.ambient * gl_Color;
+	vDiffuse = gl_LightSource[0].diffuse * vVertexColour;
+	vAmbient = gl_LightSource[0].ambient * vVertexColour;
+	vGlobal = gl_LightModel.ambient * vVertexColour;
 	
-	gl_Position = gl_ProjectionMatrix * gl_ModelViewMatrix * gl_Vertex;	
+	gl_Position = gl_ProjectionMatrix * gl_ModelViewMatrix * vVertex;	
 }
 
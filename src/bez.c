@@ -14,6 +14,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <time.h>
 #include <dirent.h>
@@ -23,6 +24,7 @@
 #include <glib.h>
 
 #include "bez.h"
+#include "export.h"
 
 ///////////////////////////////////////////////////////////////////
 // Defines
@@ -32,6 +34,34 @@
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
+// Minimum number of bezier slots to reserve when the vertex arena grows
+#define ARENA_SLOTS_MIN (256)
+
+// Number of beziers in each block of the pool
+#define BEZIER_BLOCK (1024)
+
+// Number of indices used to draw each piece of a tube, including the two that join it to the previous strip
+#define INDICES_PER_PIECE(SEGMENTS) ((((SEGMENTS) + 1) * 2) + 2)
+
+// Number of consecutive arena slots that share a detail level
+#define CHUNK_SLOTS (64)
+
+// Position of a slot's index count and offset for a given detail level
+#define LEVEL_SLOT(LEVEL, SLOT, BEZDATA) (((LEVEL) * (BEZDATA)->nArenaSlots) + (SLOT))
+
+// Fraction by which a chunk's size must pass a detail level's threshold before the level changes
+#define LEVEL_HYSTERESIS (0.2f)
+
+// Number of per-bezier vertex attributes used when tubes are generated by the shader
+#define TUBE_ATTRIBS (7)
+
+// Largest number of palette colours that can be indexed, as each index is stored in two bytes
+#define PALETTE_INDEX_MAX (65536)
+
+// Size of each vertex and face in a binary export: the position and colour, and the corner count and indices
+#define PLY_VERTEX_SIZE ((3 * sizeof (float)) + BEZ_COL_COMPONENTS)
+#define PLY_FACE_SIZE (sizeof (unsigned char) + (3 * sizeof (int)))
+
 #ifdef WORDS_BIGENDIAN
 #define PLY_ENDIANNESS "binary_big_endian"
 #else
@@ -44,8 +74,47 @@
 typedef struct _BezStore BezStore;
 typedef struct _BezDetails BezDetails;
 
+// The control points and colours needed by the vertex shader to generate a tube
+// The frame axis and twist are those the tessellator starts the tube with, which the shader carries along it
+typedef struct _BezInstance {
+	Vector3 vStart;
+	float fRadius;
+	Vector3 vStartDir;
+	Vector3 vEnd;
+	Vector3 vEndDir;
+	float afStartCol[BEZ_COL_COMPONENTS];
+	float afEndCol[BEZ_COL_COMPONENTS];
+	Vector3 vAxis;
+	float fTwist;
+} BezInstance;
+
+// A bounding sphere for the tubes in a slot or chunk of slots
+// Empty slots have a negative radius
+// Slots set during a batch are marked as changed, and their chunks are marked as dirty when the batch ends
+typedef struct _BezBound {
+	Vector3 vCentre;
+	float fRadius;
+	float fTubeRadius;
+	bool boChanged;
+} BezBound;
+
+// Each copy of a chunk is at a different distance from the eye, so has its own detail level
+typedef struct _BezChunk {
+	BezBound sBound;
+	bool boDirty;
+	int anLevel[BEZ_COPIES_MAX + 1];
+} BezChunk;
+
+typedef struct _TubeAttrib {
+	char const * szName;
+	int nSize;
+	int nOffset;
+} TubeAttrib;
+
 struct _Bezier {
-	GLuint * auVertexBuffer;
+	int nSlot;
+	// Set for every bezier of a chain after the first, which is welded on to the bezier before it
+	bool boJoined;
 	Bezier * psNext;
 	Bezier * psPrev;
 };
@@ -57,20 +126,128 @@ struct _BezPersist {
 	Bezier * psBezierFirst;
 	Bezier * psBezierLast;
 	unsigned int uBeziers;
-	GLuint * auIndexBuffer;
+	GLuint uIndexBuffer;
+	// Size of the index buffer in bytes, which holds indices for a single slot if the tubes are instanced
+	int nIndexBufferSize;
+
+	// The beziers are kept in a pool of blocks that never move, so that pointers to them stay valid
+	// A bezier's index in the pool is the same as its slot in the arena, so the free slots are also the free beziers
+	Bezier ** apsBezierBlock;
+	int nBezierBlocks;
+
+	// Whether the list holds the beziers in slots zero upwards, in order, as left by ResetBeziers
+	bool boBeziersInOrder;
+	int nIndicesPerSlot;
 	BezStore * psBezierStore;
-};
 
-typedef struct _KnotVertex {
-	float fX;
-	float fY;
-	float fZ;
-	float fNX;
-	float fNY;
-	float fNZ;
-	float afColour[BEZ_COL_COMPONENTS];
-	//float fPadding[2];
-} KnotVertex;
+	// All beziers share a single vertex buffer, each using a fixed size slot within it
+	GLuint uVertexArena;
+	int nArenaSlots;
+	bool boArenaValid;
+	int nSlotsUsed;
+	int * anFreeSlots;
+	int nFreeSlots;
+	int nFreeSlotsMax;
+	KnotVertex * asScratch;
+
+	// While beziers are being set the arena and index buffer stay mapped, and are only unmapped
+	// when they're next needed by GL, so that the driver only has to synchronise once per batch
+	// During a batch, beziers may be set from other threads and their details are kept with their slots
+	char * pcArenaMapped;
+	GLuint * puIndexMapped;
+	bool boArenaStaged;
+	bool boIndexStaged;
+	int nArenaStagedSize;
+	int nIndexStagedSize;
+	bool boBatch;
+	BezDetails * asSlotDetails;
+
+	// When instanced, the arena holds control points rather than vertices
+	// and the tubes are generated from a template mesh by the vertex shader
+	// The shader carries the tessellator's frame along each tube, so the tubes look the same either way
+	bool boInstancedRequested;
+	bool boInstancedSupported;
+	bool boInstanced;
+	GLuint uTemplate;
+	GLint nTubeUniform;
+	GLint nTubePiecesUniform;
+	GLint anTubeAttrib[TUBE_ATTRIBS];
+
+	// Tubes that are joined on to the previous one can share its last ring rather than generating their own
+	bool boWeld;
+
+	// Otherwise the arena may hold vertices in the compact layout, if the shader can decode them
+	// Their positions are quantised within the bounds held by the tessellator
+	bool boCompactRequested;
+	bool boCompactSupported;
+	bool boCompact;
+	GLint nCompactUniform;
+	GLint nCompactOffsetUniform;
+	GLint nCompactScaleUniform;
+	GLint nCompactNormalAttrib;
+
+	// If the shader adds the radius on to the tubes, the arena holds the centreline of each ring along with
+	// its normals, so that the radius can be changed without the tubes having to be generated again
+	bool boShaderRadius;
+	GLint nRadiusUniform;
+	float fTubeRadius;
+
+	// If a palette is set, the first colour component of each bezier is the index of its colour in the palette
+	// If the shader can look colours up, the palette is kept in a texture and the indices are stored in the vertices,
+	// so that the colours can be changed without the tubes having to be generated again
+	// Palettes too large for the texture or the indices are looked up on the CPU instead
+	float * afPalette;
+	int nPaletteColours;
+	int nPaletteColoursMax;
+	bool boPaletteSupported;
+	int nPaletteLimit;
+	bool boPaletteTexture;
+	GLint nPaletteUniform;
+	GLint nPaletteScaleUniform;
+	GLint nPaletteSamplerUniform;
+	GLuint uPaletteTexture;
+	int nPaletteWidth;
+
+	// The vertices are generated on the CPU by the tessellator, which makes no GL calls of its own
+	TubePersist * psTubeData;
+
+	// If the tessellator has a tolerance set each bezier is split into only as many pieces as it needs,
+	// and only those pieces of its slot are drawn
+	// There's a count and offset for each detail level of each slot, found using LEVEL_SLOT
+	GLsizei * anIndexCount;
+	GLvoid const ** apIndexOffset;
+
+	// The first ring of each slot's tube, which is the last ring of another slot's if it's welded on to it
+	GLuint * auSlotFirstRing;
+
+	// Coarser detail levels draw a subset of each slot's rings and segments, chosen for each
+	// chunk of slots using its size on screen; level zero is always the full tessellation
+	int nLevels;
+	int anLevelSegments[BEZ_LEVELS_MAX];
+	int anLevelPieces[BEZ_LEVELS_MAX];
+	float afLevelPixels[BEZ_LEVELS_MAX];
+	int nLevelsUsed;
+	int anLevelStride[BEZ_LEVELS_MAX];
+	int anLevelPiecesMax[BEZ_LEVELS_MAX];
+	int anLevelOffset[BEZ_LEVELS_MAX];
+	float afLevelThreshold[BEZ_LEVELS_MAX];
+	BezBound * asSlotBound;
+	BezChunk * asChunk;
+	Vector3 vEye;
+	float fPixelScale;
+
+	// Beziers may also be drawn as transformed copies, each slot having a mask with a bit for each copy it's drawn in
+	// The copies are drawn from the same vertices, so only tubes tessellated on the CPU can be copied
+	int nCopies;
+	BezCopy asCopy[BEZ_COPIES_MAX];
+	unsigned int * auSlotCopies;
+	GLsizei * anCopyCount;
+	GLvoid const ** apCopyOffset;
+	GLint nPaletteOffsetUniform;
+
+	// Decimal places for positions in ASCII exports
+	int nExportPlaces;
+};
 
 struct _BezDetails {
 	Vector3 vStart;
@@ -80,14 +257,26 @@ struct _BezDetails {
 	float fRadius;
 	float afColourStart[BEZ_COL_COMPONENTS];
 	float afColourEnd[BEZ_COL_COMPONENTS];
-	BezDetails * psNext;
+	int nPieces;
+	unsigned int uCopies;
 };
 
+// The details of the beziers set while storing, kept for exporting
+// Each detail is held in an array of its own; the arrays are only ever grown, so that they're
+// reused each time the knot is rendered, and are emptied just by resetting the count
 struct _BezStore {
 	bool boStore;
-	BezDetails * psBezierFirst;
-	BezDetails * psBezierLast;
 	int nBezierNum;
+	int nBezierMax;
+	Vector3 * avStart;
+	Vector3 * avStartDir;
+	Vector3 * avEnd;
+	Vector3 * avEndDir;
+	float * afRadius;
+	float * afColourStart;
+	float * afColourEnd;
+	int * anPieces;
+	unsigned int * auCopies;
 };
 
 ///////////////////////////////////////////////////////////////////
@@ -97,20 +286,58 @@ static GLfloat gafDiffuse[] = { 0.5, 0.5, 1.0, 1.0 };
 static GLfloat gafSpecular[] = { 0.7, 0.7, 0.7, 1.0 };
 static GLfloat gafShininess[] = { 10.0 };
 
+static TubeAttrib const gasTubeAttrib[TUBE_ATTRIBS] = {
+	{"vTubeStart", 4, offsetof (BezInstance, vStart)},
+	{"vTubeStartDir", 3, offsetof (BezInstance, vStartDir)},
+	{"vTubeEnd", 3, offsetof (BezInstance, vEnd)},
+	{"vTubeEndDir", 3, offsetof (BezInstance, vEndDir)},
+	{"vTubeStartCol", BEZ_COL_COMPONENTS, offsetof (BezInstance, afStartCol)},
+	{"vTubeEndCol", BEZ_COL_COMPONENTS, offsetof (BezInstance, afEndCol)},
+	{"vTubeFrame", 4, offsetof (BezInstance, vAxis)}
+};
+
 ///////////////////////////////////////////////////////////////////
 // Function prototypes
 
-void DrawBezier (GLdouble fXCentre, GLdouble fYCentre, GLdouble fZCentre, Bezier * psBezier, BezPersist * psBezData);
-void ConvertTubeToBezier (KnotVertex * asVertex, int nPieces, int nSegments, float fRadius, Vector3 vStart, Vector3 vStartDir, Vector3 vEnd, Vector3 vEndDir, float const * afStartCol, float const * afEndCol);
-Matrix3 CreateRotationMatrix (Vector3 * pvNormal);
-GLuint * CreateBezierVertexBuffers (int nPieces, int nSegments);
-GLuint * CreateBezierIndexBuffers (int nPieces, int nSegments);
+void RecordBezierDetails (int nSlot, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, float fRadius, float const * afStartCol, float const * afEndCol, int nPieces, BezPersist * psBezData);
+float const * PaletteColour (float const * afColour, float * afResult, bool boEncode, BezPersist const * psBezData);
+int AllocateBezierSlot (BezPersist * psBezData);
+void GrowBezierSlots (int nSlots, BezPersist * psBezData);
+Bezier * PoolBezier (int nSlot, BezPersist * psBezData);
+void ReleaseBezierSlot (int nSlot, BezPersist * psBezData);
+void ReserveVertexArena (BezPersist * psBezData);
+void CreateArenaIndexBuffer (int nSlots, BezPersist * psBezData);
+void CreateTubeTemplate (BezPersist * psBezData);
+int ArenaSlotSize (BezPersist * psBezData);
+void MapVertexArena (BezPersist * psBezData);
+void UnmapVertexArena (BezPersist * psBezData);
 BezStore * NewBezStore ();
 void DeleteBezStore (BezStore * psBezStore);
-void StoreBezierDetails (Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, float fRadius, float const * afColourStart, float const* afColourEnd, BezStore * psBezStore);
+void StoreBezierDetails (Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, float fRadius, float const * afColourStart, float const* afColourEnd, int nPieces, unsigned int uCopies, BezStore * psBezStore);
+void FillBezierDetails (BezDetails * psBezDetails, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, float fRadius, float const * afColourStart, float const * afColourEnd, int nPieces, unsigned int uCopies);
+int CountBezierCopies (unsigned int uCopies, BezPersist const * psBezData);
+void TransformBezierDetails (BezDetails * psResult, BezDetails const * psBezDetails, BezCopy const * psCopy, BezPersist const * psBezData);
 void ClearStoredBezierDetails (BezStore * psBezStore);
-int OutputStoredVertices (FILE * hFile, int nPieces, int nSegments, BezDetails const * psBezDetails, bool boBinary);
-int OutputStoredIndices (FILE * hFile, int nPieces, int nSegments, int nOffset, BezDetails const * psBezDetails, bool boBinary);
+void GetStoredBezierDetails (int nBezier, BezDetails * psBezDetails, BezStore const * psBezStore);
+int StoredBezierPieces (int nBezier, BezPersist const * psBezData);
+int OutputStoredVertices (ExportBuffer * psBuffer, BezDetails const * psBezDetails, bool boBinary, BezPersist * psBezData);
+int OutputStoredIndices (ExportBuffer * psBuffer, int nPieces, int nSegments, int nFirstRing, int nOffset, bool boBinary);
+char * ReadVertexArena (BezPersist * psBezData);
+int ArenaSlotPieces (int nSlot, BezPersist const * psBezData);
+bool ArenaSlotWelded (int nSlot, BezPersist const * psBezData);
+void CountArenaVertices (int * anSlotVertex, int * pnVertices, int * pnFaces, BezPersist const * psBezData);
+void OutputArenaVertices (ExportBuffer * psBuffer, char const * pcArena, int const * anSlotVertex, bool boBinary, BezPersist const * psBezData);
+void OutputArenaIndices (ExportBuffer * psBuffer, int const * anSlotVertex, bool boBinary, BezPersist const * psBezData);
+void DecodeArenaVertex (char const * pcArena, int nVertex, BezCopy const * psCopy, Vector3 * pvPos, unsigned char * aucColour, BezPersist const * psBezData);
+void OutputExportVertex (Vector3 const * pvPos, unsigned char const * aucColour, bool boBinary, ExportBuffer * psBuffer);
+void OutputExportFace (int const * anIndex, bool boBinary, ExportBuffer * psBuffer);
+void ArrangeDetailLevels (BezPersist * psBezData);
+void CreateSlotLevelIndices (int nSlot, int nPieces, GLuint uFirstRing, BezPersist * psBezData);
+GLuint FindWeldedRing (Bezier const * psBezier, BezPersist const * psBezData);
+void SetSlotBound (int nSlot, float fRadius, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, BezPersist * psBezData);
+void UpdateChunkBound (int nChunk, BezPersist * psBezData);
+int ChooseChunkLevel (int nChunk, int nCopy, BezPersist * psBezData);
+void DrawBezierCopy (int nCopy, BezPersist * psBezData);
 
 ///////////////////////////////////////////////////////////////////
 // Function definitions
@@ -123,27 +350,162 @@ BezPersist * NewBezPersist (int nPieces, int nSegments) {
 	psBezData->psBezierFirst = NULL;
 	psBezData->psBezierLast = NULL;
 	psBezData->uBeziers = 0u;
+	psBezData->apsBezierBlock = NULL;
+	psBezData->nBezierBlocks = 0;
+	psBezData->boBeziersInOrder = TRUE;
 
-	// Initialise the index buffer
+	// The index buffer is created alongside the vertex arena
 	psBezData->nPieces = nPieces;
 	psBezData->nSegments = nSegments;
-	psBezData->auIndexBuffer = CreateBezierIndexBuffers (psBezData->nPieces, psBezData->nSegments);
+	psBezData->uIndexBuffer = 0;
+	psBezData->nIndexBufferSize = 0;
+	psBezData->nIndicesPerSlot = 0;
 	psBezData->uStartList = 0;
 	psBezData->psBezierStore = NewBezStore ();
 
+	// The vertex arena is allocated lazily once the number of beziers is known
+	psBezData->uVertexArena = 0;
+	psBezData->nArenaSlots = 0;
+	psBezData->boArenaValid = FALSE;
+	psBezData->nSlotsUsed = 0;
+	psBezData->anFreeSlots = NULL;
+	psBezData->nFreeSlots = 0;
+	psBezData->nFreeSlotsMax = 0;
+	psBezData->asScratch = g_new0 (KnotVertex, (nPieces + 1) * nSegments);
+	psBezData->pcArenaMapped = NULL;
+	psBezData->puIndexMapped = NULL;
+	psBezData->boArenaStaged = FALSE;
+	psBezData->boIndexStaged = FALSE;
+	psBezData->nArenaStagedSize = 0;
+	psBezData->nIndexStagedSize = 0;
+	psBezData->boBatch = FALSE;
+	psBezData->asSlotDetails = NULL;
+
+	// Tubes are tessellated on the CPU until a suitable shader is provided
+	psBezData->boInstancedRequested = FALSE;
+	psBezData->boInstancedSupported = FALSE;
+	psBezData->boInstanced = FALSE;
+	psBezData->uTemplate = 0;
+	psBezData->nTubeUniform = -1;
+
+	// Every tube has its own rings unless welding is switched on
+	psBezData->boWeld = FALSE;
+
+	// Vertices use the full size layout unless the compact one is asked for
+	psBezData->boCompactRequested = FALSE;
+	psBezData->boCompactSupported = FALSE;
+	psBezData->boCompact = FALSE;
+	psBezData->nCompactUniform = -1;
+	psBezData->nCompactOffsetUniform = -1;
+	psBezData->nCompactScaleUniform = -1;
+	psBezData->nCompactNormalAttrib = -1;
+
+	// The radius is added on the CPU unless the shader is able to do it
+	psBezData->boShaderRadius = FALSE;
+	psBezData->nRadiusUniform = -1;
+	psBezData->fTubeRadius = 0.0f;
+
+	// ASCII exports are written with a fixed number of decimal places
+	psBezData->nExportPlaces = EXPORT_PLACES_DEFAULT;
+
+	// Colours are used as they're given until a palette is set
+	psBezData->afPalette = NULL;
+	psBezData->nPaletteColours = 0;
+	psBezData->nPaletteColoursMax = 0;
+	psBezData->boPaletteSupported = FALSE;
+	psBezData->nPaletteLimit = 0;
+	psBezData->boPaletteTexture = FALSE;
+	psBezData->nPaletteUniform = -1;
+	psBezData->nPaletteScaleUniform = -1;
+	psBezData->nPaletteSamplerUniform = -1;
+	psBezData->uPaletteTexture = 0u;
+	psBezData->nPaletteWidth = 0;
+
+	psBezData->psTubeData = NewTubePersist (nPieces, nSegments);
+	psBezData->anIndexCount = NULL;
+	psBezData->apIndexOffset = NULL;
+	psBezData->auSlotFirstRing = NULL;
+
+	// Only the full tessellation is drawn until detail levels and a view are set
+	psBezData->nLevels = 1;
+	psBezData->asSlotBound = NULL;
+	psBezData->asChunk = NULL;
+	SetVector3 (psBezData->vEye, 0.0f, 0.0f, 0.0f);
+	psBezData->fPixelScale = 0.0f;
+	ArrangeDetailLevels (psBezData);
+
+	// Each bezier is only drawn once until copies are set
+	psBezData->nCopies = 0;
+	psBezData->auSlotCopies = NULL;
+	psBezData->anCopyCount = NULL;
+	psBezData->apCopyOffset = NULL;
+	psBezData->nPaletteOffsetUniform = -1;
+
 	return psBezData;
 }
 
 void DeleteBezPersist (BezPersist * psBezData) {
+	int nBlock;
+
 	// Free the beziers
 	while (psBezData->psBezierLast) {
 		DeleteBezier (psBezData->psBezierLast, psBezData);
 	}
+	for (nBlock = 0; nBlock < psBezData->nBezierBlocks; nBlock++) {
+		g_free (psBezData->apsBezierBlock[nBlock]);
+	}
+	g_free (psBezData->apsBezierBlock);
+	psBezData->apsBezierBlock = NULL;
+	psBezData->nBezierBlocks = 0;
 	
-	// Free the index buffers
-	glDeleteBuffers (psBezData->nPieces, psBezData->auIndexBuffer);
-	g_free (psBezData->auIndexBuffer);
-	psBezData->auIndexBuffer = NULL;
+	UnmapVertexArena (psBezData);
+
+	// Free the index buffer
+	if (psBezData->uIndexBuffer != 0) {
+		glDeleteBuffers (1, & psBezData->uIndexBuffer);
+		psBezData->uIndexBuffer = 0;
+		psBezData->nIndexBufferSize = 0;
+	}
+
+	// Free the vertex arena
+	if (psBezData->uVertexArena != 0) {
+		glDeleteBuffers (1, & psBezData->uVertexArena);
+		psBezData->uVertexArena = 0;
+	}
+	if (psBezData->uTemplate != 0) {
+		glDeleteBuffers (1, & psBezData->uTemplate);
+		psBezData->uTemplate = 0;
+	}
+	g_free (psBezData->anFreeSlots);
+	psBezData->anFreeSlots = NULL;
+	g_free (psBezData->asScratch);
+	psBezData->asScratch = NULL;
+	DeleteTubePersist (psBezData->psTubeData);
+	psBezData->psTubeData = NULL;
+	g_free (psBezData->anIndexCount);
+	psBezData->anIndexCount = NULL;
+	g_free (psBezData->apIndexOffset);
+	psBezData->apIndexOffset = NULL;
+	g_free (psBezData->auSlotFirstRing);
+	psBezData->auSlotFirstRing = NULL;
+	g_free (psBezData->afPalette);
+	psBezData->afPalette = NULL;
+	if (psBezData->uPaletteTexture != 0u) {
+		glDeleteTextures (1, & psBezData->uPaletteTexture);
+		psBezData->uPaletteTexture = 0u;
+	}
+	g_free (psBezData->asSlotDetails);
+	psBezData->asSlotDetails = NULL;
+	g_free (psBezData->asSlotBound);
+	psBezData->asSlotBound = NULL;
+	g_free (psBezData->asChunk);
+	psBezData->asChunk = NULL;
+	g_free (psBezData->auSlotCopies);
+	psBezData->auSlotCopies = NULL;
+	g_free (psBezData->anCopyCount);
+	psBezData->anCopyCount = NULL;
+	g_free (psBezData->apCopyOffset);
+	psBezData->apCopyOffset = NULL;
 
 	// Free the bezier store
 	DeleteBezStore (psBezData->psBezierStore);
@@ -153,10 +515,16 @@ void DeleteBezPersist (BezPersist * psBezData) {
 
 Bezier * NewBezier (BezPersist * psBezData) {
 	Bezier * psBezier;
+	int nSlot;
 
 	g_assert (psBezData);
 
-	psBezier = g_new0 (Bezier, 1);
+	// Claim a slot in the shared vertex arena, which also decides where the bezier lives in the pool
+	nSlot = AllocateBezierSlot (psBezData);
+	psBezier = PoolBezier (nSlot, psBezData);
+	psBezData->boBeziersInOrder = (psBezData->boBeziersInOrder && (nSlot == (int)psBezData->uBeziers));
+	psBezier->nSlot = nSlot;
+	psBezier->boJoined = FALSE;
 	
 	// Link the structure into the linked list
 	psBezier->psNext = NULL;
@@ -172,19 +540,98 @@ Bezier * NewBezier (BezPersist * psBezData) {
 		psBezData->psBezierLast = psBezier;
 	}
 
-	// Initialise the vertex buffer
-	psBezier->auVertexBuffer = CreateBezierVertexBuffers (psBezData->nPieces, psBezData->nSegments);
-
 	psBezData->uBeziers++;
 
 	return psBezier;
 }
 
+// Change the number of beziers to nBeziers, linked in order and using the slots from zero upwards
+// If the beziers are already like this, only the difference is added or removed from the end, and those that are kept
+// hold on to their contents until they're set again; otherwise they're all replaced and nothing is drawn until they're set
+// Nothing is allocated or freed for the individual beziers, so this is much quicker than deleting and creating them
+// Any pointers to beziers that are removed are no longer valid afterwards
+Bezier * ResetBeziers (int nBeziers, BezPersist * psBezData) {
+	Bezier * psBezier;
+	Bezier * psBezierPrev;
+	int nSlot;
+	int nSlotsKept;
+	int nSlotsCleared;
+	int nLevel;
+
+	if (psBezData->boBeziersInOrder) {
+		nSlotsKept = MIN ((int)psBezData->uBeziers, nBeziers);
+	}
+	else {
+		nSlotsKept = 0;
+	}
+
+	// Nothing is drawn from the slots that aren't kept
+	nSlotsCleared = MIN (psBezData->nSlotsUsed, psBezData->nArenaSlots);
+	for (nLevel = 0; nLevel < BEZ_LEVELS_MAX; nLevel++) {
+		if (nSlotsCleared > nSlotsKept) {
+			memset (psBezData->anIndexCount + LEVEL_SLOT (nLevel, nSlotsKept, psBezData), 0, (nSlotsCleared - nSlotsKept) * sizeof (GLsizei));
+		}
+	}
+	for (nSlot = nSlotsKept; nSlot < nSlotsCleared; nSlot++) {
+		psBezData->asSlotBound[nSlot].fRadius = -1.0f;
+		psBezData->auSlotCopies[nSlot] = 0u;
+		psBezData->asChunk[nSlot / CHUNK_SLOTS].boDirty = TRUE;
+	}
+
+	psBezData->nSlotsUsed = nBeziers;
+	psBezData->nFreeSlots = 0;
+	psBezData->uBeziers = nBeziers;
+	psBezData->boBeziersInOrder = TRUE;
+
+	if (nBeziers > 0) {
+		GrowBezierSlots (nBeziers, psBezData);
+
+		// Link on any new beziers after those that are kept
+		psBezierPrev = ((nSlotsKept > 0) ? PoolBezier (nSlotsKept - 1, psBezData) : NULL);
+		for (nSlot = nSlotsKept; nSlot < nBeziers; nSlot++) {
+			psBezier = PoolBezier (nSlot, psBezData);
+			psBezier->nSlot = nSlot;
+			psBezier->boJoined = FALSE;
+			psBezier->psPrev = psBezierPrev;
+			if (psBezierPrev) {
+				psBezierPrev->psNext = psBezier;
+			}
+			psBezierPrev = psBezier;
+		}
+
+		psBezData->psBezierFirst = PoolBezier (0, psBezData);
+		psBezData->psBezierLast = PoolBezier (nBeziers - 1, psBezData);
+		psBezData->psBezierLast->psNext = NULL;
+	}
+	else {
+		psBezData->psBezierFirst = NULL;
+		psBezData->psBezierLast = NULL;
+	}
+
+	return psBezData->psBezierFirst;
+}
+
+// Find the bezier in the pool for a slot, adding more blocks to the pool if necessary
+Bezier * PoolBezier (int nSlot, BezPersist * psBezData) {
+	int nBlocks;
+	int nBlock;
+
+	if ((nSlot / BEZIER_BLOCK) >= psBezData->nBezierBlocks) {
+		nBlocks = (nSlot / BEZIER_BLOCK) + 1;
+		psBezData->apsBezierBlock = g_renew (Bezier *, psBezData->apsBezierBlock, nBlocks);
+		for (nBlock = psBezData->nBezierBlocks; nBlock < nBlocks; nBlock++) {
+			psBezData->apsBezierBlock[nBlock] = g_new0 (Bezier, BEZIER_BLOCK);
+		}
+		psBezData->nBezierBlocks = nBlocks;
+	}
+
+	return & psBezData->apsBezierBlock[nSlot / BEZIER_BLOCK][nSlot % BEZIER_BLOCK];
+}
+
 void DeleteBezier (Bezier * psBezier, BezPersist * psBezData) {
-	// Free the vertex buffers
-	glDeleteBuffers (1, psBezier->auVertexBuffer);
-	free (psBezier->auVertexBuffer);
-	psBezier->auVertexBuffer = NULL;
+	// Return the slot to the vertex arena
+	ReleaseBezierSlot (psBezier->nSlot, psBezData);
+	psBezier->nSlot = -1;
 
 	if (psBezier->psPrev) {
 		psBezier->psPrev->psNext = psBezier->psNext;
@@ -199,41 +646,553 @@ void DeleteBezier (Bezier * psBezier, BezPersist * psBezData) {
 	else {
 		psBezData->psBezierLast = psBezier->psPrev;
 	}
-	g_free (psBezier);	
+	// The bezier stays in the pool, ready for its slot to be reused
+	psBezData->boBeziersInOrder = ((psBezData->boBeziersInOrder && (psBezier->psNext == NULL)) || (psBezData->uBeziers <= 1));
+	psBezier->psNext = NULL;
+	psBezier->psPrev = NULL;
 
 	psBezData->uBeziers--;
 }
 
+int AllocateBezierSlot (BezPersist * psBezData) {
+	int nSlot;
+
+	if (psBezData->nFreeSlots > 0) {
+		// Reuse a slot left behind by a deleted bezier
+		psBezData->nFreeSlots--;
+		nSlot = psBezData->anFreeSlots[psBezData->nFreeSlots];
+	}
+	else {
+		nSlot = psBezData->nSlotsUsed;
+		psBezData->nSlotsUsed++;
+	}
+	GrowBezierSlots (nSlot + 1, psBezData);
+
+	return nSlot;
+}
+
+// Make sure there's room for at least nSlots slots
+// The arena is grown, but the buffer itself is only reallocated when it's next needed
+void GrowBezierSlots (int nSlots, BezPersist * psBezData) {
+	if (nSlots > psBezData->nArenaSlots) {
+		psBezData->nArenaSlots = MAX (2 * psBezData->nArenaSlots, MAX (nSlots, ARENA_SLOTS_MIN));
+		psBezData->anIndexCount = g_renew (GLsizei, psBezData->anIndexCount, BEZ_LEVELS_MAX * psBezData->nArenaSlots);
+		psBezData->apIndexOffset = g_renew (GLvoid const *, psBezData->apIndexOffset, BEZ_LEVELS_MAX * psBezData->nArenaSlots);
+		psBezData->auSlotFirstRing = g_renew (GLuint, psBezData->auSlotFirstRing, psBezData->nArenaSlots);
+		psBezData->asSlotBound = g_renew (BezBound, psBezData->asSlotBound, psBezData->nArenaSlots);
+		psBezData->asSlotDetails = g_renew (BezDetails, psBezData->asSlotDetails, psBezData->nArenaSlots);
+		psBezData->auSlotCopies = g_renew (unsigned int, psBezData->auSlotCopies, psBezData->nArenaSlots);
+		psBezData->anCopyCount = g_renew (GLsizei, psBezData->anCopyCount, psBezData->nArenaSlots);
+		psBezData->apCopyOffset = g_renew (GLvoid const *, psBezData->apCopyOffset, psBezData->nArenaSlots);
+		psBezData->asChunk = g_renew (BezChunk, psBezData->asChunk, (psBezData->nArenaSlots + CHUNK_SLOTS - 1) / CHUNK_SLOTS);
+		psBezData->boArenaValid = FALSE;
+	}
+}
+
+void ReleaseBezierSlot (int nSlot, BezPersist * psBezData) {
+	int nSlotSize;
+	int nLevel;
+
+	// Nothing is drawn from the slot until it's reused
+	for (nLevel = 0; nLevel < BEZ_LEVELS_MAX; nLevel++) {
+		psBezData->anIndexCount[LEVEL_SLOT (nLevel, nSlot, psBezData)] = 0;
+	}
+	psBezData->asSlotBound[nSlot].fRadius = -1.0f;
+	psBezData->auSlotCopies[nSlot] = 0u;
+	psBezData->asChunk[nSlot / CHUNK_SLOTS].boDirty = TRUE;
+
+	if (psBezData->uBeziers <= 1) {
+		// This was the last bezier, so the whole arena is available again
+		psBezData->nSlotsUsed = 0;
+		psBezData->nFreeSlots = 0;
+	}
+	else if (nSlot == (psBezData->nSlotsUsed - 1)) {
+		psBezData->nSlotsUsed--;
+	}
+	else {
+		// Instanced slots are always drawn, so collapse the tube to nothing
+		if (psBezData->boArenaValid && psBezData->boInstanced) {
+			nSlotSize = ArenaSlotSize (psBezData);
+			MapVertexArena (psBezData);
+			memset (psBezData->pcArenaMapped + (nSlot * nSlotSize), 0, nSlotSize);
+		}
+
+		if (psBezData->nFreeSlots >= psBezData->nFreeSlotsMax) {
+			psBezData->nFreeSlotsMax = MAX (2 * psBezData->nFreeSlotsMax, ARENA_SLOTS_MIN);
+			psBezData->anFreeSlots = g_renew (int, psBezData->anFreeSlots, psBezData->nFreeSlotsMax);
+		}
+		psBezData->anFreeSlots[psBezData->nFreeSlots] = nSlot;
+		psBezData->nFreeSlots++;
+	}
+}
+
+// Make sure the vertex arena is large enough for all of the slots
+// Reallocating discards the arena contents, so beziers must be set again afterwards
+void ReserveVertexArena (BezPersist * psBezData) {
+	int nSlot;
+	int nSlotSize;
+	int nLevel;
+	int nChunk;
+	char * acEmpty;
+
+	if (!psBezData->boArenaValid) {
+		UnmapVertexArena (psBezData);
+
+		if (psBezData->uVertexArena == 0) {
+			glGenBuffers (1, & psBezData->uVertexArena);
+			g_assert (psBezData->uVertexArena > 0);
+		}
+
+		// Start from zeroed slots so that any unused slots draw nothing
+		nSlotSize = ArenaSlotSize (psBezData);
+		acEmpty = g_new0 (char, psBezData->nArenaSlots * nSlotSize);
+		glBindBuffer (GL_ARRAY_BUFFER, psBezData->uVertexArena);
+		glBufferData (GL_ARRAY_BUFFER, psBezData->nArenaSlots * nSlotSize, acEmpty, GL_DYNAMIC_DRAW);
+		g_free (acEmpty);
+
+		if (psBezData->boInstanced) {
+			// Every instance is drawn using the indices of a single tube
+			CreateTubeTemplate (psBezData);
+			CreateArenaIndexBuffer (1, psBezData);
+		}
+		else {
+			CreateArenaIndexBuffer (psBezData->nArenaSlots, psBezData);
+		}
+
+		// Slots are empty until their beziers are set
+		for (nSlot = 0; nSlot < psBezData->nArenaSlots; nSlot++) {
+			for (nLevel = 0; nLevel < BEZ_LEVELS_MAX; nLevel++) {
+				psBezData->anIndexCount[LEVEL_SLOT (nLevel, nSlot, psBezData)] = 0;
+				psBezData->apIndexOffset[LEVEL_SLOT (nLevel, nSlot, psBezData)] = BUFFER_OFFSET (((nSlot * psBezData->nIndicesPerSlot) + psBezData->anLevelOffset[nLevel]) * sizeof (GLuint));
+			}
+			psBezData->asSlotBound[nSlot].fRadius = -1.0f;
+			psBezData->asSlotBound[nSlot].boChanged = FALSE;
+			psBezData->asSlotDetails[nSlot].nPieces = 0;
+			psBezData->auSlotCopies[nSlot] = 0u;
+		}
+		for (nChunk = 0; nChunk < (psBezData->nArenaSlots + CHUNK_SLOTS - 1) / CHUNK_SLOTS; nChunk++) {
+			psBezData->asChunk[nChunk].boDirty = TRUE;
+			memset (psBezData->asChunk[nChunk].anLevel, 0, sizeof (psBezData->asChunk[nChunk].anLevel));
+		}
+		psBezData->boArenaValid = TRUE;
+	}
+}
+
+// The number of bytes used by each bezier in the arena
+int ArenaSlotSize (BezPersist * psBezData) {
+	int nSlotSize;
+
+	if (psBezData->boInstanced) {
+		nSlotSize = sizeof (BezInstance);
+	}
+	else if (psBezData->boCompact) {
+		nSlotSize = (psBezData->nPieces + 1) * psBezData->nSegments * sizeof (CompactVertex);
+	}
+	else {
+		nSlotSize = (psBezData->nPieces + 1) * psBezData->nSegments * sizeof (KnotVertex);
+	}
+
+	return nSlotSize;
+}
+
+// Map the arena and index buffer so that beziers can be written straight into them
+// If a buffer can't be mapped, its contents are copied into memory and copied back when it's unmapped
+void MapVertexArena (BezPersist * psBezData) {
+	int nSize;
+
+	if (psBezData->pcArenaMapped == NULL) {
+		glBindBuffer (GL_ARRAY_BUFFER, psBezData->uVertexArena);
+		psBezData->pcArenaMapped = (char *)glMapBuffer (GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+		psBezData->boArenaStaged = (psBezData->pcArenaMapped == NULL);
+		if (psBezData->boArenaStaged) {
+			nSize = psBezData->nArenaSlots * ArenaSlotSize (psBezData);
+			psBezData->pcArenaMapped = g_new (char, nSize);
+			psBezData->nArenaStagedSize = nSize;
+			glGetBufferSubData (GL_ARRAY_BUFFER, 0, nSize, psBezData->pcArenaMapped);
+		}
+	}
+
+	if (psBezData->puIndexMapped == NULL) {
+		glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, psBezData->uIndexBuffer);
+		psBezData->puIndexMapped = (GLuint *)glMapBuffer (GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY);
+		psBezData->boIndexStaged = (psBezData->puIndexMapped == NULL);
+		if (psBezData->boIndexStaged) {
+			nSize = psBezData->nIndexBufferSize;
+			psBezData->puIndexMapped = (GLuint *)g_new (char, nSize);
+			psBezData->nIndexStagedSize = nSize;
+			glGetBufferSubData (GL_ELEMENT_ARRAY_BUFFER, 0, nSize, psBezData->puIndexMapped);
+		}
+	}
+}
+
+// The buffers must be unmapped before they're drawn from or reallocated
+void UnmapVertexArena (BezPersist * psBezData) {
+	bool boIntact;
+
+	boIntact = TRUE;
+	if (psBezData->pcArenaMapped) {
+		glBindBuffer (GL_ARRAY_BUFFER, psBezData->uVertexArena);
+		if (psBezData->boArenaStaged) {
+			glBufferSubData (GL_ARRAY_BUFFER, 0, psBezData->nArenaStagedSize, psBezData->pcArenaMapped);
+			g_free (psBezData->pcArenaMapped);
+		}
+		else {
+			boIntact = glUnmapBuffer (GL_ARRAY_BUFFER) && boIntact;
+		}
+		psBezData->pcArenaMapped = NULL;
+	}
+	if (psBezData->puIndexMapped) {
+		glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, psBezData->uIndexBuffer);
+		if (psBezData->boIndexStaged) {
+			glBufferSubData (GL_ELEMENT_ARRAY_BUFFER, 0, psBezData->nIndexStagedSize, psBezData->puIndexMapped);
+			g_free (psBezData->puIndexMapped);
+		}
+		else {
+			boIntact = glUnmapBuffer (GL_ELEMENT_ARRAY_BUFFER) && boIntact;
+		}
+		psBezData->puIndexMapped = NULL;
+	}
+
+	if (!boIntact) {
+		fprintf (stderr, "Bezier buffer contents were lost while mapped; the knot must be regenerated.\n");
+	}
+}
+
+// Prepare for beziers to be set from several threads at once
+// Until EndBezierBatch is called, only SetBezierControlPoints and SetBezierChain may be used, and each bezier must be set by only one thread
+void BeginBezierBatch (BezPersist * psBezData) {
+	ReserveVertexArena (psBezData);
+	MapVertexArena (psBezData);
+	psBezData->boBatch = TRUE;
+}
+
+// Store the details of the beziers set during the batch in slot order,
+// so that they're the same however the work was shared between threads
+// The chunks of the slots that were set are marked here too, as a chunk's slots may have been set by different threads
+void EndBezierBatch (BezPersist * psBezData) {
+	BezDetails * psBezDetails;
+	int nSlot;
+
+	for (nSlot = 0; nSlot < psBezData->nSlotsUsed; nSlot++) {
+		if (psBezData->asSlotBound[nSlot].boChanged) {
+			psBezData->asChunk[nSlot / CHUNK_SLOTS].boDirty = TRUE;
+			psBezData->asSlotBound[nSlot].boChanged = FALSE;
+		}
+		psBezDetails = & psBezData->asSlotDetails[nSlot];
+		if (psBezDetails->nPieces > 0) {
+			StoreBezierDetails (& psBezDetails->vStart, & psBezDetails->vStartDir, & psBezDetails->vEnd, & psBezDetails->vEndDir, psBezDetails->fRadius, psBezDetails->afColourStart, psBezDetails->afColourEnd, psBezDetails->nPieces, psBezDetails->uCopies, psBezData->psBezierStore);
+			psBezDetails->nPieces = 0;
+		}
+	}
+
+	psBezData->boBatch = FALSE;
+}
+
+// Find which of the optional vertex layouts and features the shader supports
+// Tubes are only generated by the shader if that's also asked for using SetBezierInstanced
+// All beziers must be regenerated after calling this, as the arena is reallocated
+void SetBezierShader (GLuint uProgram, BezPersist * psBezData) {
+	int nAttrib;
+	bool boFound;
+
+	boFound = FALSE;
+	if ((uProgram != 0u) && GLEE_ARB_instanced_arrays) {
+		psBezData->nTubeUniform = glGetUniformLocation (uProgram, "boTube");
+		psBezData->nTubePiecesUniform = glGetUniformLocation (uProgram, "nTubePieces");
+		boFound = (psBezData->nTubeUniform >= 0) && (psBezData->nTubePiecesUniform >= 0);
+		for (nAttrib = 0; nAttrib < TUBE_ATTRIBS; nAttrib++) {
+			psBezData->anTubeAttrib[nAttrib] = glGetAttribLocation (uProgram, gasTubeAttrib[nAttrib].szName);
+			if (psBezData->anTubeAttrib[nAttrib] < 0) {
+				boFound = FALSE;
+			}
+		}
+	}
+
+	if (psBezData->boInstancedRequested && !boFound) {
+		fprintf (stderr, "Shader doesn't support tube generation; using CPU tessellation.\n");
+	}
+
+	// CPU tessellated vertices can only be stored compactly if the shader decodes them
+	psBezData->boCompactSupported = FALSE;
+	if (uProgram != 0u) {
+		psBezData->nCompactUniform = glGetUniformLocation (uProgram, "boCompact");
+		psBezData->nCompactOffsetUniform = glGetUniformLocation (uProgram, "vCompactOffset");
+		psBezData->nCompactScaleUniform = glGetUniformLocation (uProgram, "vCompactScale");
+		psBezData->nCompactNormalAttrib = glGetAttribLocation (uProgram, "vCompactNormal");
+		psBezData->boCompactSupported = (psBezData->nCompactUniform >= 0) && (psBezData->nCompactOffsetUniform >= 0) && (psBezData->nCompactScaleUniform >= 0) && (psBezData->nCompactNormalAttrib >= 0);
+	}
+
+	// Vertices can be left on the centreline if the shader adds the radius
+	psBezData->boShaderRadius = FALSE;
+	if (uProgram != 0u) {
+		psBezData->nRadiusUniform = glGetUniformLocation (uProgram, "fTubeRadius");
+		psBezData->boShaderRadius = (psBezData->nRadiusUniform >= 0);
+	}
+
+	// Palette indices can be stored in the vertices if the shader looks up their colours
+	psBezData->boPaletteSupported = FALSE;
+	if (uProgram != 0u) {
+		psBezData->nPaletteUniform = glGetUniformLocation (uProgram, "boPalette");
+		psBezData->nPaletteScaleUniform = glGetUniformLocation (uProgram, "fPaletteScale");
+		psBezData->nPaletteSamplerUniform = glGetUniformLocation (uProgram, "tPalette");
+		psBezData->boPaletteSupported = (psBezData->nPaletteUniform >= 0) && (psBezData->nPaletteScaleUniform >= 0) && (psBezData->nPaletteSamplerUniform >= 0);
+		psBezData->nPaletteOffsetUniform = glGetUniformLocation (uProgram, "fPaletteOffset");
+	}
+
+	// The palette must fit in a single row of the texture as well as in the indices
+	psBezData->nPaletteLimit = 0;
+	if (psBezData->boPaletteSupported) {
+		glGetIntegerv (GL_MAX_TEXTURE_SIZE, & psBezData->nPaletteLimit);
+		psBezData->nPaletteLimit = MIN (psBezData->nPaletteLimit, PALETTE_INDEX_MAX);
+	}
+	psBezData->boPaletteTexture = psBezData->boPaletteSupported && (psBezData->nPaletteColours <= psBezData->nPaletteLimit);
+
+	psBezData->boInstancedSupported = boFound;
+	psBezData->boInstanced = psBezData->boInstancedRequested && psBezData->boInstancedSupported;
+	psBezData->boCompact = psBezData->boCompactRequested && psBezData->boCompactSupported;
+	psBezData->boArenaValid = FALSE;
+	ArrangeDetailLevels (psBezData);
+}
+
+// Generate the tubes in the vertex shader, if it's able to, rather than tessellating them on the CPU
+// The shader follows the same frame along each tube as the tessellator, but always uses the full number of pieces,
+// and its tubes can't be welded, copied or drawn at coarser levels
+// All beziers must be regenerated after calling this
+void SetBezierInstanced (bool boInstanced, BezPersist * psBezData) {
+	if (boInstanced && !psBezData->boInstancedSupported) {
+		fprintf (stderr, "Shader doesn't support tube generation; using CPU tessellation.\n");
+	}
+
+	psBezData->boInstancedRequested = boInstanced;
+	psBezData->boInstanced = boInstanced && psBezData->boInstancedSupported;
+	psBezData->boArenaValid = FALSE;
+	ArrangeDetailLevels (psBezData);
+}
+
+// Store CPU tessellated vertices in the compact layout, if the shader is able to decode it
+// This uses less than half of the memory, but positions are only as accurate as the quantisation of the bounds
+// All beziers must be regenerated after calling this, as the arena is reallocated
+void SetBezierCompact (bool boCompact, BezPersist * psBezData) {
+	if (boCompact && !psBezData->boCompactSupported) {
+		fprintf (stderr, "Shader doesn't support compact vertices; using full size vertices.\n");
+	}
+
+	psBezData->boCompactRequested = boCompact;
+	psBezData->boCompact = boCompact && psBezData->boCompactSupported;
+	psBezData->boArenaValid = FALSE;
+}
+
+// Set the radius of the tubes, used in place of the radius they were set with if the shader adds it on
+// Returns TRUE if the shader can't add the radius, in which case the beziers must be regenerated with it
+bool SetBezierRadius (float fRadius, BezPersist * psBezData) {
+	psBezData->fTubeRadius = fRadius;
+
+	return !psBezData->boShaderRadius;
+}
+
+// Set the colours that beziers are given indices into, or clear the palette if there are no colours
+// Returns TRUE if the shader can't look up the colours, in which case the beziers must be regenerated to use them
+// The colours are looked up on the CPU if there are more than GetBezierPaletteLimit allows
+bool SetBezierPalette (int nColours, float const * afColours, BezPersist * psBezData) {
+	int nWidth;
+	bool boTexture;
+	bool boRegenerate;
+
+	if (nColours > psBezData->nPaletteColoursMax) {
+		psBezData->nPaletteColoursMax = nColours;
+		psBezData->afPalette = g_renew (float, psBezData->afPalette, nColours * BEZ_COL_COMPONENTS);
+	}
+	if (nColours > 0) {
+		memcpy (psBezData->afPalette, afColours, nColours * BEZ_COL_COMPONENTS * sizeof (float));
+	}
+	psBezData->nPaletteColours = nColours;
+
+	// If the palette doesn't fit, its colours are stored in the vertices in place of the indices,
+	// so the vertices also have to be regenerated when it starts to fit again
+	boTexture = psBezData->boPaletteSupported && (nColours <= psBezData->nPaletteLimit);
+	boRegenerate = !boTexture || !psBezData->boPaletteTexture;
+	psBezData->boPaletteTexture = boTexture;
+
+	if (boTexture && (nColours > 0)) {
+		// The texture is only reallocated if the palette no longer fits in it
+		nWidth = 1;
+		while (nWidth < nColours) {
+			nWidth *= 2;
+		}
+		nWidth = MIN (nWidth, psBezData->nPaletteLimit);
+
+		if (psBezData->uPaletteTexture == 0u) {
+			glGenTextures (1, & psBezData->uPaletteTexture);
+		}
+		glBindTexture (GL_TEXTURE_1D, psBezData->uPaletteTexture);
+		if (nWidth != psBezData->nPaletteWidth) {
+			glTexParameteri (GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri (GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri (GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexImage1D (GL_TEXTURE_1D, 0, GL_RGB8, nWidth, 0, GL_RGB, GL_FLOAT, NULL);
+			psBezData->nPaletteWidth = nWidth;
+		}
+		glTexSubImage1D (GL_TEXTURE_1D, 0, 0, nColours, GL_RGB, GL_FLOAT, afColours);
+		glBindTexture (GL_TEXTURE_1D, 0);
+	}
+
+	return boRegenerate;
+}
+
+// The most colours a palette can have for the shader to look them up
+// Copies that take their colours from further along the palette need the whole palette to be within this
+int GetBezierPaletteLimit (BezPersist const * psBezData) {
+	return psBezData->nPaletteLimit;
+}
+
+// Find the colour to store for a bezier, which if there's a palette is the colour its first component indexes
+// If the index is to be looked up by the shader, it's stored instead as a byte in each of the first two components
+float const * PaletteColour (float const * afColour, float * afResult, bool boEncode, BezPersist const * psBezData) {
+	int nIndex;
+
+	if (psBezData->nPaletteColours > 0) {
+		nIndex = CLAMP ((int)afColour[0], 0, psBezData->nPaletteColours - 1);
+		if (boEncode && psBezData->boPaletteTexture) {
+			afResult[0] = (float)(nIndex % 256) / 255.0f;
+			afResult[1] = (float)(nIndex / 256) / 255.0f;
+			afResult[2] = 0.0f;
+		}
+		else {
+			memcpy (afResult, psBezData->afPalette + (nIndex * BEZ_COL_COMPONENTS), BEZ_COL_COMPONENTS * sizeof (float));
+		}
+	}
+	else {
+		memcpy (afResult, afColour, BEZ_COL_COMPONENTS * sizeof (float));
+	}
+
+	return afResult;
+}
+
+// Weld the tubes of each chain together, so that neighbouring tubes share a single ring where they meet
+// This only applies to tubes tessellated on the CPU and set using SetBezierChain
+// All beziers must be regenerated after calling this
+void SetBezierWeld (bool boWeld, BezPersist * psBezData) {
+	psBezData->boWeld = boWeld;
+}
+
+// Set the transformations used to draw copies of beziers, or clear them if there are none
+// Copies are drawn from the tessellated vertices, and palette offsets need the shader to look up the colours,
+// so returns FALSE if the copies can't be drawn, in which case none are set and every bezier must be set itself
+bool SetBezierCopies (int nCopies, BezCopy const * asCopy, BezPersist * psBezData) {
+	bool boSupported;
+	int nCopy;
+
+	boSupported = (nCopies <= BEZ_COPIES_MAX) && !psBezData->boInstanced;
+	for (nCopy = 0; (nCopy < nCopies) && boSupported; nCopy++) {
+		if ((asCopy[nCopy].nPaletteOffset != 0) && !(psBezData->boPaletteSupported && (psBezData->nPaletteOffsetUniform >= 0))) {
+			boSupported = FALSE;
+		}
+	}
+
+	psBezData->nCopies = (boSupported ? nCopies : 0);
+	if (psBezData->nCopies > 0) {
+		memcpy (psBezData->asCopy, asCopy, psBezData->nCopies * sizeof (BezCopy));
+	}
+
+	return boSupported || (nCopies == 0);
+}
+
+// Choose which of the copies a bezier is drawn in, with bit n of the mask set to draw it in copy n
+// It must be set before the bezier's control points, so that the copies are kept with its details for exporting
+// During a batch it can be set from any thread, for the beziers that thread is setting
+void SetBezierCopyMask (unsigned int uCopyMask, Bezier * psBezier, BezPersist * psBezData) {
+	psBezData->auSlotCopies[psBezier->nSlot] = uCopyMask;
+}
+
+// Set the box that all of the tubes lie within, used to quantise compact vertex positions
+// Anything outside the box is clamped to its edge
+// All beziers must be regenerated after calling this
+void SetBezierBounds (Vector3 vMin, Vector3 vMax, BezPersist * psBezData) {
+	SetTubeBounds (vMin, vMax, psBezData->psTubeData);
+}
+
 BezStore * NewBezStore () {
 	BezStore * psBezStore;
 
 	psBezStore = g_new0 (BezStore, 1);
 
 	psBezStore->boStore = FALSE;
-	psBezStore->psBezierFirst = NULL;
-	psBezStore->psBezierLast = NULL;
 	psBezStore->nBezierNum = 0;
+	psBezStore->nBezierMax = 0;
+	psBezStore->avStart = NULL;
+	psBezStore->avStartDir = NULL;
+	psBezStore->avEnd = NULL;
+	psBezStore->avEndDir = NULL;
+	psBezStore->afRadius = NULL;
+	psBezStore->afColourStart = NULL;
+	psBezStore->afColourEnd = NULL;
+	psBezStore->anPieces = NULL;
+	psBezStore->auCopies = NULL;
 
 	return psBezStore;
 }
 
 void DeleteBezStore (BezStore * psBezStore) {
-	ClearStoredBezierDetails (psBezStore);
+	g_free (psBezStore->avStart);
+	g_free (psBezStore->avStartDir);
+	g_free (psBezStore->avEnd);
+	g_free (psBezStore->avEndDir);
+	g_free (psBezStore->afRadius);
+	g_free (psBezStore->afColourStart);
+	g_free (psBezStore->afColourEnd);
+	g_free (psBezStore->anPieces);
+	g_free (psBezStore->auCopies);
 
 	g_free (psBezStore);
 }
 
-void StoreBezierDetails (Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, float fRadius, float const * afColourStart, float const * afColourEnd, BezStore * psBezStore) {
-	BezDetails * psBezDetails;
+void StoreBezierDetails (Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, float fRadius, float const * afColourStart, float const * afColourEnd, int nPieces, unsigned int uCopies, BezStore * psBezStore) {
+	int nBezier;
 	int nComponent;
 
-	psBezDetails = g_new0 (BezDetails, 1);
+	if (psBezStore->nBezierNum >= psBezStore->nBezierMax) {
+		psBezStore->nBezierMax = MAX (2 * psBezStore->nBezierMax, BEZIER_BLOCK);
+		psBezStore->avStart = g_renew (Vector3, psBezStore->avStart, psBezStore->nBezierMax);
+		psBezStore->avStartDir = g_renew (Vector3, psBezStore->avStartDir, psBezStore->nBezierMax);
+		psBezStore->avEnd = g_renew (Vector3, psBezStore->avEnd, psBezStore->nBezierMax);
+		psBezStore->avEndDir = g_renew (Vector3, psBezStore->avEndDir, psBezStore->nBezierMax);
+		psBezStore->afRadius = g_renew (float, psBezStore->afRadius, psBezStore->nBezierMax);
+		psBezStore->afColourStart = g_renew (float, psBezStore->afColourStart, psBezStore->nBezierMax * BEZ_COL_COMPONENTS);
+		psBezStore->afColourEnd = g_renew (float, psBezStore->afColourEnd, psBezStore->nBezierMax * BEZ_COL_COMPONENTS);
+		psBezStore->anPieces = g_renew (int, psBezStore->anPieces, psBezStore->nBezierMax);
+		psBezStore->auCopies = g_renew (unsigned int, psBezStore->auCopies, psBezStore->nBezierMax);
+	}
+
+	nBezier = psBezStore->nBezierNum;
+	psBezStore->avStart[nBezier] = * pvStart;
+	psBezStore->avStartDir[nBezier] = * pvStartDir;
+	psBezStore->avEnd[nBezier] = * pvEnd;
+	psBezStore->avEndDir[nBezier] = * pvEndDir;
+	psBezStore->afRadius[nBezier] = fRadius;
+	for (nComponent = 0; nComponent < BEZ_COL_COMPONENTS; nComponent++) {
+		psBezStore->afColourStart[(nBezier * BEZ_COL_COMPONENTS) + nComponent] = (afColourStart ? afColourStart[nComponent] : 0.5f);
+		psBezStore->afColourEnd[(nBezier * BEZ_COL_COMPONENTS) + nComponent] = (afColourEnd ? afColourEnd[nComponent] : 0.5f);
+	}
+	psBezStore->anPieces[nBezier] = nPieces;
+	psBezStore->auCopies[nBezier] = uCopies;
+	psBezStore->nBezierNum++;
+}
+
+// Gather the details of a stored bezier together
+void GetStoredBezierDetails (int nBezier, BezDetails * psBezDetails, BezStore const * psBezStore) {
+	FillBezierDetails (psBezDetails, & psBezStore->avStart[nBezier], & psBezStore->avStartDir[nBezier], & psBezStore->avEnd[nBezier], & psBezStore->avEndDir[nBezier], psBezStore->afRadius[nBezier], & psBezStore->afColourStart[nBezier * BEZ_COL_COMPONENTS], & psBezStore->afColourEnd[nBezier * BEZ_COL_COMPONENTS], psBezStore->anPieces[nBezier], psBezStore->auCopies[nBezier]);
+}
+
+void FillBezierDetails (BezDetails * psBezDetails, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, float fRadius, float const * afColourStart, float const * afColourEnd, int nPieces, unsigned int uCopies) {
+	int nComponent;
 
 	psBezDetails->vStart = * pvStart;
 	psBezDetails->vEnd = * pvEnd;
 	psBezDetails->vStartDir = * pvStartDir;
 	psBezDetails->vEndDir = * pvEndDir;
 	psBezDetails->fRadius = fRadius;
+	psBezDetails->nPieces = nPieces;
+	psBezDetails->uCopies = uCopies;
 	if (afColourStart && afColourEnd) {
 		for (nComponent = 0; nComponent < BEZ_COL_COMPONENTS; nComponent++) {
 			psBezDetails->afColourStart[nComponent] = afColourStart[nComponent];
@@ -246,33 +1205,10 @@ void StoreBezierDetails (Vector3 const * pvStart, Vector3 const * pvStartDir, Ve
 			psBezDetails->afColourEnd[nComponent] = 0.5f;
 		}
 	}
-	psBezDetails->psNext = NULL;
-
-	if (psBezStore->psBezierFirst == NULL) {
-		psBezStore->psBezierFirst = psBezDetails;
-	}
-
-	if (psBezStore->psBezierLast != NULL) {
-		psBezStore->psBezierLast->psNext = psBezDetails;
-	}
-	psBezStore->psBezierLast = psBezDetails;
-	psBezStore->nBezierNum++;
 }
 
+// The arrays are kept to be filled again
 void ClearStoredBezierDetails (BezStore * psBezStore) {
-	BezDetails * psBezDetails;
-	BezDetails * psBezDetailsNext;
-
-	// Free all of the bezier details	
-	psBezDetails = psBezStore->psBezierFirst;
-	while (psBezDetails) {
-		psBezDetailsNext = psBezDetails->psNext;
-		g_free (psBezDetails);
-		psBezDetails = psBezDetailsNext;
-	}
-
-	psBezStore->psBezierFirst = NULL;
-	psBezStore->psBezierLast = NULL;
 	psBezStore->nBezierNum = 0;
 }
 
@@ -289,19 +1225,47 @@ bool OutputStoredBeziers (char const * szFilename, BezPersist * psBezData, bool
 	int nVertices;
 	int nFaces;
 	FILE * hFile;
-	BezDetails * psBezDetails;
+	ExportBuffer * psBuffer;
+	BezStore const * psBezStore;
+	BezDetails sBezDetails;
+	BezDetails sCopyDetails;
+	int nBezier;
 	int nOffset;
 	int nSegments;
-	int nPieces;
+	int nCopy;
+	int nCopies;
+	bool boArena;
+	char * pcArena;
+	int * anSlotVertex;
 
 	nSegments = psBezData->nSegments;
-	nPieces = psBezData->nPieces;
+	psBezStore = psBezData->psBezierStore;
 
-	nVertices = ((nPieces + 1) * nSegments) * psBezData->psBezierStore->nBezierNum;
-	nFaces = (2 * nPieces * nSegments) * psBezData->psBezierStore->nBezierNum;
+	// Tubes tessellated on the CPU are read back from the arena, so they're output exactly as they're drawn
+	// Instanced tubes are only ever generated by the shader, so are generated again from their stored details in the same way
+	boArena = (!psBezData->boInstanced && psBezData->boArenaValid);
+	pcArena = NULL;
+	anSlotVertex = NULL;
+	nVertices = 0;
+	nFaces = 0;
+	if (boArena) {
+		pcArena = ReadVertexArena (psBezData);
+		anSlotVertex = g_new (int, (psBezData->nCopies + 1) * psBezData->nSlotsUsed);
+		CountArenaVertices (anSlotVertex, & nVertices, & nFaces, psBezData);
+	}
+	else {
+		// Each bezier may have been split into a different number of pieces
+		// Any copies drawn of it are output as tubes of their own, with the same number of pieces
+		for (nBezier = 0; nBezier < psBezStore->nBezierNum; nBezier++) {
+			nCopies = 1 + CountBezierCopies (psBezStore->auCopies[nBezier], psBezData);
+			nVertices += nCopies * (StoredBezierPieces (nBezier, psBezData) + 1) * nSegments;
+			nFaces += nCopies * 2 * StoredBezierPieces (nBezier, psBezData) * nSegments;
+		}
+	}
 
+	// Binary files mustn't have their line endings translated
 	boResult = FALSE;
-	hFile = fopen (szFilename, "w");
+	hFile = fopen (szFilename, (boBinary ? "wb" : "w"));
 	if (hFile) {
 		fprintf (hFile, "ply\n");
 		if (boBinary) {
@@ -321,225 +1285,383 @@ bool OutputStoredBeziers (char const * szFilename, BezPersist * psBezData, bool
 		fprintf (hFile, "element face %d\n", nFaces);
 		fprintf (hFile, "property list uchar int vertex_indices\n");
 		fprintf (hFile, "end_header\n");
+		psBuffer = NewExportBuffer (hFile, psBezData->nExportPlaces);
 
-		// Output the vertices
-		psBezDetails = psBezData->psBezierStore->psBezierFirst;
-		while (psBezDetails) {
-			OutputStoredVertices (hFile, nPieces, nSegments, psBezDetails, boBinary);
-			psBezDetails = psBezDetails->psNext;
+		if (boArena) {
+			OutputArenaVertices (psBuffer, pcArena, anSlotVertex, boBinary, psBezData);
+			OutputArenaIndices (psBuffer, anSlotVertex, boBinary, psBezData);
 		}
-		
-		// Output the indices
-		psBezDetails = psBezData->psBezierStore->psBezierFirst;
-		nOffset = 0;
-		while (psBezDetails) {
-			OutputStoredIndices (hFile, nPieces, nSegments, nOffset, psBezDetails, boBinary);
-			nOffset += ((nPieces + 1) * nSegments);
-			psBezDetails = psBezDetails->psNext;
+		else {
+			// Output the vertices
+			for (nBezier = 0; nBezier < psBezStore->nBezierNum; nBezier++) {
+				GetStoredBezierDetails (nBezier, & sBezDetails, psBezStore);
+				OutputStoredVertices (psBuffer, & sBezDetails, boBinary, psBezData);
+				for (nCopy = 0; nCopy < psBezData->nCopies; nCopy++) {
+					if (sBezDetails.uCopies & (1u << nCopy)) {
+						TransformBezierDetails (& sCopyDetails, & sBezDetails, & psBezData->asCopy[nCopy], psBezData);
+						OutputStoredVertices (psBuffer, & sCopyDetails, boBinary, psBezData);
+					}
+				}
+			}
+
+			// Output the indices
+			nOffset = 0;
+			for (nBezier = 0; nBezier < psBezStore->nBezierNum; nBezier++) {
+				nCopies = 1 + CountBezierCopies (psBezStore->auCopies[nBezier], psBezData);
+				for (nCopy = 0; nCopy < nCopies; nCopy++) {
+					OutputStoredIndices (psBuffer, StoredBezierPieces (nBezier, psBezData), nSegments, nOffset, nOffset, boBinary);
+					nOffset += ((StoredBezierPieces (nBezier, psBezData) + 1) * nSegments);
+				}
+			}
 		}
 
-		fclose (hFile);
-		boResult = TRUE;
+		boResult = DeleteExportBuffer (psBuffer);
+		if (fclose (hFile) != 0) {
+			boResult = FALSE;
+		}
+		if (!boResult) {
+			fprintf (stderr, "Failed to write the whole of the exported file %s.\n", szFilename);
+		}
 	}
 
+	g_free (pcArena);
+	g_free (anSlotVertex);
+
 	return boResult;
 }
 
-int OutputStoredVertices (FILE * hFile, int nPieces, int nSegments, BezDetails const * psBezDetails, bool boBinary) {
-	int nPiece;
-	int nSegment;
-	Vector3 vPos;
-	Vector3 vOffset;
-	float fStep;
-	float fTheta;
-	Vector3 vNormalPrev;
-	Vector3 vNormal;
-	Matrix3 mRotate;
-	Matrix3 mRotation;
-	Vector3 vVertex;
-	int nVertices;
-	float fColour;
-  unsigned char ucColour[BEZ_COL_COMPONENTS];
-  float fColScale;
-  int nColComponent;
+// Copy the used slots back from the arena, writing anything still mapped to it first
+char * ReadVertexArena (BezPersist * psBezData) {
+	char * pcArena;
+	int nSize;
 
-	vNormal.fX = 1.0f;
-	vNormal.fY = 0.0f;
-	vNormal.fZ = 0.0f;
-	SetIdentity (& mRotation);
+	UnmapVertexArena (psBezData);
 
-	nVertices = 0;
-	for (nPiece = 0; nPiece < nPieces; nPiece++) {
-		// Calculate the translation due to the bezier curve 
-		fStep = ((float)(nPiece)) / ((float)(nPieces));
-		vPos.fX = BEZIER (psBezDetails->vStart.fX, psBezDetails->vStartDir.fX, psBezDetails->vEnd.fX, psBezDetails->vEndDir.fX, fStep);
-		vPos.fY = BEZIER (psBezDetails->vStart.fY, psBezDetails->vStartDir.fY, psBezDetails->vEnd.fY, psBezDetails->vEndDir.fY, fStep);
-		vPos.fZ = BEZIER (psBezDetails->vStart.fZ, psBezDetails->vStartDir.fZ, psBezDetails->vEnd.fZ, psBezDetails->vEndDir.fZ, fStep);
-
-		// Calculate the rotation due to the curve direction
-		vNormalPrev = vNormal;
-		vNormal.fX = BEZIERDERIV (psBezDetails->vStart.fX, psBezDetails->vStartDir.fX, psBezDetails->vEnd.fX, psBezDetails->vEndDir.fX, fStep);
-		vNormal.fY = BEZIERDERIV (psBezDetails->vStart.fY, psBezDetails->vStartDir.fY, psBezDetails->vEnd.fY, psBezDetails->vEndDir.fY, fStep);
-		vNormal.fZ = BEZIERDERIV (psBezDetails->vStart.fZ, psBezDetails->vStartDir.fZ, psBezDetails->vEnd.fZ, psBezDetails->vEndDir.fZ, fStep);
-
-		mRotate = RotationBetweenVectors (& vNormalPrev, & vNormal);
-		mRotation = MultMatrixMatrix (& mRotation, & mRotate);
-
-		// Calculate vertex colour
-		fColScale = ((float)nPiece / (float)nPieces);
-		for (nColComponent = 0; nColComponent < BEZ_COL_COMPONENTS; nColComponent++) {
-			fColour = (psBezDetails->afColourEnd[nColComponent] * fColScale) + (psBezDetails->afColourStart[nColComponent] * (1.0f - fColScale));
-			ucColour[nColComponent] = (unsigned char)(fColour * 255.0);
-		}
+	nSize = psBezData->nSlotsUsed * ArenaSlotSize (psBezData);
+	pcArena = g_new (char, nSize);
+	if (nSize > 0) {
+		glBindBuffer (GL_ARRAY_BUFFER, psBezData->uVertexArena);
+		glGetBufferSubData (GL_ARRAY_BUFFER, 0, nSize, pcArena);
+	}
 
-		for (nSegment = 0; nSegment < nSegments; nSegment++) {
-			fTheta = (float)nSegment * (2.0 * M_PI / (float)nSegments);
+	return pcArena;
+}
 
-			vOffset.fX = 0.0f;
-			vOffset.fY = sin (fTheta);
-			vOffset.fZ = cos (fTheta);
+// The number of pieces drawn from a slot, or zero if it's empty
+int ArenaSlotPieces (int nSlot, BezPersist const * psBezData) {
+	return psBezData->anIndexCount[nSlot] / INDICES_PER_PIECE (psBezData->nSegments);
+}
 
-			// Apply the rotation
-			vOffset = MultMatrixVector (& mRotation, & vOffset);
+bool ArenaSlotWelded (int nSlot, BezPersist const * psBezData) {
+	return (psBezData->auSlotFirstRing[nSlot] != (nSlot * (psBezData->nPieces + 1) * psBezData->nSegments));
+}
 
-			vVertex.fX = vPos.fX + (psBezDetails->fRadius * vOffset.fX);
-			vVertex.fY = vPos.fY + (psBezDetails->fRadius * vOffset.fY);
-			vVertex.fZ = vPos.fZ + (psBezDetails->fRadius * vOffset.fZ);
+// Count the vertices and faces exported from the arena, and where each slot's vertices start in each copy
+// The tubes are output once as set and then once for each copy, with only the slots drawn in that copy
+// A welded tube shares its first ring with the tube it's welded on to, so its own vertices start one ring in,
+// but are numbered as though the ring were there; slots that aren't output are given -1
+void CountArenaVertices (int * anSlotVertex, int * pnVertices, int * pnFaces, BezPersist const * psBezData) {
+	int nCopy;
+	int nSlot;
+	int nPieces;
+	int nSegments;
+	int nVertices;
+	int nFaces;
+	int * pnSlotVertex;
 
-			if (boBinary) {
-				fwrite (& vVertex, sizeof (float), 3, hFile);
-				fwrite (ucColour, sizeof (unsigned char), BEZ_COL_COMPONENTS, hFile);
+	nSegments = psBezData->nSegments;
+	nVertices = 0;
+	nFaces = 0;
+	pnSlotVertex = anSlotVertex;
+	for (nCopy = -1; nCopy < psBezData->nCopies; nCopy++) {
+		for (nSlot = 0; nSlot < psBezData->nSlotsUsed; nSlot++) {
+			nPieces = ArenaSlotPieces (nSlot, psBezData);
+			if ((nPieces > 0) && ((nCopy < 0) || (psBezData->auSlotCopies[nSlot] & (1u << nCopy)))) {
+				if (ArenaSlotWelded (nSlot, psBezData)) {
+					* pnSlotVertex = nVertices - nSegments;
+					nVertices += nPieces * nSegments;
+				}
+				else {
+					* pnSlotVertex = nVertices;
+					nVertices += (nPieces + 1) * nSegments;
+				}
+				nFaces += 2 * nPieces * nSegments;
 			}
 			else {
-				fprintf (hFile, "%f %f %f\n", vVertex.fX, vVertex.fY, vVertex.fZ);
-				fprintf (hFile, "%u %u %u ", ucColour[0], ucColour[1], ucColour[2]);
+				* pnSlotVertex = -1;
 			}
-			nVertices++;
+			pnSlotVertex++;
 		}
 	}
 
-	// We need to do something different for the last piece
-	fStep = 1.0f;
+	* pnVertices = nVertices;
+	* pnFaces = nFaces;
+}
 
-	float fAngle;
-	Vector3 vUnit1;
-	Vector3 vUnit2;
-	Vector3 vTwist1;
-	Vector3 vTwist2;
-	Vector3 vCross;
-	Vector3 vSum;
-	float fLength;
+void OutputArenaVertices (ExportBuffer * psBuffer, char const * pcArena, int const * anSlotVertex, bool boBinary, BezPersist const * psBezData) {
+	int nCopy;
+	int nSlot;
+	int nRing;
+	int nSegment;
+	int nSegments;
+	int nVertex;
+	BezCopy const * psCopy;
+	Vector3 vPos;
+	unsigned char aucColour[BEZ_COL_COMPONENTS];
 
-	SetVector3 (vUnit1, 1.0f, 0.0f, 0.0f);
-	SetVector3 (vUnit2, 0.0f, 1.0f, 0.0f);
+	nSegments = psBezData->nSegments;
+	for (nCopy = -1; nCopy < psBezData->nCopies; nCopy++) {
+		psCopy = ((nCopy < 0) ? NULL : & psBezData->asCopy[nCopy]);
+		for (nSlot = 0; nSlot < psBezData->nSlotsUsed; nSlot++) {
+			if (anSlotVertex[((nCopy + 1) * psBezData->nSlotsUsed) + nSlot] >= 0) {
+				nRing = (ArenaSlotWelded (nSlot, psBezData) ? 1 : 0);
+				for (; nRing <= ArenaSlotPieces (nSlot, psBezData); nRing++) {
+					nVertex = ((nSlot * (psBezData->nPieces + 1)) + nRing) * nSegments;
+					for (nSegment = 0; nSegment < nSegments; nSegment++) {
+						DecodeArenaVertex (pcArena, nVertex + nSegment, psCopy, & vPos, aucColour, psBezData);
+						OutputExportVertex (& vPos, aucColour, boBinary, psBuffer);
+					}
+				}
+			}
+		}
+	}
+}
 
-	vPos.fX = BEZIER (psBezDetails->vStart.fX, psBezDetails->vStartDir.fX, psBezDetails->vEnd.fX, psBezDetails->vEndDir.fX, fStep);
-	vPos.fY = BEZIER (psBezDetails->vStart.fY, psBezDetails->vStartDir.fY, psBezDetails->vEnd.fY, psBezDetails->vEndDir.fY, fStep);
-	vPos.fZ = BEZIER (psBezDetails->vStart.fZ, psBezDetails->vStartDir.fZ, psBezDetails->vEnd.fZ, psBezDetails->vEndDir.fZ, fStep);
+void OutputArenaIndices (ExportBuffer * psBuffer, int const * anSlotVertex, bool boBinary, BezPersist const * psBezData) {
+	int nCopy;
+	int nSlot;
+	int nSlotFirst;
+	int nSlotVertices;
+	int nFirstRing;
+	int nOffset;
+	int const * anCopyVertex;
+	GLuint uFirstRing;
+
+	nSlotVertices = (psBezData->nPieces + 1) * psBezData->nSegments;
+	for (nCopy = -1; nCopy < psBezData->nCopies; nCopy++) {
+		anCopyVertex = anSlotVertex + ((nCopy + 1) * psBezData->nSlotsUsed);
+		for (nSlot = 0; nSlot < psBezData->nSlotsUsed; nSlot++) {
+			nOffset = anCopyVertex[nSlot];
+			if (nOffset >= 0) {
+				// Find where the ring a welded tube starts from was output
+				// Joined tubes are always drawn in the same copies, so it's output alongside this one
+				nFirstRing = nOffset;
+				if (ArenaSlotWelded (nSlot, psBezData)) {
+					uFirstRing = psBezData->auSlotFirstRing[nSlot];
+					nSlotFirst = uFirstRing / nSlotVertices;
+					g_assert (anCopyVertex[nSlotFirst] >= 0);
+					nFirstRing = anCopyVertex[nSlotFirst] + (uFirstRing % nSlotVertices);
+				}
+				OutputStoredIndices (psBuffer, ArenaSlotPieces (nSlot, psBezData), psBezData->nSegments, nFirstRing, nOffset, boBinary);
+			}
+		}
+	}
+}
 
-	vNormalPrev = vNormal;
-	vNormal.fX = BEZIERDERIV (psBezDetails->vStart.fX, psBezDetails->vStartDir.fX, psBezDetails->vEnd.fX, psBezDetails->vEndDir.fX, fStep);
-	vNormal.fY = BEZIERDERIV (psBezDetails->vStart.fY, psBezDetails->vStartDir.fY, psBezDetails->vEnd.fY, psBezDetails->vEndDir.fY, fStep);
-	vNormal.fZ = BEZIERDERIV (psBezDetails->vStart.fZ, psBezDetails->vStartDir.fZ, psBezDetails->vEnd.fZ, psBezDetails->vEndDir.fZ, fStep);
+// Find a vertex from the arena as it's drawn, with the radius added by the shader and its colour looked up in the palette
+// If it's drawn in a copy, it's moved into place and its colour taken from the copy's part of the palette
+void DecodeArenaVertex (char const * pcArena, int nVertex, BezCopy const * psCopy, Vector3 * pvPos, unsigned char * aucColour, BezPersist const * psBezData) {
+	KnotVertex const * psVertex;
+	Vector3 vNormal;
+	Matrix3 mRotate;
+	int nColComponent;
+	int nIndex;
 
-	mRotate = RotationBetweenVectors (& vNormalPrev, & vNormal);
-	mRotation = MultMatrixMatrix (& mRotation, & mRotate);
-	vTwist1 = MultMatrixVector (& mRotation, & vUnit2);
+	if (psBezData->boCompact) {
+		DecodeCompactVertex ((CompactVertex const *)pcArena + nVertex, pvPos, & vNormal, psBezData->psTubeData);
+		memcpy (aucColour, ((CompactVertex const *)pcArena + nVertex)->aucColour, BEZ_COL_COMPONENTS);
+	}
+	else {
+		psVertex = (KnotVertex const *)pcArena + nVertex;
+		SetVector3 (* pvPos, psVertex->fX, psVertex->fY, psVertex->fZ);
+		SetVector3 (vNormal, psVertex->fNX, psVertex->fNY, psVertex->fNZ);
+		for (nColComponent = 0; nColComponent < BEZ_COL_COMPONENTS; nColComponent++) {
+			aucColour[nColComponent] = ExportColourByte (psVertex->afColour[nColComponent]);
+		}
+	}
 
-	mRotate = RotationBetweenVectors (& vUnit1, & vNormal);
-	vTwist2 = MultMatrixVector (& mRotate, & vUnit2);
+	if (psBezData->boShaderRadius) {
+		pvPos->fX += psBezData->fTubeRadius * vNormal.fX;
+		pvPos->fY += psBezData->fTubeRadius * vNormal.fY;
+		pvPos->fZ += psBezData->fTubeRadius * vNormal.fZ;
+	}
 
-	fAngle = DotProdAngleVector (& vTwist1, & vTwist2);
-	fAngle = fmodf (fAngle, (2.0f * M_PI / (float)nSegments));
-	if (fAngle > (M_PI / (float)nSegments)) {
-		fAngle = fAngle - (2.0f * M_PI / (float)nSegments);
+	if (psCopy) {
+		mRotate = psCopy->mRotate;
+		* pvPos = MultMatrixVector (& mRotate, pvPos);
+		* pvPos = AddVectors (pvPos, & psCopy->vTranslate);
 	}
 
-	if (fabs (fAngle) > 0.0f) {
-		vCross = CrossProduct (& vTwist1, & vTwist2);
-		Normalise (& vCross);
-		vSum = AddVectors (& vCross, & vNormal);
-		fLength = Length (& vSum);
-		if (fLength > 1.0f) {
-			fAngle = -fAngle;
+	if ((psBezData->nPaletteColours > 0) && psBezData->boPaletteTexture) {
+		nIndex = aucColour[0] + (256 * aucColour[1]) + (psCopy ? psCopy->nPaletteOffset : 0);
+		nIndex = CLAMP (nIndex, 0, psBezData->nPaletteColours - 1);
+		for (nColComponent = 0; nColComponent < BEZ_COL_COMPONENTS; nColComponent++) {
+			aucColour[nColComponent] = ExportColourByte (psBezData->afPalette[(nIndex * BEZ_COL_COMPONENTS) + nColComponent]);
 		}
 	}
-	
-	// Calculate vertex colour
-	fColScale = ((float)nPiece / (float)nPieces);
-	for (nColComponent = 0; nColComponent < BEZ_COL_COMPONENTS; nColComponent++) {
-		fColour = (psBezDetails->afColourEnd[nColComponent] * fColScale) + (psBezDetails->afColourStart[nColComponent] * (1.0f - fColScale));
-		ucColour[nColComponent] = (unsigned char)(fColour * 255.0);
+}
+
+// Set the number of decimal places positions are written with in ASCII exports
+void SetExportPlaces (int nPlaces, BezPersist * psBezData) {
+	psBezData->nExportPlaces = CLAMP (nPlaces, 0, EXPORT_PLACES_MAX);
+}
+
+// The number of copies a bezier with the given copy mask is drawn in, not counting the bezier itself
+int CountBezierCopies (unsigned int uCopies, BezPersist const * psBezData) {
+	int nCopy;
+	int nCount;
+
+	nCount = 0;
+	for (nCopy = 0; nCopy < psBezData->nCopies; nCopy++) {
+		if (uCopies & (1u << nCopy)) {
+			nCount++;
+		}
 	}
 
-	for (nSegment = 0; nSegment < nSegments; nSegment++) {
-		fTheta = (float)nSegment * (2.0 * M_PI / (float)nSegments);
-		fTheta += fAngle;
+	return nCount;
+}
 
+// Find the details of a bezier as it's drawn by a copy, so that it can be output as though it had been set there
+void TransformBezierDetails (BezDetails * psResult, BezDetails const * psBezDetails, BezCopy const * psCopy, BezPersist const * psBezData) {
+	Vector3 * apvPoint[4];
+	Matrix3 mRotate;
+	int nPoint;
+
+	* psResult = * psBezDetails;
+	psResult->uCopies = 0u;
+
+	mRotate = psCopy->mRotate;
+	apvPoint[0] = & psResult->vStart;
+	apvPoint[1] = & psResult->vStartDir;
+	apvPoint[2] = & psResult->vEnd;
+	apvPoint[3] = & psResult->vEndDir;
+	for (nPoint = 0; nPoint < 4; nPoint++) {
+		* apvPoint[nPoint] = MultMatrixVector (& mRotate, apvPoint[nPoint]);
+		* apvPoint[nPoint] = AddVectors (apvPoint[nPoint], & psCopy->vTranslate);
+	}
 
-		vOffset.fX = 0.0f;
-		vOffset.fY = sin (fTheta);
-		vOffset.fZ = cos (fTheta);
+	if (psBezData->nPaletteColours > 0) {
+		psResult->afColourStart[0] += (float)psCopy->nPaletteOffset;
+		psResult->afColourEnd[0] += (float)psCopy->nPaletteOffset;
+	}
+}
 
-		// Apply the rotation
-		vOffset = MultMatrixVector (& mRotation, & vOffset);
-		//vOffset = MultMatrixVector (& mRotate, & vOffset);
+// The number of pieces a stored bezier is output with, which is the full number if the shader generates the tubes
+int StoredBezierPieces (int nBezier, BezPersist const * psBezData) {
+	return (psBezData->boInstanced ? psBezData->nPieces : psBezData->psBezierStore->anPieces[nBezier]);
+}
 
+int OutputStoredVertices (ExportBuffer * psBuffer, BezDetails const * psBezDetails, bool boBinary, BezPersist * psBezData) {
+	int nVertex;
+	int nVertices;
+	int nPieces;
+	KnotVertex const * psVertex;
+	unsigned char ucColour[BEZ_COL_COMPONENTS];
+	int nColComponent;
+	Vector3 vPos;
+	float fRadius;
+	float afColourStart[BEZ_COL_COMPONENTS];
+	float afColourEnd[BEZ_COL_COMPONENTS];
 
-		vVertex.fX = vPos.fX + (psBezDetails->fRadius * vOffset.fX);
-		vVertex.fY = vPos.fY + (psBezDetails->fRadius * vOffset.fY);
-		vVertex.fZ = vPos.fZ + (psBezDetails->fRadius * vOffset.fZ);
+	// Generate exactly the same vertices as are used for rendering
+	// If the shader adds the radius, the tubes are drawn with its current radius rather than the one they were set with
+	fRadius = (psBezData->boShaderRadius ? psBezData->fTubeRadius : psBezDetails->fRadius);
+	PaletteColour (psBezDetails->afColourStart, afColourStart, FALSE, psBezData);
+	PaletteColour (psBezDetails->afColourEnd, afColourEnd, FALSE, psBezData);
+	// The shader follows the tessellator's frame, but always with the full number of pieces
+	nPieces = (psBezData->boInstanced ? psBezData->nPieces : psBezDetails->nPieces);
+	GenerateTube (psBezData->asScratch, FALSE, nPieces, fRadius, psBezDetails->vStart, psBezDetails->vStartDir, psBezDetails->vEnd, psBezDetails->vEndDir, afColourStart, afColourEnd, psBezData->psTubeData);
 
-		if (boBinary) {
-			fwrite (& vVertex, sizeof (float), 3, hFile);
-			fwrite (ucColour, sizeof (unsigned char), BEZ_COL_COMPONENTS, hFile);
-		}
-		else {
-			fprintf (hFile, "%f %f %f\n", vVertex.fX, vVertex.fY, vVertex.fZ);
-			fprintf (hFile, "%u %u %u ", ucColour[0], ucColour[1], ucColour[2]);
+	nVertices = TubeVertices (nPieces, psBezData->psTubeData);
+	for (nVertex = 0; nVertex < nVertices; nVertex++) {
+		psVertex = & psBezData->asScratch[nVertex];
+
+		// Calculate vertex colour, rounded in the same way as for tubes read back from the arena
+		for (nColComponent = 0; nColComponent < BEZ_COL_COMPONENTS; nColComponent++) {
+			ucColour[nColComponent] = ExportColourByte (psVertex->afColour[nColComponent]);
 		}
-		nVertices++;
+
+		SetVector3 (vPos, psVertex->fX, psVertex->fY, psVertex->fZ);
+		OutputExportVertex (& vPos, ucColour, boBinary, psBuffer);
 	}
 	
 	return nVertices;
 }
 
-int OutputStoredIndices (FILE * hFile, int nPieces, int nSegments, int nOffset, BezDetails const * psBezDetails, bool boBinary) {
+void OutputExportVertex (Vector3 const * pvPos, unsigned char const * aucColour, bool boBinary, ExportBuffer * psBuffer) {
+	char * pcOut;
+	int nColComponent;
+
+	if (boBinary) {
+		pcOut = ExportSpace (PLY_VERTEX_SIZE, psBuffer);
+		memcpy (pcOut, & pvPos->fX, sizeof (float));
+		memcpy (pcOut + sizeof (float), & pvPos->fY, sizeof (float));
+		memcpy (pcOut + (2 * sizeof (float)), & pvPos->fZ, sizeof (float));
+		memcpy (pcOut + (3 * sizeof (float)), aucColour, BEZ_COL_COMPONENTS);
+	}
+	else {
+		// Laid out exactly as before, with each line holding a vertex's colour followed by the next vertex's position
+		pcOut = ExportReserve (6 * EXPORT_NUMBER_MAX, psBuffer);
+		pcOut = FormatExportFloat (pcOut, pvPos->fX, GetExportPlaces (psBuffer));
+		* pcOut++ = ' ';
+		pcOut = FormatExportFloat (pcOut, pvPos->fY, GetExportPlaces (psBuffer));
+		* pcOut++ = ' ';
+		pcOut = FormatExportFloat (pcOut, pvPos->fZ, GetExportPlaces (psBuffer));
+		* pcOut++ = '\n';
+		for (nColComponent = 0; nColComponent < BEZ_COL_COMPONENTS; nColComponent++) {
+			pcOut = FormatExportInt (pcOut, aucColour[nColComponent]);
+			* pcOut++ = ' ';
+		}
+		ExportCommit (pcOut, psBuffer);
+	}
+}
+
+void OutputExportFace (int const * anIndex, bool boBinary, ExportBuffer * psBuffer) {
+	char * pcOut;
+	int nCorner;
+
+	if (boBinary) {
+		pcOut = ExportSpace (PLY_FACE_SIZE, psBuffer);
+		* pcOut = (char)3;
+		memcpy (pcOut + sizeof (unsigned char), anIndex, 3 * sizeof (int));
+	}
+	else {
+		pcOut = ExportReserve (4 * EXPORT_NUMBER_MAX, psBuffer);
+		* pcOut++ = '3';
+		for (nCorner = 0; nCorner < 3; nCorner++) {
+			* pcOut++ = ' ';
+			pcOut = FormatExportInt (pcOut, anIndex[nCorner]);
+		}
+		* pcOut++ = '\n';
+		ExportCommit (pcOut, psBuffer);
+	}
+}
+
+// Output the faces of a tube whose rings are numbered from nOffset
+// The first ring is numbered from nFirstRing instead, so that a welded tube can start from the ring of the tube before it
+int OutputStoredIndices (ExportBuffer * psBuffer, int nPieces, int nSegments, int nFirstRing, int nOffset, bool boBinary) {
 	int nPiece;
 	int nSegment;
 	int nIndices;
 	int anIndex[3];
-	unsigned char uVertices;
+	int nRing;
+	int nRingNext;
 	
-	// This function outputs  index buffer identifiers
-	uVertices = 3;
 	nIndices = 0;
 	for (nPiece = 0; nPiece < nPieces; nPiece++) {
+		nRing = ((nPiece == 0) ? nFirstRing : (nOffset + (nPiece * nSegments)));
+		nRingNext = nOffset + ((nPiece + 1) * nSegments);
 		for (nSegment = 0; nSegment < nSegments; nSegment++) {
-			anIndex[0] = ((nPiece + 0) * nSegments) + ((nSegment + 0) % nSegments) + nOffset;
-			anIndex[1] = ((nPiece + 1) * nSegments) + ((nSegment + 0) % nSegments) + nOffset;
-			anIndex[2] = ((nPiece + 0) * nSegments) + ((nSegment + 1) % nSegments) + nOffset;
-
-			if (boBinary) {
-				fwrite (& uVertices, sizeof (unsigned char), 1, hFile);
-				fwrite (& anIndex, sizeof (int), 3, hFile);
-			}
-			else {
-				fprintf (hFile, "3 %d %d %d\n", anIndex[0], anIndex[1], anIndex[2]);
-			}
+			anIndex[0] = nRing + ((nSegment + 0) % nSegments);
+			anIndex[1] = nRingNext + ((nSegment + 0) % nSegments);
+			anIndex[2] = nRing + ((nSegment + 1) % nSegments);
+			OutputExportFace (anIndex, boBinary, psBuffer);
 			nIndices++;
 
-			anIndex[0] = ((nPiece + 0) * nSegments) + ((nSegment + 1) % nSegments) + nOffset;
-			anIndex[1] = ((nPiece + 1) * nSegments) + ((nSegment + 0) % nSegments) + nOffset;
-			anIndex[2] = ((nPiece + 1) * nSegments) + ((nSegment + 1) % nSegments) + nOffset;
-
-			if (boBinary) {
-				fwrite (& uVertices, sizeof (unsigned char), 1, hFile);
-				fwrite (& anIndex, sizeof (int), 3, hFile);
-			}
-			else {
-				fprintf (hFile, "3 %d %d %d\n", anIndex[0], anIndex[1], anIndex[2]);
-			}
+			anIndex[0] = nRing + ((nSegment + 1) % nSegments);
+			anIndex[1] = nRingNext + ((nSegment + 0) % nSegments);
+			anIndex[2] = nRingNext + ((nSegment + 1) % nSegments);
+			OutputExportFace (anIndex, boBinary, psBuffer);
 			nIndices++;
 		}
 	}
@@ -547,554 +1669,733 @@ int OutputStoredIndices (FILE * hFile, int nPieces, int nSegments, int nOffset,
 	return nIndices;
 }
 
-GLuint * CreateBezierVertexBuffers (int nPieces, int nSegments) {
-	KnotVertex * asVertex = NULL;
-	int nPiece;
-	int nSegment;
-	int nVertices;
-	float fTheta;
-	float fRadius;
-	float fLength;
-	float fX;
-	float fY;
-	float fZ;
-	int nIndex;
-	GLuint * auVertexBuffer;
-
-	// This function generates an array of vertex buffer identifiers
-	// Once they're no longer needed, these vertex buffers should be released and the array freed
-	auVertexBuffer = g_new0 (GLuint, 1);
-
-	fLength = 5.0f;
-	fRadius = 0.25f;
-
-	// Vertex buffers
-	glGenBuffers (1, auVertexBuffer);
-	g_assert (auVertexBuffer[0] > 0);
-	glBindBuffer (GL_ARRAY_BUFFER, auVertexBuffer[0]);
-	nVertices = (nPieces + 1) * nSegments;
-	glBufferData (GL_ARRAY_BUFFER, nVertices * sizeof (KnotVertex), NULL, GL_DYNAMIC_DRAW);
-	asVertex = g_malloc (nVertices * sizeof (KnotVertex));
-
-	for (nPiece = 0; nPiece <= nPieces; nPiece++) {
-		for (nSegment = 0; nSegment < nSegments; nSegment++) {
-			nIndex = (nPiece * nSegments) + nSegment;
-			fTheta = (float)nSegment * (2.0 * M_PI / (float)nSegments);
-			fX = (float)nPiece * (fLength / (float)nPieces);
-			fY = fRadius * sin (fTheta);
-			fZ = fRadius * cos (fTheta);
-
-			asVertex[nIndex].fX = fX;
-			asVertex[nIndex].fY = fY;
-			asVertex[nIndex].fZ = fZ;
-			asVertex[nIndex].fNX = 0.0f;
-			asVertex[nIndex].fNY = sin (fTheta);
-			asVertex[nIndex].fNZ = cos (fTheta);
-
-			asVertex[nIndex].afColour[0] = 1.0f;
-			asVertex[nIndex].afColour[1] = 0.5f;
-			asVertex[nIndex].afColour[2] = 1.0f;
-		}
-	}
-
-	glBufferSubData (GL_ARRAY_BUFFER, 0, nVertices * sizeof (KnotVertex), asVertex);
-	free (asVertex);
-	asVertex = NULL;
-	
-	return auVertexBuffer;
-}
-
 void SetBezierControlPoints (float fRadius, Vector3 vStart, Vector3 vStartDir, Vector3 vEnd, Vector3 vEndDir, float const * afStartCol, float const * afEndCol, Bezier * psBezier, BezPersist * psBezData) {
-	void * psBuffer;
 	float const afDefaultCol[3] = {0.5f, 0.5f, 1.0f};
 	float const * pfStartCol;
 	float const * pfEndCol;
+	float afStartStored[BEZ_COL_COMPONENTS];
+	float afEndStored[BEZ_COL_COMPONENTS];
+	BezInstance * psInstance;
+	char * pcSlot;
+	int nPieces;
+	GLuint uFirstRing;
+	float fRingRadius;
+
+	pfStartCol = (afStartCol ? PaletteColour (afStartCol, afStartStored, TRUE, psBezData) : afDefaultCol);
+	pfEndCol = (afEndCol ? PaletteColour (afEndCol, afEndStored, TRUE, psBezData) : afDefaultCol);
+	nPieces = TubePieces (& vStart, & vStartDir, & vEnd, & vEndDir, psBezData->psTubeData);
+
+	// The rings are left on the centreline if the shader adds the radius
+	fRingRadius = (psBezData->boShaderRadius ? 0.0f : fRadius);
+
+	// The data is generated straight into this bezier's slot in the arena
+	// During a batch the arena is already mapped, so there are no GL calls here
+	ReserveVertexArena (psBezData);
+	MapVertexArena (psBezData);
+	pcSlot = psBezData->pcArenaMapped + (psBezier->nSlot * ArenaSlotSize (psBezData));
+
+	if (psBezData->boInstanced) {
+		// The shader generates the tube, so only the control points are needed
+		psInstance = (BezInstance *)pcSlot;
+		psInstance->vStart = vStart;
+		psInstance->fRadius = fRingRadius;
+		psInstance->vStartDir = vStartDir;
+		psInstance->vEnd = vEnd;
+		psInstance->vEndDir = vEndDir;
+		memcpy (psInstance->afStartCol, pfStartCol, sizeof (psInstance->afStartCol));
+		memcpy (psInstance->afEndCol, pfEndCol, sizeof (psInstance->afEndCol));
+		FindTubeFrame (& psInstance->vAxis, & psInstance->fTwist, psBezData->nPieces, & vStart, & vStartDir, & vEnd, & vEndDir, psBezData->psTubeData);
+	}
+	else {
+		// A bezier set on its own has its own frame, which is twisted relative to the previous tube's,
+		// so the two can't share a ring and it's never welded
+		psBezier->boJoined = FALSE;
+		uFirstRing = FindWeldedRing (psBezier, psBezData);
+		GenerateTube (pcSlot, psBezData->boCompact, nPieces, fRingRadius, vStart, vStartDir, vEnd, vEndDir, pfStartCol, pfEndCol, psBezData->psTubeData);
+		psBezData->anIndexCount[psBezier->nSlot] = nPieces * INDICES_PER_PIECE (psBezData->nSegments);
+		CreateSlotLevelIndices (psBezier->nSlot, nPieces, uFirstRing, psBezData);
+		SetSlotBound (psBezier->nSlot, fRadius, & vStart, & vStartDir, & vEnd, & vEndDir, psBezData);
+	}
 
-	glBindBuffer (GL_ARRAY_BUFFER, psBezier->auVertexBuffer[0]);
-	psBuffer = glMapBuffer (GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+	RecordBezierDetails (psBezier->nSlot, & vStart, & vStartDir, & vEnd, & vEndDir, fRadius, afStartCol, afEndCol, nPieces, psBezData);
+}
 
-	pfStartCol = (afStartCol ? afStartCol : afDefaultCol);
-	pfEndCol = (afEndCol ? afEndCol : afDefaultCol);
+// Set a chain of beziers from psBezier onwards, each starting where the previous one ends with the same direction
+// The tube follows a single rotation-minimising frame along the whole chain, with each bezier welded on to the one before
+// (see GenerateTubeChain for how the ends are oriented)
+// If the shader generates the tubes or welding is switched off, the beziers are set separately and aren't welded
+// Changing any bezier of a welded chain means setting the whole chain again
+void SetBezierChain (int nLinks, BezChainLink const * asLink, float fRadius, bool boClosed, Bezier * psBezier, BezPersist * psBezData) {
+	BezChainLink const * psLink;
+	Bezier * psBezierLink;
+	int nLink;
+	float fRingRadius;
+	void ** apVertices;
+	bool * aboWelded;
+	int * anPieces;
+	GLuint * auFirstRing;
+	BezChainLink * asLinkStored;
+
+	if ((nLinks <= 0) || psBezData->boInstanced || !psBezData->boWeld) {
+		psBezierLink = psBezier;
+		for (nLink = 0; nLink < nLinks; nLink++) {
+			psLink = & asLink[nLink];
+			SetBezierControlPoints (fRadius, psLink->vStart, psLink->vStartDir, psLink->vEnd, psLink->vEndDir, psLink->afStartCol, psLink->afEndCol, psBezierLink, psBezData);
+			psBezierLink = psBezierLink->psNext;
+		}
+		return;
+	}
 
-	ConvertTubeToBezier (psBuffer, psBezData->nPieces, psBezData->nSegments, fRadius, vStart, vStartDir, vEnd, vEndDir, pfStartCol, pfEndCol);
+	// Find where each link's rings go in the arena, then have the tessellator generate the whole chain into them
+	// They're left on the centreline if the shader adds the radius
+	fRingRadius = (psBezData->boShaderRadius ? 0.0f : fRadius);
+	ReserveVertexArena (psBezData);
+	MapVertexArena (psBezData);
+	apVertices = g_new (void *, nLinks);
+	aboWelded = g_new (bool, nLinks);
+	anPieces = g_new (int, nLinks);
+	auFirstRing = g_new (GLuint, nLinks);
+	asLinkStored = g_new (BezChainLink, nLinks);
+	psBezierLink = psBezier;
+	for (nLink = 0; nLink < nLinks; nLink++) {
+		psLink = & asLink[nLink];
+		psBezierLink->boJoined = (nLink > 0);
+		apVertices[nLink] = psBezData->pcArenaMapped + (psBezierLink->nSlot * ArenaSlotSize (psBezData));
+		auFirstRing[nLink] = FindWeldedRing (psBezierLink, psBezData);
+		aboWelded[nLink] = (auFirstRing[nLink] != (psBezierLink->nSlot * (psBezData->nPieces + 1) * psBezData->nSegments));
+		anPieces[nLink] = TubePieces (& psLink->vStart, & psLink->vStartDir, & psLink->vEnd, & psLink->vEndDir, psBezData->psTubeData);
+		asLinkStored[nLink] = *psLink;
+		PaletteColour (psLink->afStartCol, asLinkStored[nLink].afStartCol, TRUE, psBezData);
+		PaletteColour (psLink->afEndCol, asLinkStored[nLink].afEndCol, TRUE, psBezData);
+
+		// The previous link's index count is needed to find the welded ring of the next one
+		psBezData->anIndexCount[psBezierLink->nSlot] = anPieces[nLink] * INDICES_PER_PIECE (psBezData->nSegments);
+		psBezierLink = psBezierLink->psNext;
+	}
 
-	glUnmapBuffer (GL_ARRAY_BUFFER);
+	GenerateTubeChain (apVertices, psBezData->boCompact, aboWelded, anPieces, nLinks, asLinkStored, fRingRadius, boClosed, psBezData->psTubeData);
 
-	if ((psBezData->psBezierStore->boStore) && afStartCol && afEndCol) {
-		StoreBezierDetails (& vStart, & vStartDir, & vEnd, & vEndDir, fRadius, afStartCol, afEndCol, psBezData->psBezierStore);
+	psBezierLink = psBezier;
+	for (nLink = 0; nLink < nLinks; nLink++) {
+		psLink = & asLink[nLink];
+		CreateSlotLevelIndices (psBezierLink->nSlot, anPieces[nLink], auFirstRing[nLink], psBezData);
+		SetSlotBound (psBezierLink->nSlot, fRadius, & psLink->vStart, & psLink->vStartDir, & psLink->vEnd, & psLink->vEndDir, psBezData);
+		RecordBezierDetails (psBezierLink->nSlot, & psLink->vStart, & psLink->vStartDir, & psLink->vEnd, & psLink->vEndDir, fRadius, psLink->afStartCol, psLink->afEndCol, anPieces[nLink], psBezData);
+		psBezierLink = psBezierLink->psNext;
 	}
-}
-
-GLuint * CreateBezierIndexBuffers (int nPieces, int nSegments) {
-	unsigned short * auIndex = NULL;
-	int nPiece;
-	int nSegment;
-	GLuint * auIndexBuffer;
-	int nIndices;
-	int nIndex;
-	
-	// This function generates an array of index buffer identifiers
-	// Once they're no longer needed, these index buffers should be released and the array freed
-	auIndexBuffer = malloc (nPieces * sizeof (GLuint));
 
-	// Index buffers
-	glGenBuffers (nPieces, auIndexBuffer);
-	nIndices = (nSegments + 1) * 2;
-	auIndex = g_new0 (unsigned short, nIndices);
+	g_free (apVertices);
+	g_free (aboWelded);
+	g_free (anPieces);
+	g_free (auFirstRing);
+	g_free (asLinkStored);
+}
 
-	for (nPiece = 0; nPiece < nPieces; nPiece++) {
-		glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, auIndexBuffer[nPiece]);
-		glBufferData (GL_ELEMENT_ARRAY_BUFFER, nIndices * sizeof (unsigned short), NULL, GL_STATIC_DRAW);
-		for (nSegment = 0; nSegment <= nSegments; nSegment++) {
-			nIndex = (nSegment * 2);
-			auIndex[(nIndex + 0)] = ((nPiece + 0) * nSegments) + (nSegment % nSegments);
-			auIndex[(nIndex + 1)] = ((nPiece + 1) * nSegments) + (nSegment % nSegments);
+// Keep the details of a bezier for exporting, if they're being stored
+void RecordBezierDetails (int nSlot, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, float fRadius, float const * afStartCol, float const * afEndCol, int nPieces, BezPersist * psBezData) {
+	if ((psBezData->psBezierStore->boStore) && afStartCol && afEndCol) {
+		if (psBezData->boBatch) {
+			// The details are stored in order at the end of the batch
+			FillBezierDetails (& psBezData->asSlotDetails[nSlot], pvStart, pvStartDir, pvEnd, pvEndDir, fRadius, afStartCol, afEndCol, nPieces, psBezData->auSlotCopies[nSlot]);
+		}
+		else {
+			StoreBezierDetails (pvStart, pvStartDir, pvEnd, pvEndDir, fRadius, afStartCol, afEndCol, nPieces, psBezData->auSlotCopies[nSlot], psBezData->psBezierStore);
 		}
-		glBufferSubData (GL_ELEMENT_ARRAY_BUFFER, 0, nIndices * sizeof (unsigned short), auIndex);
 	}
-
-	free (auIndex);
-	auIndex = NULL;
-	
-	return auIndexBuffer;
 }
 
-
-void ConvertTubeToBezier (KnotVertex * asVertex, int nPieces, int nSegments, float fRadius, Vector3 vStart, Vector3 vStartDir, Vector3 vEnd, Vector3 vEndDir, float const * afStartCol, float const * afEndCol) {
+// Build a single index buffer that draws every slot in the arena as one triangle strip
+// Each piece of each tube is a strip of its own, joined on to the previous one
+// using a pair of repeated indices; the resulting degenerate triangles aren't drawn
+void CreateArenaIndexBuffer (int nSlots, BezPersist * psBezData) {
+	GLuint * auIndex = NULL;
+	int nSlot;
 	int nPiece;
 	int nSegment;
-	Vector3 vPos;
-	Vector3 vOffset;
-	float fStep;
-	float fTheta;
+	int nSegments;
 	int nIndex;
-	Vector3 vNormalPrev;
-	Vector3 vNormal;
-	Matrix3 mRotate;
-	Matrix3 mRotation;
-	float fColScale;
-	float fAngle;
-	Vector3 vUnit1;
-	Vector3 vUnit2;
-	Vector3 vTwist1;
-	Vector3 vTwist2;
-	Vector3 vCross;
-	Vector3 vSum;
-	float fLength;
-
-
-	SetVector3 (vNormal, 1.0f, 0.0f, 0.0f);
-	SetIdentity (& mRotation);
-
-	for (nPiece = 0; nPiece < nPieces; nPiece++) {
-		fColScale = ((float)nPiece / (float)nPieces);
-
-		// Calculate the translation due to the bezier curve 
-		fStep = ((float)(nPiece)) / ((float)(nPieces));
-		vPos.fX = BEZIER (vStart.fX, vStartDir.fX, vEnd.fX, vEndDir.fX, fStep);
-		vPos.fY = BEZIER (vStart.fY, vStartDir.fY, vEnd.fY, vEndDir.fY, fStep);
-		vPos.fZ = BEZIER (vStart.fZ, vStartDir.fZ, vEnd.fZ, vEndDir.fZ, fStep);
-
-		// Calculate the rotation due to the curve direction
-		vNormalPrev = vNormal;
-		vNormal.fX = BEZIERDERIV (vStart.fX, vStartDir.fX, vEnd.fX, vEndDir.fX, fStep);
-		vNormal.fY = BEZIERDERIV (vStart.fY, vStartDir.fY, vEnd.fY, vEndDir.fY, fStep);
-		vNormal.fZ = BEZIERDERIV (vStart.fZ, vStartDir.fZ, vEnd.fZ, vEndDir.fZ, fStep);
-
-		mRotate = RotationBetweenVectors (& vNormalPrev, & vNormal);
-		mRotation = MultMatrixMatrix (& mRotation, & mRotate);
-
-		for (nSegment = 0; nSegment < nSegments; nSegment++) {
-			nIndex = (nPiece * nSegments) + nSegment;
-			fTheta = (float)nSegment * (2.0 * M_PI / (float)nSegments);
+	GLuint uBase;
+	GLuint uLast;
 
-			vOffset.fX = 0.0f;
-			vOffset.fY = sin (fTheta);
-			vOffset.fZ = cos (fTheta);
-
-			// Apply the rotation
-			vOffset = MultMatrixVector (& mRotation, & vOffset);
-
-			asVertex[nIndex].fX = vPos.fX + (fRadius * vOffset.fX);
-			asVertex[nIndex].fY = vPos.fY + (fRadius * vOffset.fY);
-			asVertex[nIndex].fZ = vPos.fZ + (fRadius * vOffset.fZ);
-			asVertex[nIndex].fNX = vOffset.fX;
-			asVertex[nIndex].fNY = vOffset.fY;
-			asVertex[nIndex].fNZ = vOffset.fZ;
-
-			asVertex[nIndex].afColour[0] = (afEndCol[0] * fColScale) + (afStartCol[0] * (1.0f - fColScale));
-			asVertex[nIndex].afColour[1] = (afEndCol[1] * fColScale) + (afStartCol[1] * (1.0f - fColScale));
-			asVertex[nIndex].afColour[2] = (afEndCol[2] * fColScale) + (afStartCol[2] * (1.0f - fColScale));
+	// Space for the coarser detail levels is left at the end of each slot's indices
+	nSegments = psBezData->nSegments;
+	auIndex = g_new0 (GLuint, nSlots * psBezData->nIndicesPerSlot);
+
+	uLast = 0;
+	for (nSlot = 0; nSlot < nSlots; nSlot++) {
+		nIndex = nSlot * psBezData->nIndicesPerSlot;
+		uBase = nSlot * (psBezData->nPieces + 1) * nSegments;
+		for (nPiece = 0; nPiece < psBezData->nPieces; nPiece++) {
+			// Strips all have an even length, so the winding order is preserved
+			auIndex[nIndex++] = uLast;
+			auIndex[nIndex++] = uBase + ((nPiece + 0) * nSegments);
+			for (nSegment = 0; nSegment <= nSegments; nSegment++) {
+				auIndex[nIndex++] = uBase + ((nPiece + 0) * nSegments) + (nSegment % nSegments);
+				auIndex[nIndex++] = uBase + ((nPiece + 1) * nSegments) + (nSegment % nSegments);
+			}
+			uLast = auIndex[nIndex - 1];
 		}
 	}
 
-	// We need to do something different for the last piece
-	fStep = 1.0f;
-
-	SetVector3 (vUnit1, 1.0f, 0.0f, 0.0f);
-	SetVector3 (vUnit2, 0.0f, 1.0f, 0.0f);
-
-	fColScale = 1.0f;
-	vPos.fX = BEZIER (vStart.fX, vStartDir.fX, vEnd.fX, vEndDir.fX, fStep);
-	vPos.fY = BEZIER (vStart.fY, vStartDir.fY, vEnd.fY, vEndDir.fY, fStep);
-	vPos.fZ = BEZIER (vStart.fZ, vStartDir.fZ, vEnd.fZ, vEndDir.fZ, fStep);
-
-	vNormalPrev = vNormal;
-	vNormal.fX = BEZIERDERIV (vStart.fX, vStartDir.fX, vEnd.fX, vEndDir.fX, fStep);
-	vNormal.fY = BEZIERDERIV (vStart.fY, vStartDir.fY, vEnd.fY, vEndDir.fY, fStep);
-	vNormal.fZ = BEZIERDERIV (vStart.fZ, vStartDir.fZ, vEnd.fZ, vEndDir.fZ, fStep);
-
-	mRotate = RotationBetweenVectors (& vNormalPrev, & vNormal);
-	mRotation = MultMatrixMatrix (& mRotation, & mRotate);
-	vTwist1 = MultMatrixVector (& mRotation, & vUnit2);
+	if (psBezData->uIndexBuffer == 0) {
+		glGenBuffers (1, & psBezData->uIndexBuffer);
+		g_assert (psBezData->uIndexBuffer > 0);
+	}
+	psBezData->nIndexBufferSize = nSlots * psBezData->nIndicesPerSlot * sizeof (GLuint);
+	glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, psBezData->uIndexBuffer);
+	glBufferData (GL_ELEMENT_ARRAY_BUFFER, psBezData->nIndexBufferSize, auIndex, GL_STATIC_DRAW);
 
-	mRotate = RotationBetweenVectors (& vUnit1, & vNormal);
-	vTwist2 = MultMatrixVector (& mRotate, & vUnit2);
+	g_free (auIndex);
+	auIndex = NULL;
+}
 
-	fAngle = DotProdAngleVector (& vTwist1, & vTwist2);
-	fAngle = fmodf (fAngle, (2.0f * M_PI / (float)nSegments));
-	if (fAngle > (M_PI / (float)nSegments)) {
-		fAngle = fAngle - (2.0f * M_PI / (float)nSegments);
-	}
+// Work out which of the requested detail levels to use, how each samples the full tessellation,
+// and where its indices go within each slot
+// Segments can only be skipped evenly if the stride divides the number of segments,
+// and a level is dropped if it isn't coarser than the one before it
+void ArrangeDetailLevels (BezPersist * psBezData) {
+	int nLevel;
+	int nUsed;
+	int nStride;
+	int nPieces;
+	int nSegments;
+	int nOffset;
+	int nCommon;
+	int nRemainder;
+	int nTemp;
+	int nTwistStride;
 
-	if (fabs (fAngle) > 0.0f) {
-		vCross = CrossProduct (& vTwist1, & vTwist2);
-		Normalise (& vCross);
-		vSum = AddVectors (& vCross, & vNormal);
-		fLength = Length (& vSum);
-		if (fLength > 1.0f) {
-			fAngle = -fAngle;
+	nSegments = psBezData->nSegments;
+	psBezData->anLevelStride[0] = 1;
+	psBezData->anLevelPiecesMax[0] = psBezData->nPieces;
+	psBezData->anLevelOffset[0] = 0;
+	psBezData->afLevelThreshold[0] = G_MAXFLOAT;
+	nTwistStride = 1;
+	nOffset = psBezData->nPieces * INDICES_PER_PIECE (nSegments);
+	nUsed = 1;
+
+	// The shader always generates the full tessellation
+	if (!psBezData->boInstanced) {
+		for (nLevel = 1; nLevel < psBezData->nLevels; nLevel++) {
+			nStride = MAX (nSegments / psBezData->anLevelSegments[nLevel], 1);
+			while ((nSegments % nStride) != 0) {
+				nStride--;
+			}
+			nPieces = MIN (psBezData->anLevelPieces[nLevel], psBezData->nPieces);
+
+			if ((nStride >= psBezData->anLevelStride[nUsed - 1]) && (nPieces <= psBezData->anLevelPiecesMax[nUsed - 1]) 
+				&& ((nStride > psBezData->anLevelStride[nUsed - 1]) || (nPieces < psBezData->anLevelPiecesMax[nUsed - 1])) 
+				&& (psBezData->afLevelPixels[nLevel] < psBezData->afLevelThreshold[nUsed - 1])) {
+				psBezData->anLevelStride[nUsed] = nStride;
+				psBezData->anLevelPiecesMax[nUsed] = nPieces;
+				psBezData->anLevelOffset[nUsed] = nOffset;
+				psBezData->afLevelThreshold[nUsed] = psBezData->afLevelPixels[nLevel];
+				nOffset += nPieces * INDICES_PER_PIECE (nSegments / nStride);
+
+				// The twist must be a multiple of every level's stride
+				nCommon = nTwistStride;
+				nRemainder = nStride;
+				while (nRemainder != 0) {
+					nTemp = nCommon % nRemainder;
+					nCommon = nRemainder;
+					nRemainder = nTemp;
+				}
+				nTwistStride = (nTwistStride / nCommon) * nStride;
+
+				nUsed++;
+			}
 		}
 	}
-	
-	for (nSegment = 0; nSegment < nSegments; nSegment++) {
-		nIndex = (nPiece * nSegments) + nSegment;
-		fTheta = (float)nSegment * (2.0 * M_PI / (float)nSegments);
-		fTheta += fAngle;
-
-		vOffset.fX = 0.0f;
-		vOffset.fY = sin (fTheta);
-		vOffset.fZ = cos (fTheta);
-
-		// Apply the rotation
-		vOffset = MultMatrixVector (& mRotation, & vOffset);
-
-		asVertex[nIndex].fX = vPos.fX + (fRadius * vOffset.fX);
-		asVertex[nIndex].fY = vPos.fY + (fRadius * vOffset.fY);
-		asVertex[nIndex].fZ = vPos.fZ + (fRadius * vOffset.fZ);
-
-		asVertex[nIndex].fNX = vOffset.fX;
-		asVertex[nIndex].fNY = vOffset.fY;
-		asVertex[nIndex].fNZ = vOffset.fZ;
 
-		asVertex[nIndex].afColour[0] = (afEndCol[0] * fColScale) + (afStartCol[0] * (1.0f - fColScale));
-		asVertex[nIndex].afColour[1] = (afEndCol[1] * fColScale) + (afStartCol[1] * (1.0f - fColScale));
-		asVertex[nIndex].afColour[2] = (afEndCol[2] * fColScale) + (afStartCol[2] * (1.0f - fColScale));
+	for (nLevel = nUsed; nLevel < BEZ_LEVELS_MAX; nLevel++) {
+		psBezData->anLevelOffset[nLevel] = 0;
 	}
+	psBezData->nLevelsUsed = nUsed;
+	psBezData->nIndicesPerSlot = nOffset;
+	SetTubeTwistStride (nTwistStride, psBezData->psTubeData);
 }
 
-
-void ConvertTubeToBezier2 (KnotVertex * asVertex, int nPieces, int nSegments, float fRadius, Vector3 vStart, Vector3 vStartDir, Vector3 vEnd, Vector3 vEndDir, float const * afStartCol, float const * afEndCol) {
+// Fill in the indices of the coarser detail levels for a slot, which depend on how many pieces its bezier uses
+// Each level uses every stride-th segment of a subset of the rings, always including the first and last
+// The first ring may belong to another slot if the tube is welded, so the first piece of the full tessellation is filled in too
+void CreateSlotLevelIndices (int nSlot, int nPieces, GLuint uFirstRing, BezPersist * psBezData) {
+	int nLevel;
+	int nLevelPieces;
 	int nPiece;
 	int nSegment;
-	Vector3 vPos;
-	Vector3 vOffset;
-	float fStep;
-	float fTheta;
+	int nSegments;
+	int nStride;
 	int nIndex;
-	Vector3 vNormal;
-	Vector3 vIdentity;
-	Matrix3 mRotation;
-	float fColScale;
-	Vector3 vUnit;
-	Vector3 vUnitPrevious;
-	float fCorrection;
-	float fAngle;
-	Vector3 vPerpendicular;
-	Vector3 vCross;
-	Vector3 vSum;
-	float fLength;
-
-	fCorrection = 0.0f;
-	SetVector3 (vIdentity, 1.0f, 0.0f, 0.0f);
-	SetVector3 (vNormal, 1.0f, 0.0f, 0.0f);
-	SetVector3 (vPerpendicular, 0.0f, 1.0f, 0.0f);
-	SetVector3 (vUnit, 0.0f, 1.0f, 0.0f);
-	SetVector3 (vUnitPrevious, 0.0f, 1.0f, 0.0f);
-	SetIdentity (& mRotation);
-
-	for (nPiece = 0; nPiece <= nPieces; nPiece++) {
-		fColScale = ((float)nPiece / (float)nPieces);
-
-		// Calculate the translation due to the bezier curve 
-		fStep = ((float)(nPiece)) / ((float)(nPieces));
-		vPos.fX = BEZIER (vStart.fX, vStartDir.fX, vEnd.fX, vEndDir.fX, fStep);
-		vPos.fY = BEZIER (vStart.fY, vStartDir.fY, vEnd.fY, vEndDir.fY, fStep);
-		vPos.fZ = BEZIER (vStart.fZ, vStartDir.fZ, vEnd.fZ, vEndDir.fZ, fStep);
-
-		// Calculate the rotation due to the curve direction
-		vNormal.fX = BEZIERDERIV (vStart.fX, vStartDir.fX, vEnd.fX, vEndDir.fX, fStep);
-		vNormal.fY = BEZIERDERIV (vStart.fY, vStartDir.fY, vEnd.fY, vEndDir.fY, fStep);
-		vNormal.fZ = BEZIERDERIV (vStart.fZ, vStartDir.fZ, vEnd.fZ, vEndDir.fZ, fStep);
-
-		mRotation = RotationBetweenVectors (& vIdentity, & vNormal);
-		vUnitPrevious = vUnit;
-		vUnit = MultMatrixVector (& mRotation, & vPerpendicular);
-
-		fAngle = DotProdAngleVector (& vUnitPrevious, & vUnit);
-
-		if (fabs (fAngle) > 0.0001f) {
-			vCross = CrossProduct (& vUnitPrevious, & vUnit);
-			Normalise (& vCross);
-			vSum = AddVectors (& vCross, & vNormal);
-			fLength = Length (& vSum);
-			if (fLength > 1.0f) {
-				fAngle = -fAngle;
-			}
-		}
+	GLuint * auIndex;
+	GLuint uBase;
+	GLuint uRing;
+	GLuint uRingNext;
+	GLuint uLast;
 
-		if (fabs (fAngle) > (M_PI / (float)nSegments)) {
-			if (fAngle > 0) {
-				fCorrection -= fAngle;
-			}
-			else {
-				fCorrection -= fAngle;
-			}
-		}
-
-/*
-		fCorrection -= fAngle;
-		fMod = fmodf ((fCorrection), (2.0f * M_PI / (float)nSegments));
-		fMod = (2.0f * M_PI / (float)nSegments) - fMod;
-		if (fMod > (M_PI / (float)nSegments)) {
-			fMod -= (2.0f * M_PI / (float)nSegments);
-		}
-		fCorrection += fMod;
-*/
+	nSegments = psBezData->nSegments;
+	uBase = nSlot * (psBezData->nPieces + 1) * nSegments;
+	psBezData->auSlotFirstRing[nSlot] = uFirstRing;
+
+	auIndex = psBezData->puIndexMapped + (nSlot * psBezData->nIndicesPerSlot);
+	nIndex = 0;
+	auIndex[nIndex++] = uFirstRing;
+	auIndex[nIndex++] = uFirstRing;
+	for (nSegment = 0; nSegment <= nSegments; nSegment++) {
+		auIndex[nIndex++] = uFirstRing + (nSegment % nSegments);
+		auIndex[nIndex++] = uBase + nSegments + (nSegment % nSegments);
+	}
 
-/*
-		fAngle = fmodf (fAngle, (2.0f * M_PI / (float)nSegments));
-		if (fAngle > (M_PI / (float)nSegments)) {
-			fAngle = fAngle - (2.0f * M_PI / (float)nSegments);
-		}
+	for (nLevel = 1; nLevel < psBezData->nLevelsUsed; nLevel++) {
+		nLevelPieces = MIN (nPieces, psBezData->anLevelPiecesMax[nLevel]);
+		nStride = psBezData->anLevelStride[nLevel];
+
+		// Written straight into the mapped index buffer
+		auIndex = psBezData->puIndexMapped + (nSlot * psBezData->nIndicesPerSlot) + psBezData->anLevelOffset[nLevel];
+		nIndex = 0;
+		uLast = uFirstRing;
+		for (nPiece = 0; nPiece < nLevelPieces; nPiece++) {
+			// Spread the rings as evenly as possible along the tube
+			uRing = uBase + (((((nPiece + 0) * nPieces) + (nLevelPieces / 2)) / nLevelPieces) * nSegments);
+			uRingNext = uBase + (((((nPiece + 1) * nPieces) + (nLevelPieces / 2)) / nLevelPieces) * nSegments);
+			if (nPiece == 0) {
+				uRing = uFirstRing;
+			}
 
-		if (fabs (fAngle) > 0.0001f) {
-			vCross = CrossProduct (& vTwist1, & vTwist2);
-			Normalise (& vCross);
-			vSum = AddVectors (& vCross, & vNormal);
-			fLength = Length (& vSum);
-			if (fLength > 1.0f) {
-				fAngle = -fAngle;
+			auIndex[nIndex++] = uLast;
+			auIndex[nIndex++] = uRing;
+			for (nSegment = 0; nSegment <= nSegments; nSegment += nStride) {
+				auIndex[nIndex++] = uRing + (nSegment % nSegments);
+				auIndex[nIndex++] = uRingNext + (nSegment % nSegments);
 			}
+			uLast = uRingNext;
 		}
-*/
-
-
 
+		psBezData->anIndexCount[LEVEL_SLOT (nLevel, nSlot, psBezData)] = nIndex;
+	}
+}
 
+// Find the index of the first ring of a tube
+// If the tube is welded to the previous one, this is the last ring of the previous tube, which must already have been set
+// Only the beziers of a chain are welded, as the chain carries a single frame across each join so that the rings match exactly
+GLuint FindWeldedRing (Bezier const * psBezier, BezPersist const * psBezData) {
+	GLuint uFirstRing;
+	int nSlotPrev;
+	int nPiecesPrev;
+
+	uFirstRing = psBezier->nSlot * (psBezData->nPieces + 1) * psBezData->nSegments;
+	if (psBezData->boWeld && psBezier->boJoined && psBezier->psPrev) {
+		nSlotPrev = psBezier->psPrev->nSlot;
+		nPiecesPrev = psBezData->anIndexCount[nSlotPrev] / INDICES_PER_PIECE (psBezData->nSegments);
+		if (nPiecesPrev > 0) {
+			uFirstRing = ((nSlotPrev * (psBezData->nPieces + 1)) + nPiecesPrev) * psBezData->nSegments;
+		}
+	}
 
+	return uFirstRing;
+}
 
-		//mRotation = MultMatrixMatrix (& mRotation, & mRotate);
+// Split beziers into as few pieces as possible while keeping within the given distance of the curve
+// A tolerance of zero splits every bezier into the full number of pieces
+// All beziers must be regenerated after calling this
+void SetBezierTolerance (float fTolerance, int nPiecesMin, BezPersist * psBezData) {
+	SetTubeTolerance (fTolerance, nPiecesMin, psBezData->psTubeData);
+}
 
-		for (nSegment = 0; nSegment < nSegments; nSegment++) {
-			nIndex = (nPiece * nSegments) + nSegment;
-			fTheta = ((float)nSegment * (2.0 * M_PI / (float)nSegments));// + fCorrection;
+// Set the coarser tessellations used for chunks of tubes that are small on screen
+// The first level is always drawn using the full tessellation, whatever it's given as
+// Each level is used where the tubes are less than afPixels in radius on screen
+// All beziers must be regenerated after calling this, as the arena is reallocated
+void SetBezierDetailLevels (int nLevels, int const * anSegments, int const * anPieces, float const * afPixels, BezPersist * psBezData) {
+	int nLevel;
 
-			vOffset.fX = 0.0f;
-			vOffset.fY = sin (fTheta);
-			vOffset.fZ = cos (fTheta);
+	if (nLevels > BEZ_LEVELS_MAX) {
+		fprintf (stderr, "Too many bezier detail levels; only the first %d will be used.\n", BEZ_LEVELS_MAX);
+		nLevels = BEZ_LEVELS_MAX;
+	}
 
-			// Apply the rotation
-			vOffset = MultMatrixVector (& mRotation, & vOffset);
+	psBezData->nLevels = MAX (nLevels, 1);
+	for (nLevel = 0; nLevel < psBezData->nLevels; nLevel++) {
+		psBezData->anLevelSegments[nLevel] = MAX (anSegments[nLevel], 3);
+		psBezData->anLevelPieces[nLevel] = MAX (anPieces[nLevel], 1);
+		psBezData->afLevelPixels[nLevel] = afPixels[nLevel];
+	}
 
-			asVertex[nIndex].fX = vPos.fX + (fRadius * vOffset.fX);
-			asVertex[nIndex].fY = vPos.fY + (fRadius * vOffset.fY);
-			asVertex[nIndex].fZ = vPos.fZ + (fRadius * vOffset.fZ);
-			asVertex[nIndex].fNX = vOffset.fX;
-			asVertex[nIndex].fNY = vOffset.fY;
-			asVertex[nIndex].fNZ = vOffset.fZ;
+	psBezData->boArenaValid = FALSE;
+	ArrangeDetailLevels (psBezData);
+}
 
-			asVertex[nIndex].afColour[0] = (afEndCol[0] * fColScale) + (afStartCol[0] * (1.0f - fColScale));
-			asVertex[nIndex].afColour[1] = (afEndCol[1] * fColScale) + (afStartCol[1] * (1.0f - fColScale));
-			asVertex[nIndex].afColour[2] = (afEndCol[2] * fColScale) + (afStartCol[2] * (1.0f - fColScale));
-		}
-	}
+// Set the eye position and the scale from distance to pixels on screen, used to choose detail levels
+// A scale of zero draws everything at full detail
+void SetBezierView (Vector3 vEye, float fPixelScale, BezPersist * psBezData) {
+	psBezData->vEye = vEye;
+	psBezData->fPixelScale = fPixelScale;
 }
 
-float BezierCalculateLength (Vector3 vStart, Vector3 vStartDir, Vector3 vEnd, Vector3 vEndDir, BezPersist * psBezData) {
+// The template holds a single tube's worth of vertices, expanded by the vertex shader
+// Each vertex stores the number of its ring along the bezier and its angle around the tube
+void CreateTubeTemplate (BezPersist * psBezData) {
+	GLfloat * afTemplate;
 	int nPiece;
-	Vector3 vPos;
-	Vector3 vPosNext;
-	Vector3 vDelta;
-	float fStep;
-	float fLength;
-
-	fLength = 0.0f;
-	// Find the start position
-	vPos.fX = BEZIER (vStart.fX, vStartDir.fX, vEnd.fX, vEndDir.fX, 0.0f);
-	vPos.fY = BEZIER (vStart.fY, vStartDir.fY, vEnd.fY, vEndDir.fY, 0.0f);
-	vPos.fZ = BEZIER (vStart.fZ, vStartDir.fZ, vEnd.fZ, vEndDir.fZ, 0.0f);
+	int nSegment;
+	int nIndex;
 
-	for (nPiece = 0; nPiece < psBezData->nPieces; nPiece++) {
-		// Calculate the translation due to the bezier curve 
-		fStep = ((float)(nPiece + 1)) / ((float)(psBezData->nPieces));
-		vPosNext.fX = BEZIER (vStart.fX, vStartDir.fX, vEnd.fX, vEndDir.fX, fStep);
-		vPosNext.fY = BEZIER (vStart.fY, vStartDir.fY, vEnd.fY, vEndDir.fY, fStep);
-		vPosNext.fZ = BEZIER (vStart.fZ, vStartDir.fZ, vEnd.fZ, vEndDir.fZ, fStep);
+	afTemplate = g_new0 (GLfloat, (psBezData->nPieces + 1) * psBezData->nSegments * 2);
+	for (nPiece = 0; nPiece <= psBezData->nPieces; nPiece++) {
+		for (nSegment = 0; nSegment < psBezData->nSegments; nSegment++) {
+			nIndex = ((nPiece * psBezData->nSegments) + nSegment) * 2;
+			afTemplate[nIndex + 0] = (float)nPiece;
+			afTemplate[nIndex + 1] = (float)nSegment * (2.0 * M_PI / (float)psBezData->nSegments);
+		}
+	}
 
-		// We're interested in the difference in position between the two
-		vDelta = SubtractVectors (& vPos, & vPosNext);
+	if (psBezData->uTemplate == 0) {
+		glGenBuffers (1, & psBezData->uTemplate);
+		g_assert (psBezData->uTemplate > 0);
+	}
+	glBindBuffer (GL_ARRAY_BUFFER, psBezData->uTemplate);
+	glBufferData (GL_ARRAY_BUFFER, (psBezData->nPieces + 1) * psBezData->nSegments * 2 * sizeof (GLfloat), afTemplate, GL_STATIC_DRAW);
 
-		fLength += Length (& vDelta);
+	g_free (afTemplate);
+}
 
-		vPos = vPosNext;
+// Keep a bounding sphere for the curve in a slot, and the radius of its tube, used when choosing its chunk's detail level
+// The curve lies within the convex hull of its control points
+void SetSlotBound (int nSlot, float fRadius, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, BezPersist * psBezData) {
+	Vector3 const * apvPoint[4] = {pvStart, pvStartDir, pvEndDir, pvEnd};
+	BezBound * psBound;
+	Vector3 vOffset;
+	float fDistance;
+	int nPoint;
+
+	psBound = & psBezData->asSlotBound[nSlot];
+	psBound->vCentre.fX = (pvStart->fX + pvStartDir->fX + pvEndDir->fX + pvEnd->fX) / 4.0f;
+	psBound->vCentre.fY = (pvStart->fY + pvStartDir->fY + pvEndDir->fY + pvEnd->fY) / 4.0f;
+	psBound->vCentre.fZ = (pvStart->fZ + pvStartDir->fZ + pvEndDir->fZ + pvEnd->fZ) / 4.0f;
+
+	psBound->fRadius = 0.0f;
+	for (nPoint = 0; nPoint < 4; nPoint++) {
+		vOffset = SubtractVectors (apvPoint[nPoint], & psBound->vCentre);
+		fDistance = Length (& vOffset);
+		psBound->fRadius = MAX (psBound->fRadius, fDistance);
 	}
+	psBound->fTubeRadius = fRadius;
 
-	return fLength;
+	// During a batch only the slot itself is written to, as other threads may be setting slots in the same chunk
+	if (psBezData->boBatch) {
+		psBound->boChanged = TRUE;
+	}
+	else {
+		psBezData->asChunk[nSlot / CHUNK_SLOTS].boDirty = TRUE;
+	}
 }
 
-Matrix3 CreateRotationMatrix (Vector3 * pvNormal) {
-	Matrix3 mRotation;
-	Vector3 vNormal;
-	Vector3 vOrth1;
-	Vector3 vOrth2;
-	int nDim;
-	int nDimMin;
-	GLfloat fMin;
-	
-	vNormal = * pvNormal;
-	Normalise (& vNormal);
+// Find a sphere around all of the curves in a chunk of slots, and the widest of their tubes
+void UpdateChunkBound (int nChunk, BezPersist * psBezData) {
+	BezBound * psChunkBound;
+	BezBound const * psBound;
+	int nSlot;
+	int nSlotEnd;
+	bool boEmpty;
+	Vector3 vMin;
+	Vector3 vMax;
+	Vector3 vOffset;
+	float fDistance;
+
+	psChunkBound = & psBezData->asChunk[nChunk].sBound;
+	nSlotEnd = MIN ((nChunk + 1) * CHUNK_SLOTS, psBezData->nSlotsUsed);
+
+	// Centre the sphere on the box around the slots' spheres
+	boEmpty = TRUE;
+	for (nSlot = nChunk * CHUNK_SLOTS; nSlot < nSlotEnd; nSlot++) {
+		psBound = & psBezData->asSlotBound[nSlot];
+		if (psBound->fRadius >= 0.0f) {
+			if (boEmpty) {
+				vMin = psBound->vCentre;
+				vMax = psBound->vCentre;
+				boEmpty = FALSE;
+			}
+			vMin.fX = MIN (vMin.fX, psBound->vCentre.fX - psBound->fRadius);
+			vMin.fY = MIN (vMin.fY, psBound->vCentre.fY - psBound->fRadius);
+			vMin.fZ = MIN (vMin.fZ, psBound->vCentre.fZ - psBound->fRadius);
+			vMax.fX = MAX (vMax.fX, psBound->vCentre.fX + psBound->fRadius);
+			vMax.fY = MAX (vMax.fY, psBound->vCentre.fY + psBound->fRadius);
+			vMax.fZ = MAX (vMax.fZ, psBound->vCentre.fZ + psBound->fRadius);
+		}
+	}
 
-	// Choose the dimension vector that's smallest
-	nDimMin = 0;
-	fMin = ((GLfloat *)& vNormal)[nDimMin];
-	for (nDim = 1; nDim < 3; nDim++) {
-		if (absf(((GLfloat *)& vNormal)[nDim]) < fMin) {
-			nDimMin = nDim;
-			fMin = absf(((GLfloat *)& vNormal)[nDim]);
+	psChunkBound->fRadius = -1.0f;
+	psChunkBound->fTubeRadius = 0.0f;
+	if (!boEmpty) {
+		psChunkBound->vCentre.fX = (vMin.fX + vMax.fX) / 2.0f;
+		psChunkBound->vCentre.fY = (vMin.fY + vMax.fY) / 2.0f;
+		psChunkBound->vCentre.fZ = (vMin.fZ + vMax.fZ) / 2.0f;
+
+		for (nSlot = nChunk * CHUNK_SLOTS; nSlot < nSlotEnd; nSlot++) {
+			psBound = & psBezData->asSlotBound[nSlot];
+			if (psBound->fRadius >= 0.0f) {
+				vOffset = SubtractVectors (& psBound->vCentre, & psChunkBound->vCentre);
+				fDistance = Length (& vOffset) + psBound->fRadius;
+				psChunkBound->fRadius = MAX (psChunkBound->fRadius, fDistance);
+				psChunkBound->fTubeRadius = MAX (psChunkBound->fTubeRadius, psBound->fTubeRadius);
+			}
 		}
 	}
 
-	vOrth1.fX = 0.0f;
-	vOrth1.fY = 0.0f;
-	vOrth1.fZ = 0.0f;
-	((GLfloat *)& vOrth1)[nDimMin] = 1.0f;
-	
-	for (nDim = 0; nDim < 3; nDim++) {
-		((GLfloat *)& vOrth1)[nDim] -= fMin * ((GLfloat *)& vNormal)[nDim];
+	psBezData->asChunk[nChunk].boDirty = FALSE;
+}
+
+// Choose the detail level for a chunk of slots from the size of its tubes on screen, as drawn by the copy
+// (or as drawn itself if nCopy is zero and by copy nCopy - 1 otherwise)
+// A chunk must pass some way beyond a level's threshold before it changes level, to stop it popping back and forth
+int ChooseChunkLevel (int nChunk, int nCopy, BezPersist * psBezData) {
+	BezChunk * psChunk;
+	BezCopy const * psCopy;
+	Matrix3 mRotate;
+	Vector3 vCentre;
+	Vector3 vOffset;
+	float fDistance;
+	float fPixels;
+	float fThreshold;
+	float fTubeRadius;
+	int nLevel;
+	int nLevelTry;
+
+	psChunk = & psBezData->asChunk[nChunk];
+	if (psChunk->boDirty) {
+		UpdateChunkBound (nChunk, psBezData);
 	}
 
-	Normalise (& vOrth1);
-	vOrth2 = CrossProduct (& vNormal, & vOrth1);
-	Normalise (& vOrth2);
+	// If the shader adds the radius, the tubes are drawn with its current radius rather than the one they were set with
+	fTubeRadius = (psBezData->boShaderRadius ? psBezData->fTubeRadius : psChunk->sBound.fTubeRadius);
 
-	mRotation.fA1 = vNormal.fX;
-	mRotation.fA2 = vNormal.fY;
-	mRotation.fA3 = vNormal.fZ;
+	// Measure to the nearest point of the chunk so that none of it is drawn too coarsely
+	vCentre = psChunk->sBound.vCentre;
+	if (nCopy > 0) {
+		psCopy = & psBezData->asCopy[nCopy - 1];
+		mRotate = psCopy->mRotate;
+		vCentre = MultMatrixVector (& mRotate, & vCentre);
+		vCentre = AddVectors (& vCentre, & psCopy->vTranslate);
+	}
+	vOffset = SubtractVectors (& vCentre, & psBezData->vEye);
+	fDistance = Length (& vOffset) - (psChunk->sBound.fRadius + fTubeRadius);
+
+	nLevel = 0;
+	if ((psChunk->sBound.fRadius >= 0.0f) && (fDistance > 0.0f)) {
+		fPixels = fTubeRadius * psBezData->fPixelScale / fDistance;
+		for (nLevelTry = 1; nLevelTry < psBezData->nLevelsUsed; nLevelTry++) {
+			if (nLevelTry > psChunk->anLevel[nCopy]) {
+				fThreshold = psBezData->afLevelThreshold[nLevelTry] * (1.0f - LEVEL_HYSTERESIS);
+			}
+			else {
+				fThreshold = psBezData->afLevelThreshold[nLevelTry] * (1.0f + LEVEL_HYSTERESIS);
+			}
+			if (fPixels < fThreshold) {
+				nLevel = nLevelTry;
+			}
+		}
+	}
+	psChunk->anLevel[nCopy] = nLevel;
 
-	mRotation.fB1 = vOrth1.fX;
-	mRotation.fB2 = vOrth1.fY;
-	mRotation.fB3 = vOrth1.fZ;
+	return nLevel;
+}
 
-	mRotation.fC1 = vOrth2.fX;
-	mRotation.fC2 = vOrth2.fY;
-	mRotation.fC3 = vOrth2.fZ;
+// Draw the slots set to be drawn in a copy, moved into place by the modelview matrix
+// The vertex arrays must already be set up to draw from the arena
+void DrawBezierCopy (int nCopy, BezPersist * psBezData) {
+	BezCopy const * psCopy;
+	GLfloat afMatrix[16];
+	int nSlot;
+	int nLevel;
+	bool boLevels;
+
+	psCopy = & psBezData->asCopy[nCopy];
+
+	// Slots that aren't in the copy draw nothing, and the rest use their chunk's detail level in the copy
+	boLevels = (psBezData->nLevelsUsed > 1) && (psBezData->fPixelScale > 0.0f);
+	nLevel = 0;
+	for (nSlot = 0; nSlot < psBezData->nSlotsUsed; nSlot++) {
+		if (boLevels && ((nSlot % CHUNK_SLOTS) == 0)) {
+			nLevel = ChooseChunkLevel (nSlot / CHUNK_SLOTS, nCopy + 1, psBezData);
+		}
+		if (psBezData->auSlotCopies[nSlot] & (1u << nCopy)) {
+			psBezData->anCopyCount[nSlot] = psBezData->anIndexCount[LEVEL_SLOT (nLevel, nSlot, psBezData)];
+		}
+		else {
+			psBezData->anCopyCount[nSlot] = 0;
+		}
+		psBezData->apCopyOffset[nSlot] = psBezData->apIndexOffset[LEVEL_SLOT (nLevel, nSlot, psBezData)];
+	}
 
-	return mRotation;
+	// The rotation is stored by column, as GL expects
+	afMatrix[0] = psCopy->mRotate.fA1;
+	afMatrix[1] = psCopy->mRotate.fA2;
+	afMatrix[2] = psCopy->mRotate.fA3;
+	afMatrix[3] = 0.0f;
+	afMatrix[4] = psCopy->mRotate.fB1;
+	afMatrix[5] = psCopy->mRotate.fB2;
+	afMatrix[6] = psCopy->mRotate.fB3;
+	afMatrix[7] = 0.0f;
+	afMatrix[8] = psCopy->mRotate.fC1;
+	afMatrix[9] = psCopy->mRotate.fC2;
+	afMatrix[10] = psCopy->mRotate.fC3;
+	afMatrix[11] = 0.0f;
+	afMatrix[12] = psCopy->vTranslate.fX;
+	afMatrix[13] = psCopy->vTranslate.fY;
+	afMatrix[14] = psCopy->vTranslate.fZ;
+	afMatrix[15] = 1.0f;
+
+	if (psCopy->nPaletteOffset != 0) {
+		glUniform1f (psBezData->nPaletteOffsetUniform, (float)psCopy->nPaletteOffset);
+	}
+	glPushMatrix ();
+	glMultMatrixf (afMatrix);
+	glMultiDrawElements (GL_TRIANGLE_STRIP, psBezData->anCopyCount, GL_UNSIGNED_INT, psBezData->apCopyOffset, psBezData->nSlotsUsed);
+	glPopMatrix ();
+	if (psBezData->nPaletteOffsetUniform >= 0) {
+		glUniform1f (psBezData->nPaletteOffsetUniform, 0.0f);
+	}
 }
 
 void DisplayBeziers (BezPersist * psBezData) {
-	Bezier * psBezier;
-	
+	int nAttrib;
+	int nChunk;
+	int nLevel;
+	int nLevelStart;
+	int nSlot;
+	int nSlotStart;
+	int nCopy;
+	Vector3 vCompactCentre;
+	Vector3 vCompactScale;
+
 	glMaterialfv (GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, gafDiffuse);
 	glMaterialfv (GL_FRONT_AND_BACK, GL_SPECULAR, gafSpecular);
 	glMaterialfv (GL_FRONT_AND_BACK, GL_SHININESS, gafShininess);
 	glEnable (GL_COLOR_MATERIAL);
 
-	// Render all of the bezier curves
-	psBezier = psBezData->psBezierFirst;
-	while (psBezier) {
-		DrawBezier (0.0, 0.0, 0.0, psBezier, psBezData);
-		psBezier = psBezier->psNext;
+	// Any beziers set since the last draw are now in place
+	UnmapVertexArena (psBezData);
+
+	if (psBezData->boShaderRadius) {
+		glUniform1f (psBezData->nRadiusUniform, psBezData->fTubeRadius);
 	}
-}
 
-void DrawBezier (GLdouble fXCentre, GLdouble fYCentre, GLdouble fZCentre, Bezier * psBezier, BezPersist * psBezData) {
-	int nIndices;
-	int nPiece;
-	glPushMatrix ();
-	glTranslatef (fXCentre, fYCentre, fZCentre);
+	// The shader looks up the colour of each vertex in the palette
+	if (psBezData->boPaletteTexture && (psBezData->nPaletteColours > 0)) {
+		glBindTexture (GL_TEXTURE_1D, psBezData->uPaletteTexture);
+		glUniform1i (psBezData->nPaletteSamplerUniform, 0);
+		glUniform1f (psBezData->nPaletteScaleUniform, 1.0f / (float)psBezData->nPaletteWidth);
+		glUniform1i (psBezData->nPaletteUniform, GL_TRUE);
+	}
 
-	glEnableClientState (GL_VERTEX_ARRAY);
-	glEnableClientState (GL_NORMAL_ARRAY);
-	glEnableClientState (GL_COLOR_ARRAY);
-	glBindBuffer (GL_ARRAY_BUFFER, psBezier->auVertexBuffer[0]);
+	if ((psBezData->nSlotsUsed > 0) && psBezData->boInstanced) {
+		ReserveVertexArena (psBezData);
 
-	glVertexPointer (3, GL_FLOAT, sizeof (KnotVertex), 0);
-	glNormalPointer (GL_FLOAT, sizeof (KnotVertex), BUFFER_OFFSET (12));
-	glColorPointer (BEZ_COL_COMPONENTS, GL_FLOAT, sizeof (KnotVertex), BUFFER_OFFSET (24));
+		// The template supplies the position of each vertex on the tube
+		glEnableClientState (GL_VERTEX_ARRAY);
+		glBindBuffer (GL_ARRAY_BUFFER, psBezData->uTemplate);
+		glVertexPointer (2, GL_FLOAT, 0, BUFFER_OFFSET (0));
 
-	nIndices = (psBezData->nSegments + 1) * 2;
-	for (nPiece = 0; nPiece < psBezData->nPieces; nPiece++) {
-		glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, psBezData->auIndexBuffer[nPiece]);
-		glDrawRangeElements (GL_TRIANGLE_STRIP, 0, nIndices, nIndices, GL_UNSIGNED_SHORT, BUFFER_OFFSET (0));
-	}
+		// The arena supplies the control points, advancing once per tube
+		glBindBuffer (GL_ARRAY_BUFFER, psBezData->uVertexArena);
+		for (nAttrib = 0; nAttrib < TUBE_ATTRIBS; nAttrib++) {
+			glEnableVertexAttribArray (psBezData->anTubeAttrib[nAttrib]);
+			glVertexAttribPointer (psBezData->anTubeAttrib[nAttrib], gasTubeAttrib[nAttrib].nSize, GL_FLOAT, GL_FALSE, sizeof (BezInstance), BUFFER_OFFSET (gasTubeAttrib[nAttrib].nOffset));
+			glVertexAttribDivisorARB (psBezData->anTubeAttrib[nAttrib], 1);
+		}
 
-	glDisableClientState (GL_VERTEX_ARRAY);
-	glDisableClientState (GL_NORMAL_ARRAY);
-	glDisableClientState (GL_COLOR_ARRAY);
-	glDisableClientState (GL_INDEX_ARRAY);
+		// Render all of the bezier curves with a single draw call
+		glUniform1i (psBezData->nTubeUniform, GL_TRUE);
+		glUniform1i (psBezData->nTubePiecesUniform, psBezData->nPieces);
+		glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, psBezData->uIndexBuffer);
+		glDrawElementsInstancedARB (GL_TRIANGLE_STRIP, psBezData->nIndicesPerSlot, GL_UNSIGNED_INT, BUFFER_OFFSET (0), psBezData->nSlotsUsed);
+		glUniform1i (psBezData->nTubeUniform, GL_FALSE);
 
-	//glutSolidCube (0.5);
-	glPopMatrix ();
-}
+		for (nAttrib = 0; nAttrib < TUBE_ATTRIBS; nAttrib++) {
+			glVertexAttribDivisorARB (psBezData->anTubeAttrib[nAttrib], 0);
+			glDisableVertexAttribArray (psBezData->anTubeAttrib[nAttrib]);
+		}
+		glDisableClientState (GL_VERTEX_ARRAY);
+	}
+	else if (psBezData->nSlotsUsed > 0) {
+		ReserveVertexArena (psBezData);
+
+		glEnableClientState (GL_VERTEX_ARRAY);
+		glEnableClientState (GL_COLOR_ARRAY);
+		glBindBuffer (GL_ARRAY_BUFFER, psBezData->uVertexArena);
+		if (psBezData->boCompact) {
+			// The shader scales the positions back out of the bounds and unfolds the normals
+			glEnableVertexAttribArray (psBezData->nCompactNormalAttrib);
+			glVertexPointer (4, GL_SHORT, sizeof (CompactVertex), BUFFER_OFFSET (offsetof (CompactVertex, anPos)));
+			glVertexAttribPointer (psBezData->nCompactNormalAttrib, 2, GL_SHORT, GL_TRUE, sizeof (CompactVertex), BUFFER_OFFSET (offsetof (CompactVertex, anNormal)));
+			glColorPointer (4, GL_UNSIGNED_BYTE, sizeof (CompactVertex), BUFFER_OFFSET (offsetof (CompactVertex, aucColour)));
+			glUniform1i (psBezData->nCompactUniform, GL_TRUE);
+			GetTubeBounds (& vCompactCentre, & vCompactScale, psBezData->psTubeData);
+			glUniform3f (psBezData->nCompactOffsetUniform, vCompactCentre.fX, vCompactCentre.fY, vCompactCentre.fZ);
+			glUniform3f (psBezData->nCompactScaleUniform, vCompactScale.fX, vCompactScale.fY, vCompactScale.fZ);
+		}
+		else {
+			glEnableClientState (GL_NORMAL_ARRAY);
+			glVertexPointer (3, GL_FLOAT, sizeof (KnotVertex), BUFFER_OFFSET (0));
+			glNormalPointer (GL_FLOAT, sizeof (KnotVertex), BUFFER_OFFSET (12));
+			glColorPointer (BEZ_COL_COMPONENTS, GL_FLOAT, sizeof (KnotVertex), BUFFER_OFFSET (24));
+		}
 
-// Use De Casteljau's algorithm to split a bezier curve into two subcurves
-void SplitBezier (Vector3 vStart, Vector3 * pvStartDir, Vector3 vEnd, Vector3 * pvEndDir, float fRatio, Vector3 * pvMid, Vector3 * pvMidDirBack, Vector3 * pvMidDirForward) {
-	Vector3 vMid0;
-	Vector3 vMid1;
-	Vector3 vMid2;
+		// Render all of the bezier curves with as few draw calls as possible
+		// Each slot only draws as many pieces as its bezier was split into
+		glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, psBezData->uIndexBuffer);
+		if ((psBezData->nLevelsUsed > 1) && (psBezData->fPixelScale > 0.0f)) {
+			// Runs of chunks at the same detail level are drawn together
+			nSlotStart = 0;
+			nLevelStart = ChooseChunkLevel (0, 0, psBezData);
+			for (nChunk = 1; (nChunk * CHUNK_SLOTS) < psBezData->nSlotsUsed; nChunk++) {
+				nLevel = ChooseChunkLevel (nChunk, 0, psBezData);
+				if (nLevel != nLevelStart) {
+					nSlot = nChunk * CHUNK_SLOTS;
+					glMultiDrawElements (GL_TRIANGLE_STRIP, psBezData->anIndexCount + LEVEL_SLOT (nLevelStart, nSlotStart, psBezData), GL_UNSIGNED_INT, psBezData->apIndexOffset + LEVEL_SLOT (nLevelStart, nSlotStart, psBezData), nSlot - nSlotStart);
+					nSlotStart = nSlot;
+					nLevelStart = nLevel;
+				}
+			}
+			glMultiDrawElements (GL_TRIANGLE_STRIP, psBezData->anIndexCount + LEVEL_SLOT (nLevelStart, nSlotStart, psBezData), GL_UNSIGNED_INT, psBezData->apIndexOffset + LEVEL_SLOT (nLevelStart, nSlotStart, psBezData), psBezData->nSlotsUsed - nSlotStart);
+		}
+		else {
+			glMultiDrawElements (GL_TRIANGLE_STRIP, psBezData->anIndexCount, GL_UNSIGNED_INT, psBezData->apIndexOffset, psBezData->nSlotsUsed);
+		}
 
-	if (pvStartDir && pvEndDir) {
-		vMid0 = SplitLine (vStart, *pvStartDir, fRatio);
-		vMid1 = SplitLine (*pvStartDir, *pvEndDir, fRatio);
-		vMid2 = SplitLine (*pvEndDir, vEnd, fRatio);
+		// The copies are drawn from the same vertices, moved into place
+		for (nCopy = 0; nCopy < psBezData->nCopies; nCopy++) {
+			DrawBezierCopy (nCopy, psBezData);
+		}
 
-		if (pvMidDirBack && pvMidDirForward && pvMid) {
-			*pvMidDirBack = SplitLine (vMid0, vMid1, fRatio);
-			*pvMidDirForward = SplitLine (vMid1, vMid2, fRatio);
-			*pvMid = SplitLine (*pvMidDirBack, *pvMidDirForward, fRatio);
+		if (psBezData->boCompact) {
+			glUniform1i (psBezData->nCompactUniform, GL_FALSE);
+			glDisableVertexAttribArray (psBezData->nCompactNormalAttrib);
 		}
-		
-		*pvStartDir = vMid0;
-		*pvEndDir = vMid2;
+		glDisableClientState (GL_VERTEX_ARRAY);
+		glDisableClientState (GL_NORMAL_ARRAY);
+		glDisableClientState (GL_COLOR_ARRAY);
+		glDisableClientState (GL_INDEX_ARRAY);
 	}
-}
 
-// Find the point along a line between two points based on a proportion of the distance between them
-Vector3 SplitLine (Vector3 vStart, Vector3 vEnd, float fRatio) {
-	Vector3 vMid;
-	
-	vMid.fX = (vStart.fX * (1.0f - fRatio)) + (vEnd.fX * (fRatio));
-	vMid.fY = (vStart.fY * (1.0f - fRatio)) + (vEnd.fY * (fRatio));
-	vMid.fZ = (vStart.fZ * (1.0f - fRatio)) + (vEnd.fZ * (fRatio));
-	
-	return vMid;
+	if (psBezData->boPaletteTexture && (psBezData->nPaletteColours > 0)) {
+		glUniform1i (psBezData->nPaletteUniform, GL_FALSE);
+		glBindTexture (GL_TEXTURE_1D, 0);
+	}
 }
 
 void SetAccuracy (int nPieces, int nSegments, BezPersist * psBezData) {
 	// Note that in order to prevent serious problems
 	// all beziers must be regenerated after changing the accuracy values
 
-	// Free the index buffers
-	glDeleteBuffers (psBezData->nPieces, psBezData->auIndexBuffer);
-	g_free (psBezData->auIndexBuffer);
-	psBezData->auIndexBuffer = NULL;
-
-	// Recreate the index buffers
 	psBezData->nPieces = nPieces;
 	psBezData->nSegments = nSegments;
-	psBezData->auIndexBuffer = CreateBezierIndexBuffers (psBezData->nPieces, psBezData->nSegments);
+	SetTubeAccuracy (nPieces, nSegments, psBezData->psTubeData);
+
+	// The size of each arena slot has changed, so the arena and its indices are rebuilt
+	g_free (psBezData->asScratch);
+	psBezData->asScratch = g_new0 (KnotVertex, (nPieces + 1) * nSegments);
+	psBezData->boArenaValid = FALSE;
+	ArrangeDetailLevels (psBezData);
 }
 
 void DeleteBeziers (Bezier * psBezierStart, int nNum, BezPersist * psBezData) {
@@ -15,11 +15,18 @@
 // Includes
 
 #include "utils.h"
+#include "tube.h"
 
 ///////////////////////////////////////////////////////////////////
 // Defines
 
-#define BEZ_COL_COMPONENTS (3)
+#define BEZ_COL_COMPONENTS (TUBE_COL_COMPONENTS)
+
+// Maximum number of tessellation detail levels, including the full tessellation
+#define BEZ_LEVELS_MAX (4)
+
+// Maximum number of transformed copies that can be drawn of each bezier, besides the bezier itself
+#define BEZ_COPIES_MAX (3)
 
 ///////////////////////////////////////////////////////////////////
 // Structures and enumerations
@@ -27,6 +34,17 @@
 typedef struct _BezPersist BezPersist;
 typedef struct _Bezier Bezier;
 
+// One bezier of a chain, which starts where the previous one ends
+typedef TubeLink BezChainLink;
+
+// A rigid transformation drawing a copy of some of the beziers elsewhere, rotated about the origin then translated
+// If there's a palette, the copy's colours are found that many entries further along it
+typedef struct _BezCopy {
+	Matrix3 mRotate;
+	Vector3 vTranslate;
+	int nPaletteOffset;
+} BezCopy;
+
 ///////////////////////////////////////////////////////////////////
 // Global variables
 
@@ -37,19 +55,34 @@ BezPersist * NewBezPersist (int nPieces, int nSegments);
 void DeleteBezPersist (BezPersist * psBezData);
 void DisplayBeziers (BezPersist * psBezData);
 Bezier * NewBezier (BezPersist * psBezData);
+Bezier * ResetBeziers (int nBeziers, BezPersist * psBezData);
 void DeleteBezier (Bezier * psBezier, BezPersist * psBezData);
 void DeleteBeziers (Bezier * psBezierStart, int nNum, BezPersist * psBezData);
 void SetBezierControlPoints (float fRadius, Vector3 vStart, Vector3 vStartDir, Vector3 vEnd, Vector3 vEndDir, float const * afStartCol, float const * afEndCol, Bezier * psBezier, BezPersist * psBezData);
-void SplitBezier (Vector3 vStart, Vector3 * pvStartDir, Vector3 vEnd, Vector3 * pvEndDir, float fRatio, Vector3 * pvMid, Vector3 * pvMidDirBack, Vector3 * pvMidDirForward);
-Vector3 SplitLine (Vector3 vStart, Vector3 vEnd, float fRatio);
+void SetBezierChain (int nLinks, BezChainLink const * asLink, float fRadius, bool boClosed, Bezier * psBezier, BezPersist * psBezData);
 Bezier * GetBezierFirst (BezPersist * psBezData);
 Bezier * GetBezierLast (BezPersist * psBezData);
 Bezier * GetBezierNext (Bezier * psBezier);
 Bezier * GetBezierPrev (Bezier * psBezier);
 void StoreBeziers (bool boStore, BezPersist * psBezData);
 bool OutputStoredBeziers (char const * szFilename, BezPersist * psBezData, bool boBinary);
-float BezierCalculateLength (Vector3 vStart, Vector3 vStartDir, Vector3 vEnd, Vector3 vEndDir, BezPersist * psBezData);
+void SetExportPlaces (int nPlaces, BezPersist * psBezData);
 void SetAccuracy (int nPieces, int nSegments, BezPersist * psBezData);
+void SetBezierShader (GLuint uProgram, BezPersist * psBezData);
+void SetBezierTolerance (float fTolerance, int nPiecesMin, BezPersist * psBezData);
+void SetBezierDetailLevels (int nLevels, int const * anSegments, int const * anPieces, float const * afPixels, BezPersist * psBezData);
+void SetBezierView (Vector3 vEye, float fPixelScale, BezPersist * psBezData);
+void SetBezierInstanced (bool boInstanced, BezPersist * psBezData);
+void SetBezierCompact (bool boCompact, BezPersist * psBezData);
+void SetBezierBounds (Vector3 vMin, Vector3 vMax, BezPersist * psBezData);
+void SetBezierWeld (bool boWeld, BezPersist * psBezData);
+bool SetBezierRadius (float fRadius, BezPersist * psBezData);
+bool SetBezierPalette (int nColours, float const * afColours, BezPersist * psBezData);
+int GetBezierPaletteLimit (BezPersist const * psBezData);
+bool SetBezierCopies (int nCopies, BezCopy const * asCopy, BezPersist * psBezData);
+void SetBezierCopyMask (unsigned int uCopyMask, Bezier * psBezier, BezPersist * psBezData);
+void BeginBezierBatch (BezPersist * psBezData);
+void EndBezierBatch (BezPersist * psBezData);
 
 ///////////////////////////////////////////////////////////////////
 // Function definitions
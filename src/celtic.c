@@ -26,15 +26,65 @@
 #define COLOUR_PLAIN_GREEN (0.7f)
 #define COLOUR_PLAIN_BLUE (0.7f)
 #define COST_PER_UNIT_CUBED (10.0f / (10.0f * 10.0f * 10.0f))
+#define TILES_PER_TASK (16)
+#define LINE_POINT_QUANTUM (0.001f)
 
 /* Enums */
 
 /* Structures */
 
+/* A run of tiles rendered by one worker thread, with its own line cursor and length */
+typedef struct _TileTask {
+	int nTileStart;
+	int nTileEnd;
+	RenderPersist sRenderData;
+} TileTask;
+
+/* Shared by all of the tasks while the tiles are being rendered */
+typedef struct _TileBatch {
+	TileRenderer pfRenderTile;
+	CelticPersist * psCelticData;
+} TileBatch;
+
+/* A loop turned into beziers by one worker thread, starting from its own first bezier */
+typedef struct _LoopTask {
+	KnotLoop const * psLoop;
+	Bezier * psBezier;
+	unsigned int uCopies;
+} LoopTask;
+
+/* Shared by all of the tasks while the loops are being turned into beziers */
+typedef struct _LoopBatch {
+	int nLinesPerTile;
+	CelticPersist * psCelticData;
+} LoopBatch;
+
+/* A pool of worker threads kept for the life of the program, and the batch of tasks it's working through */
+struct _TaskPersist {
+	GThreadPool * psPool;
+	GMutex sMutex;
+	GCond sBatchDone;
+	int nTasksRemaining;
+	GFunc pfTask;
+	gpointer pUserData;
+};
+
 /* Function prototypes */
 void RenderLoadProperty (SETTINGTYPE const eType, char const * szName, void const * const psValue, void * psData, SettingsPersist * psSettingsData);
 void RenderLoadSectionStart (char const * szName, void * psData, SettingsPersist * psSettingsData);
 void RenderLoadSectionEnd (char const * szName, void * psData, SettingsPersist * psSettingsData);
+void RunTasks (int nTasks, gpointer pTasks, gsize uTaskSize, GFunc pfTask, gpointer pUserData, TaskPersist * psTaskData);
+void RunPooledTask (gpointer pData, gpointer pUserData);
+void RenderTileTask (gpointer pData, gpointer pUserData);
+void RenderLoopTask (gpointer pData, gpointer pUserData);
+void ReverseTileCurveHalf (BezChainLink * psTo, BezChainLink const * psFrom);
+int FindLinkLine (LoopLink const * psLink, int nLinesPerTile, RenderPersist const * psRenderData);
+guint HashLinePoint (gconstpointer pKey);
+gboolean EqualLinePoints (gconstpointer pKey1, gconstpointer pKey2);
+VecInt3 QuantiseLinePoint (Vector3 const * pvPoint, float fQuantum);
+int FindLinePoint (Vector3 const * pvPoint, float fQuantum, GHashTable * psLinePoints);
+bool FindLoopImages (BezCopy const * psCopy, int const * anLineLoop, float fQuantum, GHashTable * psLinePoints, int * anLoopImage, int * anCopyColour, CelticPersist * psCelticData);
+void FindLoopCopies (int nLinesPerTile, CelticPersist * psCelticData);
 
 /* Function defininitions */
 void DeleteCelticPersist (CelticPersist * psCelticData) {
@@ -55,6 +105,7 @@ void DeleteCelticPersist (CelticPersist * psCelticData) {
 				DeleteRenderPersist (psCelticData->psRenderData);
 				psCelticData->psRenderData = NULL;
 			}
+			DeleteKnotLoops (psCelticData);
 			free (psCelticData);
 			psCelticData = NULL;
 		}
@@ -76,10 +127,13 @@ RenderPersist * NewRenderPersist (float fXOffset, float fYOffset, float fZOffset
 	psRenderData->vOffset.fZ = fZOffset;
 	psRenderData->psBezData = NULL;
 	psRenderData->psBezierStart = NULL;
-	psRenderData->psBezierCurrent = NULL;
 	psRenderData->nBezierNum = 0;
+	psRenderData->asLine = NULL;
+	psRenderData->psLineCurrent = NULL;
+	psRenderData->nLines = 0;
 	psRenderData->uColourSeed = 0u;
 	psRenderData->asColour = NULL;
+	psRenderData->nColourTiles = 0;
 	psRenderData->uAccuracyLongitudinal = 24u;
 	psRenderData->uAccuracyRadial = 10u;
 	psRenderData->fLength = 0.0f;
@@ -98,8 +152,13 @@ void DeleteRenderPersist (RenderPersist * psRenderData) {
 	if (psRenderData->asColour) {
 		free (psRenderData->asColour);
 		psRenderData->asColour = NULL;
+		psRenderData->nColourTiles = 0;
 	}
 
+	g_free (psRenderData->asLine);
+	psRenderData->asLine = NULL;
+	psRenderData->nLines = 0;
+
 	if (psRenderData) {
 		free (psRenderData);
 		psRenderData = NULL;
@@ -135,6 +194,672 @@ void CopyRenderPersistParams (RenderPersist * psFrom, RenderPersist * psRenderDa
 	//psRenderData->fLength = psFrom->fLength;
 }
 
+/* The worker threads are started once, with one for each processor, and then used for every batch of tasks */
+TaskPersist * NewTaskPersist () {
+	TaskPersist * psTaskData;
+	int nThreads;
+
+	psTaskData = g_new0 (TaskPersist, 1);
+	g_mutex_init (& psTaskData->sMutex);
+	g_cond_init (& psTaskData->sBatchDone);
+	psTaskData->psPool = NULL;
+
+	nThreads = g_get_num_processors ();
+	if (nThreads > 1) {
+		psTaskData->psPool = g_thread_pool_new (RunPooledTask, psTaskData, nThreads, TRUE, NULL);
+	}
+
+	return psTaskData;
+}
+
+void DeleteTaskPersist (TaskPersist * psTaskData) {
+	if (psTaskData) {
+		if (psTaskData->psPool) {
+			g_thread_pool_free (psTaskData->psPool, FALSE, TRUE);
+			psTaskData->psPool = NULL;
+		}
+		g_cond_clear (& psTaskData->sBatchDone);
+		g_mutex_clear (& psTaskData->sMutex);
+
+		g_free (psTaskData);
+		psTaskData = NULL;
+	}
+}
+
+/* Run a set of tasks, sharing them between the pool of worker threads */
+/* Only one batch is run at a time, and it's complete by the time this returns */
+void RunTasks (int nTasks, gpointer pTasks, gsize uTaskSize, GFunc pfTask, gpointer pUserData, TaskPersist * psTaskData) {
+	int nTask;
+
+	if ((psTaskData->psPool != NULL) && (nTasks > 1)) {
+		g_mutex_lock (& psTaskData->sMutex);
+		psTaskData->pfTask = pfTask;
+		psTaskData->pUserData = pUserData;
+		psTaskData->nTasksRemaining = nTasks;
+		g_mutex_unlock (& psTaskData->sMutex);
+
+		for (nTask = 0; nTask < nTasks; nTask++) {
+			g_thread_pool_push (psTaskData->psPool, (char *)pTasks + (nTask * uTaskSize), NULL);
+		}
+
+		/* Wait for all of the tasks to complete */
+		g_mutex_lock (& psTaskData->sMutex);
+		while (psTaskData->nTasksRemaining > 0) {
+			g_cond_wait (& psTaskData->sBatchDone, & psTaskData->sMutex);
+		}
+		g_mutex_unlock (& psTaskData->sMutex);
+	}
+	else {
+		for (nTask = 0; nTask < nTasks; nTask++) {
+			(*pfTask) ((char *)pTasks + (nTask * uTaskSize), pUserData);
+		}
+	}
+}
+
+/* Run one task of the current batch on a worker thread, and wake RunTasks once they're all done */
+void RunPooledTask (gpointer pData, gpointer pUserData) {
+	TaskPersist * psTaskData;
+
+	psTaskData = (TaskPersist *)pUserData;
+	(*psTaskData->pfTask) (pData, psTaskData->pUserData);
+
+	g_mutex_lock (& psTaskData->sMutex);
+	psTaskData->nTasksRemaining--;
+	if (psTaskData->nTasksRemaining == 0) {
+		g_cond_signal (& psTaskData->sBatchDone);
+	}
+	g_mutex_unlock (& psTaskData->sMutex);
+}
+
+/* Find the lines across every tile of the knot, sharing the tiles between a pool of worker threads */
+/* Each tile only sets its own lines, so the result doesn't depend on how the work is shared */
+void RenderTiles (int nTiles, int nLinesPerTile, TileRenderer pfRenderTile, CelticPersist * psCelticData) {
+	RenderPersist * psRenderData;
+	TileBatch sBatch;
+	TileTask * asTask;
+	int nTasks;
+	int nTask;
+
+	psRenderData = psCelticData->psRenderData;
+
+	/* Make space for the lines of every tile */
+	if (psRenderData->nLines != (nTiles * nLinesPerTile)) {
+		g_free (psRenderData->asLine);
+		psRenderData->nLines = (nTiles * nLinesPerTile);
+		psRenderData->asLine = g_new0 (TileCurve, psRenderData->nLines);
+	}
+
+	sBatch.pfRenderTile = pfRenderTile;
+	sBatch.psCelticData = psCelticData;
+
+	/* Each task works on its own copy of the render data */
+	nTasks = (nTiles + TILES_PER_TASK - 1) / TILES_PER_TASK;
+	asTask = g_new (TileTask, nTasks);
+	for (nTask = 0; nTask < nTasks; nTask++) {
+		asTask[nTask].nTileStart = nTask * TILES_PER_TASK;
+		asTask[nTask].nTileEnd = MIN ((nTask + 1) * TILES_PER_TASK, nTiles);
+		asTask[nTask].sRenderData = *psRenderData;
+		asTask[nTask].sRenderData.fLength = 0.0f;
+	}
+
+	RunTasks (nTasks, asTask, sizeof (TileTask), RenderTileTask, & sBatch, psCelticData->psTaskData);
+
+	/* Add up the lengths in a fixed order so the total is always the same */
+	for (nTask = 0; nTask < nTasks; nTask++) {
+		psRenderData->fLength += asTask[nTask].sRenderData.fLength;
+	}
+	psRenderData->psLineCurrent = NULL;
+
+	g_free (asTask);
+}
+
+void RenderTileTask (gpointer pData, gpointer pUserData) {
+	TileTask * psTask;
+	TileBatch * psBatch;
+	int nTile;
+
+	psTask = (TileTask *)pData;
+	psBatch = (TileBatch *)pUserData;
+	for (nTile = psTask->nTileStart; nTile < psTask->nTileEnd; nTile++) {
+		(*psBatch->pfRenderTile) (nTile, & psTask->sRenderData, psBatch->psCelticData);
+	}
+}
+
+/* Turn each loop found when the tiles were coloured into a single chain of beziers, sharing the loops between a pool of worker threads */
+/* The beziers are handed out to the loops in order, so each loop always sets the same ones */
+/* Loops that are drawn as copies of others don't need beziers of their own, so there may be fewer beziers than the loops have lines */
+void RenderLoops (int nLinesPerTile, CelticPersist * psCelticData) {
+	RenderPersist * psRenderData;
+	LoopBatch sBatch;
+	LoopTask * asTask;
+	Bezier * psBezier;
+	int nBeziers;
+	int nBezier;
+	int nLoop;
+	int nTasks;
+
+	psRenderData = psCelticData->psRenderData;
+
+	sBatch.nLinesPerTile = nLinesPerTile;
+	sBatch.psCelticData = psCelticData;
+
+	FindLoopCopies (nLinesPerTile, psCelticData);
+
+	nBeziers = 0;
+	for (nLoop = 0; nLoop < psCelticData->nKnotLoops; nLoop++) {
+		if (psCelticData->anLoopCopies[nLoop] >= 0) {
+			nBeziers += psCelticData->asKnotLoop[nLoop].nLinks * BEZIERS_PER_LINE;
+		}
+	}
+	if (psRenderData->nBezierNum != nBeziers) {
+		psRenderData->nBezierNum = nBeziers;
+		psRenderData->psBezierStart = ResetBeziers (nBeziers, psRenderData->psBezData);
+	}
+
+	/* Find the first bezier of each loop that's rendered */
+	asTask = g_new (LoopTask, psCelticData->nKnotLoops);
+	psBezier = psRenderData->psBezierStart;
+	nTasks = 0;
+	for (nLoop = 0; nLoop < psCelticData->nKnotLoops; nLoop++) {
+		if (psCelticData->anLoopCopies[nLoop] >= 0) {
+			asTask[nTasks].psLoop = & psCelticData->asKnotLoop[nLoop];
+			asTask[nTasks].psBezier = psBezier;
+			asTask[nTasks].uCopies = (unsigned int)psCelticData->anLoopCopies[nLoop];
+			for (nBezier = 0; nBezier < (psCelticData->asKnotLoop[nLoop].nLinks * BEZIERS_PER_LINE); nBezier++) {
+				psBezier = GetBezierNext (psBezier);
+			}
+			nTasks++;
+		}
+	}
+
+	/* The bezier buffers are mapped on this thread, so that the workers make no GL calls */
+	SetBezierRadius (psRenderData->fThickness, psRenderData->psBezData);
+	RecolourKnots (psCelticData);
+	BeginBezierBatch (psRenderData->psBezData);
+	RunTasks (nTasks, asTask, sizeof (LoopTask), RenderLoopTask, & sBatch, psCelticData->psTaskData);
+	EndBezierBatch (psRenderData->psBezData);
+
+	g_free (asTask);
+}
+
+void RenderLoopTask (gpointer pData, gpointer pUserData) {
+	LoopTask * psTask;
+	LoopBatch * psBatch;
+	RenderPersist * psRenderData;
+	LoopLink const * psLink;
+	TileCurve const * psLine;
+	BezChainLink * asChain;
+	BezChainLink * psHalf;
+	Bezier * psBezier;
+	int nLinks;
+	int nLink;
+	int nLine;
+	int nHalf;
+	int nBezier;
+
+	psTask = (LoopTask *)pData;
+	psBatch = (LoopBatch *)pUserData;
+	psRenderData = psBatch->psCelticData->psRenderData;
+	nLinks = psTask->psLoop->nLinks;
+
+	asChain = g_new (BezChainLink, (nLinks * BEZIERS_PER_LINE));
+	for (nLink = 0; nLink < nLinks; nLink++) {
+		psLink = & psBatch->psCelticData->asLoopLink[psTask->psLoop->nLinkStart + nLink];
+
+		/* Find the line the loop follows across the tile */
+		nLine = FindLinkLine (psLink, psBatch->nLinesPerTile, psRenderData);
+		g_assert (nLine >= 0);
+		psLine = & psRenderData->asLine[nLine];
+		g_assert (psLine->boDraw);
+
+		/* The line may have been drawn in the opposite direction to the loop */
+		/* Its colour is given by the loop's index in the palette */
+		for (nHalf = 0; nHalf < BEZIERS_PER_LINE; nHalf++) {
+			psHalf = & asChain[(nLink * BEZIERS_PER_LINE) + nHalf];
+			if (psLine->nCornerStart == psLink->nCorner) {
+				* psHalf = psLine->asHalf[nHalf];
+			}
+			else {
+				ReverseTileCurveHalf (psHalf, & psLine->asHalf[BEZIERS_PER_LINE - 1 - nHalf]);
+			}
+			memset (psHalf->afStartCol, 0, sizeof (psHalf->afStartCol));
+			memset (psHalf->afEndCol, 0, sizeof (psHalf->afEndCol));
+			psHalf->afStartCol[0] = (float)psTask->psLoop->nColour;
+			psHalf->afEndCol[0] = (float)psTask->psLoop->nColour;
+		}
+	}
+
+	/* The copies are set first, so that they're kept with the beziers' details */
+	psBezier = psTask->psBezier;
+	for (nBezier = 0; nBezier < (nLinks * BEZIERS_PER_LINE); nBezier++) {
+		SetBezierCopyMask (psTask->uCopies, psBezier, psRenderData->psBezData);
+		psBezier = GetBezierNext (psBezier);
+	}
+
+	SetBezierChain ((nLinks * BEZIERS_PER_LINE), asChain, psRenderData->fThickness, psTask->psLoop->boClosed, psTask->psBezier, psRenderData->psBezData);
+	g_free (asChain);
+}
+
+/* Find the line of the link's tile that the loop follows across it, as an index into psRenderData->asLine, or -1 if there isn't one */
+int FindLinkLine (LoopLink const * psLink, int nLinesPerTile, RenderPersist const * psRenderData) {
+	int nLine;
+	int nFound;
+
+	nFound = -1;
+	for (nLine = (psLink->nTile * nLinesPerTile); nLine < ((psLink->nTile + 1) * nLinesPerTile); nLine++) {
+		if ((psRenderData->asLine[nLine].nCornerStart == psLink->nCorner) || (psRenderData->asLine[nLine].nCornerEnd == psLink->nCorner)) {
+			nFound = nLine;
+		}
+	}
+
+	return nFound;
+}
+
+guint HashLinePoint (gconstpointer pKey) {
+	VecInt3 const * pvnPoint;
+
+	pvnPoint = (VecInt3 const *)pKey;
+
+	return (guint)((pvnPoint->nX * 73856093) ^ (pvnPoint->nY * 19349663) ^ (pvnPoint->nZ * 83492791));
+}
+
+gboolean EqualLinePoints (gconstpointer pKey1, gconstpointer pKey2) {
+	VecInt3 const * pvnPoint1;
+	VecInt3 const * pvnPoint2;
+
+	pvnPoint1 = (VecInt3 const *)pKey1;
+	pvnPoint2 = (VecInt3 const *)pKey2;
+
+	return ((pvnPoint1->nX == pvnPoint2->nX) && (pvnPoint1->nY == pvnPoint2->nY) && (pvnPoint1->nZ == pvnPoint2->nZ));
+}
+
+/* Round a point on to the grid used to find lines by their middles */
+VecInt3 QuantiseLinePoint (Vector3 const * pvPoint, float fQuantum) {
+	VecInt3 vnPoint;
+
+	SetVecInt3 (vnPoint, (int)floorf (pvPoint->fX / fQuantum), (int)floorf (pvPoint->fY / fQuantum), (int)floorf (pvPoint->fZ / fQuantum));
+
+	return vnPoint;
+}
+
+/* Find the line whose middle is at the given point, or -1 if there isn't one */
+/* A point found by rotating another may be rounded into the next cell of the grid, so the neighbouring cells are searched too */
+int FindLinePoint (Vector3 const * pvPoint, float fQuantum, GHashTable * psLinePoints) {
+	VecInt3 vnCell;
+	VecInt3 vnSearch;
+	gpointer pLine;
+	int nFound;
+	int nX;
+	int nY;
+	int nZ;
+
+	vnCell = QuantiseLinePoint (pvPoint, fQuantum);
+	nFound = -1;
+	for (nX = -1; nX <= 1; nX++) {
+		for (nY = -1; nY <= 1; nY++) {
+			for (nZ = -1; (nZ <= 1) && (nFound < 0); nZ++) {
+				SetVecInt3 (vnSearch, vnCell.nX + nX, vnCell.nY + nY, vnCell.nZ + nZ);
+				pLine = g_hash_table_lookup (psLinePoints, & vnSearch);
+				if (pLine) {
+					nFound = GPOINTER_TO_INT (pLine) - 1;
+				}
+			}
+		}
+	}
+
+	return nFound;
+}
+
+/* Find the loop that a copy carries each loop on to, and the colour it carries each colour on to */
+/* Returns FALSE if the copy doesn't carry the knot on to itself, with each loop landing on a single loop of the same colour as the others of its colour */
+bool FindLoopImages (BezCopy const * psCopy, int const * anLineLoop, float fQuantum, GHashTable * psLinePoints, int * anLoopImage, int * anCopyColour, CelticPersist * psCelticData) {
+	RenderPersist * psRenderData;
+	KnotLoop const * psLoop;
+	KnotLoop const * psImage;
+	Matrix3 mRotate;
+	Vector3 vPoint;
+	bool boFound;
+	int nLine;
+	int nImage;
+	int nLoop;
+	int nColour;
+
+	psRenderData = psCelticData->psRenderData;
+	mRotate = psCopy->mRotate;
+	for (nLoop = 0; nLoop < psCelticData->nKnotLoops; nLoop++) {
+		anLoopImage[nLoop] = -1;
+	}
+
+	/* Every line must land on the middle of another, and all of the lines of a loop on the same loop */
+	boFound = TRUE;
+	for (nLine = 0; (nLine < psRenderData->nLines) && boFound; nLine++) {
+		if (anLineLoop[nLine] >= 0) {
+			vPoint = psRenderData->asLine[nLine].asHalf[0].vEnd;
+			vPoint = MultMatrixVector (& mRotate, & vPoint);
+			vPoint = AddVectors (& vPoint, & psCopy->vTranslate);
+			nImage = FindLinePoint (& vPoint, fQuantum, psLinePoints);
+			if ((nImage < 0) || (anLineLoop[nImage] < 0)) {
+				boFound = FALSE;
+			}
+			else if (anLoopImage[anLineLoop[nLine]] < 0) {
+				anLoopImage[anLineLoop[nLine]] = anLineLoop[nImage];
+			}
+			else if (anLoopImage[anLineLoop[nLine]] != anLineLoop[nImage]) {
+				boFound = FALSE;
+			}
+		}
+	}
+
+	/* The loops must match up as a whole, and the colours along with them */
+	for (nColour = 0; nColour < psCelticData->nLoops; nColour++) {
+		anCopyColour[nColour] = -1;
+	}
+	for (nLoop = 0; (nLoop < psCelticData->nKnotLoops) && boFound; nLoop++) {
+		psLoop = & psCelticData->asKnotLoop[nLoop];
+		psImage = & psCelticData->asKnotLoop[anLoopImage[nLoop]];
+		if ((psImage->nLinks != psLoop->nLinks) || (psImage->boClosed != psLoop->boClosed)) {
+			boFound = FALSE;
+		}
+		else if (anCopyColour[psLoop->nColour] < 0) {
+			anCopyColour[psLoop->nColour] = psImage->nColour;
+		}
+		else if (anCopyColour[psLoop->nColour] != psImage->nColour) {
+			boFound = FALSE;
+		}
+	}
+
+	/* Any colours that aren't used stay as they are */
+	for (nColour = 0; nColour < psCelticData->nLoops; nColour++) {
+		if (anCopyColour[nColour] < 0) {
+			anCopyColour[nColour] = nColour;
+		}
+	}
+
+	return boFound;
+}
+
+/* Look for rotations of the knot by half a turn about its centre that carry it on to itself */
+/* Each one found becomes a copy, and of each set of loops that the copies carry on to each other, only the first is rendered and the */
+/* rest are drawn as copies of it; a loop that a copy carries on to itself is rendered whole rather than in parts, so that it has no seams */
+void FindLoopCopies (int nLinesPerTile, CelticPersist * psCelticData) {
+	RenderPersist * psRenderData;
+	GHashTable * psLinePoints;
+	VecInt3 * avnLinePoint;
+	BezCopy * psCopy;
+	Vector3 const * pvPoint;
+	Vector3 vMin;
+	Vector3 vMax;
+	Vector3 vCentre;
+	float fQuantum;
+	bool boEmpty;
+	bool boIdentity;
+	int * anLineLoop;
+	int * anLoopImage;
+	int anDrawn[BEZ_COPIES_MAX + 1];
+	int nDrawn;
+	int nDrawnCheck;
+	int nLoop;
+	int nLink;
+	int nLine;
+	int nAxis;
+	int nCopy;
+	int nColour;
+	int nImage;
+	unsigned int uCopies;
+
+	psRenderData = psCelticData->psRenderData;
+	if (psCelticData->nKnotLoops > psCelticData->nLoopCopiesMax) {
+		psCelticData->nLoopCopiesMax = MAX (psCelticData->nKnotLoops, psCelticData->nLoopCopiesMax * 2);
+		psCelticData->anLoopCopies = g_renew (int, psCelticData->anLoopCopies, psCelticData->nLoopCopiesMax);
+	}
+	for (nLoop = 0; nLoop < psCelticData->nKnotLoops; nLoop++) {
+		psCelticData->anLoopCopies[nLoop] = 0;
+	}
+	psCelticData->nCopies = 0;
+
+	if (psCelticData->boSymmetrify && (psCelticData->nKnotLoops > 0)) {
+		/* Find the loop each line belongs to, and the box around the middles of the lines */
+		anLineLoop = g_new (int, psRenderData->nLines);
+		for (nLine = 0; nLine < psRenderData->nLines; nLine++) {
+			anLineLoop[nLine] = -1;
+		}
+		boEmpty = TRUE;
+		for (nLoop = 0; nLoop < psCelticData->nKnotLoops; nLoop++) {
+			for (nLink = 0; nLink < psCelticData->asKnotLoop[nLoop].nLinks; nLink++) {
+				nLine = FindLinkLine (& psCelticData->asLoopLink[psCelticData->asKnotLoop[nLoop].nLinkStart + nLink], nLinesPerTile, psRenderData);
+				if (nLine >= 0) {
+					anLineLoop[nLine] = nLoop;
+					pvPoint = & psRenderData->asLine[nLine].asHalf[0].vEnd;
+					if (boEmpty) {
+						vMin = * pvPoint;
+						vMax = * pvPoint;
+						boEmpty = FALSE;
+					}
+					vMin.fX = MIN (vMin.fX, pvPoint->fX);
+					vMin.fY = MIN (vMin.fY, pvPoint->fY);
+					vMin.fZ = MIN (vMin.fZ, pvPoint->fZ);
+					vMax.fX = MAX (vMax.fX, pvPoint->fX);
+					vMax.fY = MAX (vMax.fY, pvPoint->fY);
+					vMax.fZ = MAX (vMax.fZ, pvPoint->fZ);
+				}
+			}
+		}
+
+		if (!boEmpty) {
+			/* Lines are found by their middles, which are far further apart than the grid */
+			fQuantum = LINE_POINT_QUANTUM * MAX (MAX (psCelticData->vTileSize.fX, psCelticData->vTileSize.fY), MAX (psCelticData->vTileSize.fZ, 1.0f));
+			avnLinePoint = g_new (VecInt3, psRenderData->nLines);
+			psLinePoints = g_hash_table_new (HashLinePoint, EqualLinePoints);
+			for (nLine = 0; nLine < psRenderData->nLines; nLine++) {
+				if (anLineLoop[nLine] >= 0) {
+					avnLinePoint[nLine] = QuantiseLinePoint (& psRenderData->asLine[nLine].asHalf[0].vEnd, fQuantum);
+					g_hash_table_insert (psLinePoints, & avnLinePoint[nLine], GINT_TO_POINTER (nLine + 1));
+				}
+			}
+
+			/* Try a half turn about each axis through the centre of the knot */
+			SetVector3 (vCentre, (vMin.fX + vMax.fX) / 2.0f, (vMin.fY + vMax.fY) / 2.0f, (vMin.fZ + vMax.fZ) / 2.0f);
+			anLoopImage = g_new (int, BEZ_COPIES_MAX * psCelticData->nKnotLoops);
+			psCelticData->anCopyColour = g_renew (int, psCelticData->anCopyColour, BEZ_COPIES_MAX * MAX (psCelticData->nLoops, 1));
+			for (nAxis = 0; nAxis < 3; nAxis++) {
+				nCopy = psCelticData->nCopies;
+				psCopy = & psCelticData->asCopy[nCopy];
+				SetIdentity (& psCopy->mRotate);
+				psCopy->mRotate.fA1 = ((nAxis == 0) ? 1.0f : -1.0f);
+				psCopy->mRotate.fB2 = ((nAxis == 1) ? 1.0f : -1.0f);
+				psCopy->mRotate.fC3 = ((nAxis == 2) ? 1.0f : -1.0f);
+				SetVector3 (psCopy->vTranslate, vCentre.fX - (psCopy->mRotate.fA1 * vCentre.fX), vCentre.fY - (psCopy->mRotate.fB2 * vCentre.fY), vCentre.fZ - (psCopy->mRotate.fC3 * vCentre.fZ));
+
+				if (FindLoopImages (psCopy, anLineLoop, fQuantum, psLinePoints, anLoopImage + (nCopy * psCelticData->nKnotLoops), psCelticData->anCopyColour + (nCopy * psCelticData->nLoops), psCelticData)) {
+					/* A copy that changes the colours takes them from its own part of the palette */
+					boIdentity = TRUE;
+					for (nColour = 0; nColour < psCelticData->nLoops; nColour++) {
+						if (psCelticData->anCopyColour[(nCopy * psCelticData->nLoops) + nColour] != nColour) {
+							boIdentity = FALSE;
+						}
+					}
+					psCopy->nPaletteOffset = (boIdentity ? 0 : ((nCopy + 1) * psCelticData->nLoops));
+					psCelticData->nCopies++;
+				}
+			}
+
+			/* Copies that change the colours need the whole palette to fit where the shader can look it up */
+			boIdentity = TRUE;
+			for (nCopy = 0; nCopy < psCelticData->nCopies; nCopy++) {
+				if (psCelticData->asCopy[nCopy].nPaletteOffset != 0) {
+					boIdentity = FALSE;
+				}
+			}
+			if (!boIdentity && (((psCelticData->nCopies + 1) * psCelticData->nLoops) > GetBezierPaletteLimit (psRenderData->psBezData))) {
+				psCelticData->nCopies = 0;
+			}
+
+			/* Every loop is rendered if the copies can't be drawn */
+			if (!SetBezierCopies (psCelticData->nCopies, psCelticData->asCopy, psRenderData->psBezData)) {
+				psCelticData->nCopies = 0;
+			}
+
+			/* Only the first loop of each set the copies carry on to each other is rendered, in each copy that reaches a loop not already drawn */
+			for (nLoop = 0; (nLoop < psCelticData->nKnotLoops) && (psCelticData->nCopies > 0); nLoop++) {
+				uCopies = 0u;
+				anDrawn[0] = nLoop;
+				nDrawn = 1;
+				for (nCopy = 0; (nCopy < psCelticData->nCopies) && (psCelticData->anLoopCopies[nLoop] >= 0); nCopy++) {
+					nImage = anLoopImage[(nCopy * psCelticData->nKnotLoops) + nLoop];
+					if (nImage < nLoop) {
+						psCelticData->anLoopCopies[nLoop] = -1;
+					}
+					else {
+						for (nDrawnCheck = 0; (nDrawnCheck < nDrawn) && (anDrawn[nDrawnCheck] != nImage); nDrawnCheck++);
+						if (nDrawnCheck == nDrawn) {
+							anDrawn[nDrawn] = nImage;
+							nDrawn++;
+							uCopies |= (1u << nCopy);
+						}
+					}
+				}
+				if (psCelticData->anLoopCopies[nLoop] >= 0) {
+					psCelticData->anLoopCopies[nLoop] = (int)uCopies;
+				}
+			}
+
+			g_free (anLoopImage);
+			g_hash_table_destroy (psLinePoints);
+			g_free (avnLinePoint);
+		}
+		g_free (anLineLoop);
+	}
+
+	if (psCelticData->nCopies == 0) {
+		SetBezierCopies (0, NULL, psRenderData->psBezData);
+	}
+}
+
+/* Set the control points and colours of one half of a line across a tile */
+void SetTileCurveHalf (BezChainLink * psHalf, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, ColFloats const * psStartColour, ColFloats const * psEndColour) {
+	ColFloats const sPlain = {COLOUR_PLAIN_RED, COLOUR_PLAIN_GREEN, COLOUR_PLAIN_BLUE};
+
+	psHalf->vStart = *pvStart;
+	psHalf->vStartDir = *pvStartDir;
+	psHalf->vEnd = *pvEnd;
+	psHalf->vEndDir = *pvEndDir;
+	memcpy (psHalf->afStartCol, (psStartColour ? psStartColour : & sPlain), sizeof (psHalf->afStartCol));
+	memcpy (psHalf->afEndCol, (psEndColour ? psEndColour : & sPlain), sizeof (psHalf->afEndCol));
+}
+
+/* The same half of a line, but running from its end to its start */
+void ReverseTileCurveHalf (BezChainLink * psTo, BezChainLink const * psFrom) {
+	psTo->vStart = psFrom->vEnd;
+	psTo->vStartDir = psFrom->vEndDir;
+	psTo->vEnd = psFrom->vStart;
+	psTo->vEndDir = psFrom->vStartDir;
+	memcpy (psTo->afStartCol, psFrom->afEndCol, sizeof (psTo->afStartCol));
+	memcpy (psTo->afEndCol, psFrom->afStartCol, sizeof (psTo->afEndCol));
+}
+
+/* Forget the loops found last time the tiles were coloured */
+void ResetKnotLoops (CelticPersist * psCelticData) {
+	psCelticData->nLoopLinks = 0;
+	psCelticData->nKnotLoops = 0;
+	psCelticData->nCopies = 0;
+}
+
+/* Start recording a new loop, which follows on from the links of the previous one */
+/* The colour is the index of the loop's colour in the palette; a broken loop is recorded as several with the same colour */
+void StartKnotLoop (int nColour, CelticPersist * psCelticData) {
+	KnotLoop * psLoop;
+
+	if (psCelticData->nKnotLoops >= psCelticData->nKnotLoopsMax) {
+		psCelticData->nKnotLoopsMax = MAX (psCelticData->nKnotLoopsMax * 2, 16);
+		psCelticData->asKnotLoop = g_renew (KnotLoop, psCelticData->asKnotLoop, psCelticData->nKnotLoopsMax);
+	}
+
+	psLoop = & psCelticData->asKnotLoop[psCelticData->nKnotLoops];
+	psLoop->nLinkStart = psCelticData->nLoopLinks;
+	psLoop->nLinks = 0;
+	psLoop->boClosed = FALSE;
+	psLoop->nColour = nColour;
+	psCelticData->nKnotLoops++;
+}
+
+/* Add the next step to the loop being recorded */
+void AddLoopLink (int nTile, int nCorner, CelticPersist * psCelticData) {
+	g_assert (psCelticData->nKnotLoops > 0);
+
+	if (psCelticData->nLoopLinks >= psCelticData->nLoopLinksMax) {
+		psCelticData->nLoopLinksMax = MAX (psCelticData->nLoopLinksMax * 2, 64);
+		psCelticData->asLoopLink = g_renew (LoopLink, psCelticData->asLoopLink, psCelticData->nLoopLinksMax);
+	}
+
+	psCelticData->asLoopLink[psCelticData->nLoopLinks].nTile = nTile;
+	psCelticData->asLoopLink[psCelticData->nLoopLinks].nCorner = nCorner;
+	psCelticData->nLoopLinks++;
+	psCelticData->asKnotLoop[psCelticData->nKnotLoops - 1].nLinks++;
+}
+
+/* Finish recording a loop, dropping it if nothing was drawn along it */
+void EndKnotLoop (bool boClosed, CelticPersist * psCelticData) {
+	g_assert (psCelticData->nKnotLoops > 0);
+
+	if (psCelticData->asKnotLoop[psCelticData->nKnotLoops - 1].nLinks > 0) {
+		psCelticData->asKnotLoop[psCelticData->nKnotLoops - 1].boClosed = boClosed;
+	}
+	else {
+		psCelticData->nKnotLoops--;
+	}
+}
+
+/* Note how many colours had been drawn from the colour seed before the colour of the given loop */
+void SetLoopDraw (int nLoop, int nDraw, CelticPersist * psCelticData) {
+	if (nLoop >= psCelticData->nLoopDrawsMax) {
+		psCelticData->nLoopDrawsMax = MAX (psCelticData->nLoopDrawsMax * 2, MAX (nLoop + 1, 16));
+		psCelticData->anLoopDraw = g_renew (int, psCelticData->anLoopDraw, psCelticData->nLoopDrawsMax);
+	}
+
+	psCelticData->anLoopDraw[nLoop] = nDraw;
+}
+
+void DeleteKnotLoops (CelticPersist * psCelticData) {
+	g_free (psCelticData->asLoopLink);
+	psCelticData->asLoopLink = NULL;
+	psCelticData->nLoopLinks = 0;
+	psCelticData->nLoopLinksMax = 0;
+
+	g_free (psCelticData->asKnotLoop);
+	psCelticData->asKnotLoop = NULL;
+	psCelticData->nKnotLoops = 0;
+	psCelticData->nKnotLoopsMax = 0;
+
+	g_free (psCelticData->anLoopDraw);
+	psCelticData->anLoopDraw = NULL;
+	psCelticData->nLoopDrawsMax = 0;
+	psCelticData->nColourDraws = 0;
+
+	g_free (psCelticData->anLoopCopies);
+	psCelticData->anLoopCopies = NULL;
+	psCelticData->nLoopCopiesMax = 0;
+	psCelticData->nCopies = 0;
+
+	g_free (psCelticData->anCopyColour);
+	psCelticData->anCopyColour = NULL;
+}
+
+/* Tell the beziers the region the knot occupies, so that their vertices can be stored compactly */
+/* The curves can bulge out of their tiles and are woven above and below them, so the region is widened to allow for this */
+void SetKnotBounds (CelticPersist * psCelticData) {
+	RenderPersist * psRenderData;
+	Vector3 vMin;
+	Vector3 vMax;
+	float fMargin;
+
+	psRenderData = psCelticData->psRenderData;
+	fMargin = MAX (MAX (psCelticData->vTileSize.fX, psCelticData->vTileSize.fY), psCelticData->vTileSize.fZ) + psRenderData->fWeaveHeight + psRenderData->fThickness;
+
+	SetVector3 (vMin, psRenderData->vOffset.fX - fMargin, psRenderData->vOffset.fY - fMargin, psRenderData->vOffset.fZ - fMargin);
+	SetVector3 (vMax, psRenderData->vOffset.fX + (psCelticData->vnSize.nX * psCelticData->vTileSize.fX) + fMargin, psRenderData->vOffset.fY + (psCelticData->vnSize.nY * psCelticData->vTileSize.fY) + fMargin, psRenderData->vOffset.fZ + (psCelticData->vnSize.nZ * psCelticData->vTileSize.fZ) + fMargin);
+	SetBezierBounds (vMin, vMax, psRenderData->psBezData);
+}
+
 /* Main function */
 void GenerateKnot (CelticPersist * psCelticData) {
 	if (psCelticData->GenerateKnot) {
@@ -147,7 +872,6 @@ void SetCelticBezData (BezPersist * psBezData, CelticPersist * psCelticData) {
 
 	if (psBezData == NULL) {
 		psCelticData->psRenderData->psBezierStart = NULL;
-		psCelticData->psRenderData->psBezierCurrent = NULL;
 		psCelticData->psRenderData->nBezierNum = 0;
 	}
 }
@@ -217,6 +941,11 @@ bool SetThickness (float fThickness, CelticPersist * psCelticData) {
 	boChanged = (psCelticData->psRenderData->fThickness != fThickness);
 	psCelticData->psRenderData->fThickness = fThickness;
 
+	/* The shader may be able to change the thickness without the knot being rendered again */
+	if (boChanged && psCelticData->psRenderData->psBezData) {
+		boChanged = SetBezierRadius (fThickness, psCelticData->psRenderData->psBezData);
+	}
+
 	return boChanged;
 }
 
@@ -396,6 +1125,34 @@ unsigned int GetColourSeed (CelticPersist * psCelticData) {
 	return psCelticData->psRenderData->uColourSeed;
 }
 
+/* Set the colour of each loop from the colour seed, without finding the loops again */
+/* Returns TRUE if the knot must be rendered again to show them, because the shader can't look them up itself */
+bool RecolourKnots (CelticPersist * psCelticData) {
+	float * afPalette;
+	bool boRender;
+	int nCopy;
+	int nColour;
+	int nColours;
+
+	boRender = FALSE;
+	if (psCelticData->psRenderData->psBezData && psCelticData->ColourPalette) {
+		nColours = psCelticData->nLoops;
+		afPalette = g_new (float, (psCelticData->nCopies + 1) * MAX (nColours, 1) * BEZ_COL_COMPONENTS);
+		(*psCelticData->ColourPalette) (afPalette, psCelticData);
+
+		/* Each copy is followed by the colours it draws in place of each colour, in case it changes them */
+		for (nCopy = 0; nCopy < psCelticData->nCopies; nCopy++) {
+			for (nColour = 0; nColour < nColours; nColour++) {
+				memcpy (afPalette + ((((nCopy + 1) * nColours) + nColour) * BEZ_COL_COMPONENTS), afPalette + (psCelticData->anCopyColour[(nCopy * nColours) + nColour] * BEZ_COL_COMPONENTS), BEZ_COL_COMPONENTS * sizeof (float));
+			}
+		}
+		boRender = SetBezierPalette ((psCelticData->nCopies + 1) * nColours, afPalette, psCelticData->psRenderData->psBezData);
+		g_free (afPalette);
+	}
+
+	return boRender;
+}
+
 bool SetAccuracyLongitudinal (unsigned int uAccuracy, CelticPersist * psCelticData) {
 	bool boChanged = FALSE;
 
@@ -49,7 +49,11 @@ typedef struct _RenderPersist RenderPersist;
 
 typedef struct _CelticPersist CelticPersist;
 
+typedef struct _TaskPersist TaskPersist;
+
 /* Function prototypes */
+TaskPersist * NewTaskPersist ();
+void DeleteTaskPersist (TaskPersist * psTaskData);
 void DeleteCelticPersist (CelticPersist * psCelticData);
 void CopyCelticPersistParams (CelticPersist * psFrom, CelticPersist * psCelticData);
 void CopyRenderPersistParams (RenderPersist * psFrom, RenderPersist * psRenderData);
@@ -64,6 +68,7 @@ bool SetSeed (unsigned int uSeed, CelticPersist * psCelticData);
 unsigned int GetSeed (CelticPersist * psCelticData);
 bool SetColourSeed (unsigned int uSeed, CelticPersist * psCelticData);
 unsigned int GetColourSeed (CelticPersist * psCelticData);
+bool RecolourKnots (CelticPersist * psCelticData);
 bool SetSymmetrify (bool boSymmetrify, CelticPersist * psCelticData);
 bool GetSymmetrify (CelticPersist * psCelticData);
 bool SetWeirdness (float fWeirdness, CelticPersist * psCelticData);
@@ -26,7 +26,7 @@
 #define Z_PLANE (0.0f)
 #define WEAVE_HEIGHT (0.2f)
 #define CONTROL_SCALE (0.4f)
-#define BEZIERS_PER_TILE (4)
+#define LINES_PER_TILE (2)
 
 /* Enums */
 
@@ -52,6 +52,7 @@ bool ExportModel2D (char const * szFilename, bool boBinary, CelticPersist * psCe
 static void ImageBezierSplit (float fX1, float fY1, float fXDir1, float fYDir1, float fX2, float fY2, float fXDir2, float fYDir2, float fRatio, float fHStart, float fHMid, float fHEnd, ColFloats const * psStartColour, ColFloats const * psEndColour, RenderPersist * psRenderData);
 static void TileLine (float fX, float fY, float fWidth, float fHeight, CORNER eStart, CORNER eEnd, TILE eStartDir, TILE eEndDir, ColFloats const * psStartColour, ColFloats const * psEndColour, RenderPersist * psRenderData);
 static void TileKnot (float fX, float fY, float fWidth, float fHeight, TILE eTopLeft, TILE eTopRight, TILE eBottomRight, TILE eBottomLeft, TILE eCentre, Cube2Colour const * psColours, RenderPersist * psRenderData);
+static void RenderTile2D (int nTile, RenderPersist * psRenderData, CelticPersist * psCelticData);
 static TILE GetCorner (int nXPos, int nYPos, CORNER eCorner, CelticPersist * psCelticData);
 static void SetCorner (int nXPos, int nYPos, CORNER eCorner, TILE eValue, CelticPersist * psCelticData);
 static TILE GetCentre (int nXPos, int nYPos, CelticPersist * psCelticData);
@@ -60,15 +61,16 @@ static void PopulateTiles (TILE eOrientation, CelticPersist * psCelticData);
 static void SymmetrifyTiles (CelticPersist * psCelticData);
 static void FollowKnotInside (VecInt3 * pvnPos, VecInt3 * pvnCorner, CelticPersist * psCelticData);
 static void FollowKnotToNext (VecInt3 * pvnPos, VecInt3 * pvnCorner, CelticPersist * psCelticData);
-static void ColourLoop (VecInt3 * pvnPos, VecInt3 * pvnCorner, Cube2Complete * asCompleted, ColFloats const * psColour, CelticPersist * psCelticData);
+static void ColourLoop (VecInt3 * pvnPos, VecInt3 * pvnCorner, Cube2Complete * asCompleted, ColFloats const * psColour, int nColour, CelticPersist * psCelticData);
 static int ColourTiles (CelticPersist * psCelticData);
 static void SelectColour (ColFloats * psColour, RenderPersist * psRenderData);
+static void ColourPalette2D (float * afPalette, CelticPersist * psCelticData);
 static void CelticLoadProperty (SETTINGTYPE const eType, char const * szName, void const * const psValue, void * psData, SettingsPersist * psSettingsData);
 static void CelticLoadSectionStart (char const * szName, void * psData, SettingsPersist * psSettingsData);
 static void CelticLoadSectionEnd (char const * szName, void * psData, SettingsPersist * psSettingsData);
 
 /* Function defininitions */
-CelticPersist * NewCelticPersist2D (int nWidth, int nHeight, float fTileX, float fTileY, BezPersist * psBezData) {
+CelticPersist * NewCelticPersist2D (int nWidth, int nHeight, float fTileX, float fTileY, TaskPersist * psTaskData, BezPersist * psBezData) {
 	CelticPersist * psCelticData;
 
 	psCelticData = (CelticPersist *)calloc (1, sizeof (CelticPersist));
@@ -85,9 +87,15 @@ CelticPersist * NewCelticPersist2D (int nWidth, int nHeight, float fTileX, float
 	psCelticData->boDebug = FALSE;
 	psCelticData->psRenderData = NewRenderPersist (-(((float)nWidth) * fTileX / 2.0f), -(((float)nHeight) * fTileY / 2.0f), 0.0f);
 	psCelticData->psRenderData->psBezData = psBezData;
+	psCelticData->psTaskData = psTaskData;
 	
 	psCelticData->aeCorner = NULL;
 	psCelticData->aeCentre = NULL;
+	psCelticData->asLoopLink = NULL;
+	psCelticData->asKnotLoop = NULL;
+	psCelticData->anLoopDraw = NULL;
+	psCelticData->anLoopCopies = NULL;
+	psCelticData->anCopyColour = NULL;
 
 	/* Set up the virtual functions */
 	psCelticData->DeleteCelticPersist = & DeleteCelticPersist2D;
@@ -96,6 +104,7 @@ CelticPersist * NewCelticPersist2D (int nWidth, int nHeight, float fTileX, float
 	psCelticData->RenderKnots = & RenderKnots2D;
 
 	psCelticData->GetVolume = & GetVolume2D;
+	psCelticData->ColourPalette = & ColourPalette2D;
 
 	psCelticData->SaveSettingsCeltic = & SaveSettingsCeltic2D;
 	psCelticData->LoadSettingsStartCeltic =  LoadSettingsStartCeltic2D;
@@ -119,6 +128,7 @@ void DeleteCelticPersist2D (CelticPersist * psCelticData) {
 			DeleteRenderPersist (psCelticData->psRenderData);
 			psCelticData->psRenderData = NULL;
 		}
+		DeleteKnotLoops (psCelticData);
 
 		free (psCelticData);
 		psCelticData = NULL;
@@ -127,20 +137,30 @@ void DeleteCelticPersist2D (CelticPersist * psCelticData) {
 
 /* Main function */
 void GenerateKnot2D (CelticPersist * psCelticData) {
-	int nBezier;
 	int nBeziers;
 
 	/* Re-seed the random number generator */
 	srand (psCelticData->uSeed);
 
-	if (psCelticData->aeCorner) {
-		free (psCelticData->aeCorner);
+	/* The tiles are only reallocated if the size of the knot has changed */
+	if ((psCelticData->aeCorner == NULL) || (psCelticData->aeCentre == NULL)
+		|| (psCelticData->vnSizeAllocated.nX != psCelticData->vnSize.nX)
+		|| (psCelticData->vnSizeAllocated.nY != psCelticData->vnSize.nY)
+		|| (psCelticData->vnSizeAllocated.nZ != psCelticData->vnSize.nZ)) {
+		if (psCelticData->aeCorner) {
+			free (psCelticData->aeCorner);
+		}
+		if (psCelticData->aeCentre) {
+			free (psCelticData->aeCentre);
+		}
+		psCelticData->aeCorner = (TILE *)calloc (((psCelticData->vnSize.nY + 1) * (psCelticData->vnSize.nX + 1)), sizeof (TILE));
+		psCelticData->aeCentre = (TILE *)calloc (((psCelticData->vnSize.nY) * (psCelticData->vnSize.nX)), sizeof (TILE));
+		psCelticData->vnSizeAllocated = psCelticData->vnSize;
 	}
-	if (psCelticData->aeCentre) {
-		free (psCelticData->aeCentre);
+	else {
+		memset (psCelticData->aeCorner, 0, ((psCelticData->vnSize.nY + 1) * (psCelticData->vnSize.nX + 1)) * sizeof (TILE));
+		memset (psCelticData->aeCentre, 0, ((psCelticData->vnSize.nY) * (psCelticData->vnSize.nX)) * sizeof (TILE));
 	}
-	psCelticData->aeCorner = (TILE *)calloc (((psCelticData->vnSize.nY + 1) * (psCelticData->vnSize.nX + 1)), sizeof (TILE));
-	psCelticData->aeCentre = (TILE *)calloc (((psCelticData->vnSize.nY) * (psCelticData->vnSize.nX)), sizeof (TILE));
 
 	/* Create the random knot tiles */
 	PopulateTiles (psCelticData->eOrientation, psCelticData);
@@ -151,23 +171,10 @@ void GenerateKnot2D (CelticPersist * psCelticData) {
 
 	psCelticData->nLoops = ColourTiles (psCelticData);
 
-	/* Remove any beziers if there are any */
-	if (psCelticData->psRenderData->nBezierNum > 0) {
-		DeleteBeziers (psCelticData->psRenderData->psBezierStart, psCelticData->psRenderData->nBezierNum, psCelticData->psRenderData->psBezData);
-		psCelticData->psRenderData->psBezierStart = NULL;
-		psCelticData->psRenderData->nBezierNum = 0;
-	}
-
-	/* Generate bezier tubes */
-	nBeziers = (psCelticData->vnSize.nX * psCelticData->vnSize.nY * BEZIERS_PER_TILE);
+	/* Generate bezier tubes, in the order the loops follow them, replacing any there were before */
+	nBeziers = (psCelticData->nLoopLinks * BEZIERS_PER_LINE);
 	psCelticData->psRenderData->nBezierNum = nBeziers;
-	if (nBeziers > 0) {
-		psCelticData->psRenderData->psBezierStart = NewBezier (psCelticData->psRenderData->psBezData);
-
-		for (nBezier = 0; nBezier < (nBeziers - 1); nBezier++) {
-			NewBezier (psCelticData->psRenderData->psBezData);
-		}
-	}
+	psCelticData->psRenderData->psBezierStart = ResetBeziers (nBeziers, psCelticData->psRenderData->psBezData);
 }
 
 /* Find the next piece of knot after the given piece, based on the direction of the string */
@@ -234,18 +241,32 @@ static void FollowKnotToNext (VecInt3 * pvnPos, VecInt3 * pvnCorner, CelticPersi
 	}
 }
 
-static void ColourLoop (VecInt3 * pvnPos, VecInt3 * pvnCorner, Cube2Complete * asCompleted, ColFloats const * psColour, CelticPersist * psCelticData) {
+/* Colour a loop, recording the lines it follows in order */
+static void ColourLoop (VecInt3 * pvnPos, VecInt3 * pvnCorner, Cube2Complete * asCompleted, ColFloats const * psColour, int nColour, CelticPersist * psCelticData) {
 	int nIndex;
 	int nCornerIndex;
+	int nStartIndex;
+	int nStartCornerIndex;
+	int nLinkIndex;
+	int nLinkCornerIndex;
+	TILE eLinkStart;
+	bool boBroken;
 	VecInt3 vnUnitSize;
 
 	SetVecInt3 (vnUnitSize, 2, 2, 1);
 
 	nIndex = ConvertToIndex (pvnPos, & psCelticData->vnSize);
 	nCornerIndex = ConvertToIndex (pvnCorner, & vnUnitSize);
+	nStartIndex = nIndex;
+	nStartCornerIndex = nCornerIndex;
+	boBroken = FALSE;
 
+	StartKnotLoop (nColour, psCelticData);
 	do {
 		asCompleted[nIndex].aCorner[nCornerIndex] = TRUE;
+		nLinkIndex = nIndex;
+		nLinkCornerIndex = nCornerIndex;
+		eLinkStart = GetCorner (pvnPos->nX, pvnPos->nY, (CORNER)nCornerIndex, psCelticData);
 		FollowKnotInside (pvnPos, pvnCorner, psCelticData);
 
 		nIndex = ConvertToIndex (pvnPos, & psCelticData->vnSize);
@@ -253,12 +274,25 @@ static void ColourLoop (VecInt3 * pvnPos, VecInt3 * pvnCorner, Cube2Complete * a
 		psCelticData->psRenderData->asColour2D[nIndex].aCorner[nCornerIndex] = * psColour;
 		asCompleted[nIndex].aCorner[nCornerIndex] = TRUE;
 
+		/* Lines to an invalid corner aren't drawn, so they break the loop */
+		if ((eLinkStart != TILE_INVALID) && (GetCorner (pvnPos->nX, pvnPos->nY, (CORNER)nCornerIndex, psCelticData) != TILE_INVALID)) {
+			AddLoopLink (nLinkIndex, nLinkCornerIndex, psCelticData);
+		}
+		else {
+			EndKnotLoop (FALSE, psCelticData);
+			StartKnotLoop (nColour, psCelticData);
+			boBroken = TRUE;
+		}
+
 		FollowKnotToNext (pvnPos, pvnCorner, psCelticData);
 
 		nIndex = ConvertToIndex (pvnPos, & psCelticData->vnSize);
 		nCornerIndex = ConvertToIndex (pvnCorner, & vnUnitSize);
 		psCelticData->psRenderData->asColour2D[nIndex].aCorner[nCornerIndex] = * psColour;
 	} while (asCompleted[nIndex].aCorner[nCornerIndex] != TRUE);
+
+	/* The loop may have run into one found earlier rather than back round to its start */
+	EndKnotLoop ((!boBroken && (nIndex == nStartIndex) && (nCornerIndex == nStartCornerIndex)), psCelticData);
 }
 
 /* Define a colour for each of the pieces of the string */
@@ -272,18 +306,22 @@ static int ColourTiles (CelticPersist * psCelticData) {
 	VecInt3 vnLoopPos;
 	VecInt3 vnLoopCorner;
 	int nLoops;
+	int nDraws;
 	TILE eCorner;
 	ColFloats sColour;
 
 	srand (psCelticData->psRenderData->uColourSeed);
 
-	if (psCelticData->psRenderData->asColour2D) {
-		free (psCelticData->psRenderData->asColour2D);
-	}
 	nTotal = (psCelticData->vnSize.nY * psCelticData->vnSize.nX);
-	psCelticData->psRenderData->asColour2D = (Cube2Colour *)malloc ((nTotal * sizeof (Cube2Colour)));
-
+	if (psCelticData->psRenderData->nColourTiles != nTotal) {
+		if (psCelticData->psRenderData->asColour2D) {
+			free (psCelticData->psRenderData->asColour2D);
+		}
+		psCelticData->psRenderData->asColour2D = (Cube2Colour *)malloc ((nTotal * sizeof (Cube2Colour)));
+		psCelticData->psRenderData->nColourTiles = nTotal;
+	}
 	asCompleted = (Cube2Complete *)malloc (nTotal * sizeof (Cube2Complete));
+	ResetKnotLoops (psCelticData);
 
 	for (nCount = 0; nCount < nTotal; nCount++) {
 		for (nCorner = 0; nCorner < 4; nCorner++) {
@@ -295,6 +333,7 @@ static int ColourTiles (CelticPersist * psCelticData) {
 	}
 
 	nLoops = 0;
+	nDraws = 0;
 	vnPos.nZ = 0;
 	for (vnPos.nX = 0; vnPos.nX < psCelticData->vnSize.nX; vnPos.nX++) {
 		for (vnPos.nY = 0; vnPos.nY < psCelticData->vnSize.nY; vnPos.nY++) {
@@ -306,18 +345,40 @@ static int ColourTiles (CelticPersist * psCelticData) {
 					eCorner = GetCorner (vnLoopPos.nX, vnLoopPos.nY, (CORNER)nCorner, psCelticData);
 					SelectColour (& sColour, psCelticData->psRenderData);
 					if (eCorner != TILE_INVALID) {
-						ColourLoop (& vnLoopPos, & vnLoopCorner, asCompleted, & sColour, psCelticData);
+						ColourLoop (& vnLoopPos, & vnLoopCorner, asCompleted, & sColour, nLoops, psCelticData);
+						SetLoopDraw (nLoops, nDraws, psCelticData);
 						nLoops++;
 					}
+					nDraws++;
 				}
 			}
 		}
 	}
 
+	psCelticData->nColourDraws = nDraws;
+
 	free (asCompleted);
 	return nLoops;
 }
 
+/* Draw the colour of each loop again, in the same way as when the tiles were coloured */
+static void ColourPalette2D (float * afPalette, CelticPersist * psCelticData) {
+	ColFloats sColour;
+	int nDraw;
+	int nLoop;
+
+	srand (psCelticData->psRenderData->uColourSeed);
+
+	nLoop = 0;
+	for (nDraw = 0; (nDraw < psCelticData->nColourDraws) && (nLoop < psCelticData->nLoops); nDraw++) {
+		SelectColour (& sColour, psCelticData->psRenderData);
+		if (psCelticData->anLoopDraw[nLoop] == nDraw) {
+			memcpy (afPalette + (nLoop * BEZ_COL_COMPONENTS), & sColour, sizeof (float) * BEZ_COL_COMPONENTS);
+			nLoop++;
+		}
+	}
+}
+
 static void SelectColour (ColFloats * psColour, RenderPersist * psRenderData) {
 	if (psColour) {
 		if (psRenderData->uColourSeed != 0) {
@@ -522,19 +583,9 @@ static void SymmetrifyTiles (CelticPersist * psCelticData) {
 
 /* Render the knots to the canvas */
 void RenderKnots2D (CelticPersist * psCelticData) {
-	int nXPos;
-	int nYPos;
-	int nCorner;
-	TILE eTileCentre;
-	TILE eTileEdge[CORNER_NUM];
-	VecInt3 vnPos;
-	Cube2Colour sColours;
-	int nIndex;
-
 	/* Sanity check */
-	g_assert ((psCelticData->psRenderData->nBezierNum == (psCelticData->vnSize.nX * psCelticData->vnSize.nY * BEZIERS_PER_TILE)));
-	g_assert (psCelticData->psRenderData->psBezierStart);
-	psCelticData->psRenderData->psBezierCurrent = psCelticData->psRenderData->psBezierStart;
+	g_assert ((psCelticData->psRenderData->nBezierNum <= (psCelticData->nLoopLinks * BEZIERS_PER_LINE)));
+	g_assert ((psCelticData->psRenderData->psBezierStart) || (psCelticData->psRenderData->nBezierNum == 0));
 
 	// Reset the length for volume calculation
 	psCelticData->psRenderData->fLength = 0.0f;
@@ -546,19 +597,38 @@ void RenderKnots2D (CelticPersist * psCelticData) {
 	StoreBeziers (TRUE, psCelticData->psRenderData->psBezData);
 
 	/* Draw the knots */
-	for (nXPos = 0; nXPos < psCelticData->vnSize.nX; nXPos++) {
-		for (nYPos = 0; nYPos < psCelticData->vnSize.nY; nYPos++) {
-			SetVecInt3 (vnPos, nXPos, nYPos, 0);
-			for (nCorner = 0; nCorner < (int)CORNER_NUM; nCorner++) {
-				eTileEdge[nCorner] = GetCorner (nXPos, nYPos, (CORNER)nCorner, psCelticData);
-			}
-			nIndex = ConvertToIndex (& vnPos, & psCelticData->vnSize);
-			sColours = psCelticData->psRenderData->asColour2D[nIndex];
+	SetKnotBounds (psCelticData);
+	RenderTiles ((psCelticData->vnSize.nX * psCelticData->vnSize.nY), LINES_PER_TILE, RenderTile2D, psCelticData);
+	RenderLoops (LINES_PER_TILE, psCelticData);
+}
 
-			eTileCentre = GetCentre (nXPos, nYPos, psCelticData);
-			TileKnot ((nXPos * psCelticData->vTileSize.fX), (nYPos * psCelticData->vTileSize.fY), psCelticData->vTileSize.fX, psCelticData->vTileSize.fY, eTileEdge[(int)CORNER_TOPLEFT], eTileEdge[(int)CORNER_TOPRIGHT], eTileEdge[(int)CORNER_BOTTOMRIGHT], eTileEdge[(int)CORNER_BOTTOMLEFT], eTileCentre, & sColours, psCelticData->psRenderData);
-		}
+/* Render a single tile; the tiles are numbered with y varying fastest */
+static void RenderTile2D (int nTile, RenderPersist * psRenderData, CelticPersist * psCelticData) {
+	int nXPos;
+	int nYPos;
+	int nCorner;
+	TILE eTileCentre;
+	TILE eTileEdge[CORNER_NUM];
+	VecInt3 vnPos;
+	Cube2Colour sColours;
+	int nIndex;
+
+	nYPos = nTile % psCelticData->vnSize.nY;
+	nXPos = nTile / psCelticData->vnSize.nY;
+
+	SetVecInt3 (vnPos, nXPos, nYPos, 0);
+	for (nCorner = 0; nCorner < (int)CORNER_NUM; nCorner++) {
+		eTileEdge[nCorner] = GetCorner (nXPos, nYPos, (CORNER)nCorner, psCelticData);
 	}
+	nIndex = ConvertToIndex (& vnPos, & psCelticData->vnSize);
+	sColours = psRenderData->asColour2D[nIndex];
+	psRenderData->psLineCurrent = psRenderData->asLine + (nIndex * LINES_PER_TILE);
+
+	eTileCentre = GetCentre (nXPos, nYPos, psCelticData);
+	TileKnot ((nXPos * psCelticData->vTileSize.fX), (nYPos * psCelticData->vTileSize.fY), psCelticData->vTileSize.fX, psCelticData->vTileSize.fY, eTileEdge[(int)CORNER_TOPLEFT], eTileEdge[(int)CORNER_TOPRIGHT], eTileEdge[(int)CORNER_BOTTOMRIGHT], eTileEdge[(int)CORNER_BOTTOMLEFT], eTileCentre, & sColours, psRenderData);
+
+	/* Check the tile set exactly its own lines */
+	g_assert (psRenderData->psLineCurrent == (psRenderData->asLine + ((nIndex + 1) * LINES_PER_TILE)));
 }
 
 /* Render a bezier curve */
@@ -642,13 +712,11 @@ static void ImageBezierSplit (float fX1, float fY1, float fXDir1, float fYDir1,
 	vMidDirBack.fZ += fHMid;
 	vMidDirForward.fZ += fHMid;
 
-	g_assert (psRenderData->psBezierCurrent);
-	SetBezierControlPoints (psRenderData->fThickness, vStart, vStartDir, vMid, vMidDirBack, (float const *)psStartColour, (float const *)(& sMidColour), psRenderData->psBezierCurrent, psRenderData->psBezData);
-	psRenderData->psBezierCurrent = GetBezierNext (psRenderData->psBezierCurrent);
+	g_assert (psRenderData->psLineCurrent);
+	SetTileCurveHalf (& psRenderData->psLineCurrent->asHalf[0], & vStart, & vStartDir, & vMid, & vMidDirBack, psStartColour, psMidColour);
 
-	g_assert (psRenderData->psBezierCurrent);
-	SetBezierControlPoints (psRenderData->fThickness, vMid, vMidDirForward, vEnd, vEndDir, (float const *)psMidColour, (float const *)psEndColour, psRenderData->psBezierCurrent, psRenderData->psBezData);
-	psRenderData->psBezierCurrent = GetBezierNext (psRenderData->psBezierCurrent);
+	/* The second half carries straight on from the first */
+	SetTileCurveHalf (& psRenderData->psLineCurrent->asHalf[1], & vMid, & vMidDirForward, & vEnd, & vEndDir, psMidColour, psEndColour);
 }
 
 /* Render a single bezier curve given the parameters of a tile */
@@ -826,11 +894,14 @@ static void TileLine (float fX, float fY, float fWidth, float fHeight, CORNER eS
 		SetVector3 (vDir[0], fXDir1, fYDir1, 0.0f);
 		SetVector3 (vPos[1], fX2, fY2, 0.0f);
 		SetVector3 (vDir[1], fXDir2, fYDir2, 0.0f);
-		psRenderData->fLength += BezierCalculateLength (vPos[0], vDir[0], vPos[1], vDir[1], psRenderData->psBezData);
-	}
-	else {
-		ImageBezierSplit (0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f, NULL, NULL, psRenderData);
+		psRenderData->fLength += BezierCalculateLength (vPos[0], vDir[0], vPos[1], vDir[1]);
 	}
+
+	/* Lines to an invalid corner aren't drawn, and are left out of the loops */
+	psRenderData->psLineCurrent->nCornerStart = (int)eStart;
+	psRenderData->psLineCurrent->nCornerEnd = (int)eEnd;
+	psRenderData->psLineCurrent->boDraw = boDraw;
+	psRenderData->psLineCurrent++;
 }
 
 /* Render a tile */
@@ -23,7 +23,7 @@
 /* Structures */
 
 /* Function prototypes */
-CelticPersist * NewCelticPersist2D (int nWidth, int nHeight, float fTileX, float fTileY, BezPersist * psBezData);
+CelticPersist * NewCelticPersist2D (int nWidth, int nHeight, float fTileX, float fTileY, TaskPersist * psTaskData, BezPersist * psBezData);
 
 #endif /* CELTIC2D_H */
 
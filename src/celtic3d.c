@@ -21,7 +21,7 @@
 #define MAX_SIZE (1280)
 #define WEAVE_HEIGHT (0.3f)
 #define CONTROL_SCALE (0.4f)
-#define BEZIERS_PER_TILE (8)
+#define LINES_PER_TILE (4)
 #define SelectRandom(ARRAY, NUM) (ARRAY)[(rand() % (NUM))];
 #define COST_PER_UNIT_CUBED (10.0f / (10.0f * 10.0f * 10.0f))
 
@@ -51,6 +51,7 @@ static Vector3 GetWeaveCorner (VecInt3 const * pvnCorner, RenderPersist * psRend
 static Vector3 GetWeaveCentre (VecInt3 const * pvnCorner, RenderPersist * psRenderData);
 static void TileLine (Vector3 const * pvPos, Vector3 const * pvSize, VecInt3 const * pvnCornerStart, VecInt3 const * pvnCornerEnd, TILE eStartDir, TILE eEndDir, ColFloats const * psStartColour, ColFloats const * psEndColour, RenderPersist * psRenderData);
 static void TileKnot (Vector3 const * pvPos, Vector3 const * pvSize, TILE aeEdge[2][2][2], TILE eCentre, Cube3Colour const * psColours, RenderPersist * psRenderData);
+static void RenderTile3D (int nTile, RenderPersist * psRenderData, CelticPersist * psCelticData);
 static TILE GetCorner (VecInt3 const * pvnPos, VecInt3 const * pvnCorner, CelticPersist * psCelticData);
 static void SetCorner (VecInt3 const * pvnPos, VecInt3 const * pvnCorner, TILE eValue, CelticPersist * psCelticData);
 static TILE GetCentre (VecInt3 const * pvnPos, CelticPersist * psCelticData);
@@ -62,15 +63,16 @@ static void FindRotatedTiles (VecInt3 const * pvnPos, VecInt3 const * pvnSize, V
 static int ColourTiles (CelticPersist * psCelticData);
 static void FollowKnotInside (VecInt3 * pvnPos, VecInt3 * pvnCorner, CelticPersist * psCelticData);
 static void FollowKnotToNext (VecInt3 * pvnPos, VecInt3 * pvnCorner, CelticPersist * psCelticData);
-static void ColourLoop (VecInt3 * pvnPos, VecInt3 * pvnCorner, Cube3Complete * asCompleted, ColFloats const * psColour, CelticPersist * psCelticData);
+static void ColourLoop (VecInt3 * pvnPos, VecInt3 * pvnCorner, Cube3Complete * asCompleted, ColFloats const * psColour, int nColour, CelticPersist * psCelticData);
 static void SelectColour (ColFloats * psColour, RenderPersist * psRenderData);
+static void ColourPalette3D (float * afPalette, CelticPersist * psCelticData);
 static void SelectColourSmooth (ColFloats * psColour, ColFloats * psColStart, ColFloats * psColEnd, float fPos, RenderPersist * psRenderData);
 static void CelticLoadProperty (SETTINGTYPE const eType, char const * szName, void const * const psValue, void * psData, SettingsPersist * psSettingsData);
 static void CelticLoadSectionStart (char const * szName, void * psData, SettingsPersist * psSettingsData);
 static void CelticLoadSectionEnd (char const * szName, void * psData, SettingsPersist * psSettingsData);
 
 /* Function defininitions */
-CelticPersist * NewCelticPersist3D (int nWidth, int nHeight, int nDepth, float fTileX, float fTileY, float fTileZ, BezPersist * psBezData) {
+CelticPersist * NewCelticPersist3D (int nWidth, int nHeight, int nDepth, float fTileX, float fTileY, float fTileZ, TaskPersist * psTaskData, BezPersist * psBezData) {
 	CelticPersist * psCelticData;
 
 	psCelticData = (CelticPersist *)calloc (1, sizeof (CelticPersist));
@@ -88,9 +90,15 @@ CelticPersist * NewCelticPersist3D (int nWidth, int nHeight, int nDepth, float f
 	psCelticData->boDebug = FALSE;
 	psCelticData->psRenderData = NewRenderPersist (-(((float)nWidth) * fTileX / 2.0f), -(((float)nHeight) * fTileY / 2.0f), -(((float)nDepth) * fTileZ / 2.0f));
 	psCelticData->psRenderData->psBezData = psBezData;
+	psCelticData->psTaskData = psTaskData;
 	
 	psCelticData->aeCorner = NULL;
 	psCelticData->aeCentre = NULL;
+	psCelticData->asLoopLink = NULL;
+	psCelticData->asKnotLoop = NULL;
+	psCelticData->anLoopDraw = NULL;
+	psCelticData->anLoopCopies = NULL;
+	psCelticData->anCopyColour = NULL;
 
 	/* Set up the virtual functions */
 	psCelticData->DeleteCelticPersist = & DeleteCelticPersist3D;
@@ -99,6 +107,7 @@ CelticPersist * NewCelticPersist3D (int nWidth, int nHeight, int nDepth, float f
 	psCelticData->RenderKnots = & RenderKnots3D;
 
 	psCelticData->GetVolume = & GetVolume3D;
+	psCelticData->ColourPalette = & ColourPalette3D;
 
 	psCelticData->SaveSettingsCeltic = & SaveSettingsCeltic3D;
 	psCelticData->LoadSettingsStartCeltic =  LoadSettingsStartCeltic3D;
@@ -122,6 +131,7 @@ void DeleteCelticPersist3D (CelticPersist * psCelticData) {
 			DeleteRenderPersist (psCelticData->psRenderData);
 			psCelticData->psRenderData = NULL;
 		}
+		DeleteKnotLoops (psCelticData);
 
 		free (psCelticData);
 		psCelticData = NULL;
@@ -130,7 +140,6 @@ void DeleteCelticPersist3D (CelticPersist * psCelticData) {
 
 /* Main function */
 void GenerateKnot3D (CelticPersist * psCelticData) {
-	int nBezier;
 	int nBeziers;
 
 	/* Re-seed the random number generator */
@@ -139,14 +148,25 @@ void GenerateKnot3D (CelticPersist * psCelticData) {
 	// Random number cycle correction
 	rand ();
 
-	if (psCelticData->aeCorner) {
-		free (psCelticData->aeCorner);
+	/* The tiles are only reallocated if the size of the knot has changed */
+	if ((psCelticData->aeCorner == NULL) || (psCelticData->aeCentre == NULL)
+		|| (psCelticData->vnSizeAllocated.nX != psCelticData->vnSize.nX)
+		|| (psCelticData->vnSizeAllocated.nY != psCelticData->vnSize.nY)
+		|| (psCelticData->vnSizeAllocated.nZ != psCelticData->vnSize.nZ)) {
+		if (psCelticData->aeCorner) {
+			free (psCelticData->aeCorner);
+		}
+		if (psCelticData->aeCentre) {
+			free (psCelticData->aeCentre);
+		}
+		psCelticData->aeCorner = (TILE *)calloc (((psCelticData->vnSize.nY + 1) * (psCelticData->vnSize.nX + 1) * (psCelticData->vnSize.nZ + 1)), sizeof (TILE));
+		psCelticData->aeCentre = (TILE *)calloc (((psCelticData->vnSize.nY) * (psCelticData->vnSize.nX) * (psCelticData->vnSize.nZ)), sizeof (TILE));
+		psCelticData->vnSizeAllocated = psCelticData->vnSize;
 	}
-	if (psCelticData->aeCentre) {
-		free (psCelticData->aeCentre);
+	else {
+		memset (psCelticData->aeCorner, 0, ((psCelticData->vnSize.nY + 1) * (psCelticData->vnSize.nX + 1) * (psCelticData->vnSize.nZ + 1)) * sizeof (TILE));
+		memset (psCelticData->aeCentre, 0, ((psCelticData->vnSize.nY) * (psCelticData->vnSize.nX) * (psCelticData->vnSize.nZ)) * sizeof (TILE));
 	}
-	psCelticData->aeCorner = (TILE *)calloc (((psCelticData->vnSize.nY + 1) * (psCelticData->vnSize.nX + 1) * (psCelticData->vnSize.nZ + 1)), sizeof (TILE));
-	psCelticData->aeCentre = (TILE *)calloc (((psCelticData->vnSize.nY) * (psCelticData->vnSize.nX) * (psCelticData->vnSize.nZ)), sizeof (TILE));
 
 	/* Create the random knot tiles */
 	PopulateTiles (psCelticData->eOrientation, psCelticData);
@@ -157,23 +177,10 @@ void GenerateKnot3D (CelticPersist * psCelticData) {
 
 	psCelticData->nLoops = ColourTiles (psCelticData);
 
-	/* Remove any beziers if there are any */
-	if (psCelticData->psRenderData->nBezierNum > 0) {
-		DeleteBeziers (psCelticData->psRenderData->psBezierStart, psCelticData->psRenderData->nBezierNum, psCelticData->psRenderData->psBezData);
-		psCelticData->psRenderData->psBezierStart = NULL;
-		psCelticData->psRenderData->nBezierNum = 0;
-	}
-
-	/* Generate bezier tubes */
-	nBeziers = (psCelticData->vnSize.nX * psCelticData->vnSize.nY * psCelticData->vnSize.nZ * BEZIERS_PER_TILE);
+	/* Generate bezier tubes, in the order the loops follow them, replacing any there were before */
+	nBeziers = (psCelticData->nLoopLinks * BEZIERS_PER_LINE);
 	psCelticData->psRenderData->nBezierNum = nBeziers;
-	if (nBeziers > 0) {
-		psCelticData->psRenderData->psBezierStart = NewBezier (psCelticData->psRenderData->psBezData);
-
-		for (nBezier = 0; nBezier < (nBeziers - 1); nBezier++) {
-			NewBezier (psCelticData->psRenderData->psBezData);
-		}
-	}
+	psCelticData->psRenderData->psBezierStart = ResetBeziers (nBeziers, psCelticData->psRenderData->psBezData);
 }
 
 /* Find the next piece of knot after the given piece, based on the direction of the string */
@@ -244,18 +251,32 @@ static void FollowKnotToNext (VecInt3 * pvnPos, VecInt3 * pvnCorner, CelticPersi
 	}
 }
 
-static void ColourLoop (VecInt3 * pvnPos, VecInt3 * pvnCorner, Cube3Complete * asCompleted, ColFloats const * psColour, CelticPersist * psCelticData) {
+/* Colour a loop, recording the lines it follows in order */
+static void ColourLoop (VecInt3 * pvnPos, VecInt3 * pvnCorner, Cube3Complete * asCompleted, ColFloats const * psColour, int nColour, CelticPersist * psCelticData) {
 	int nIndex;
 	int nCornerIndex;
+	int nStartIndex;
+	int nStartCornerIndex;
+	int nLinkIndex;
+	int nLinkCornerIndex;
+	TILE eLinkStart;
+	bool boBroken;
 	VecInt3 vnUnitSize;
 
 	SetVecInt3 (vnUnitSize, 2, 2, 2);
 
 	nIndex = ConvertToIndex (pvnPos, & psCelticData->vnSize);
 	nCornerIndex = ConvertToIndex (pvnCorner, & vnUnitSize);
+	nStartIndex = nIndex;
+	nStartCornerIndex = nCornerIndex;
+	boBroken = FALSE;
 
+	StartKnotLoop (nColour, psCelticData);
 	do {
 		asCompleted[nIndex].aCorner[nCornerIndex] = TRUE;
+		nLinkIndex = nIndex;
+		nLinkCornerIndex = nCornerIndex;
+		eLinkStart = GetCorner (pvnPos, pvnCorner, psCelticData);
 		FollowKnotInside (pvnPos, pvnCorner, psCelticData);
 
 		nIndex = ConvertToIndex (pvnPos, & psCelticData->vnSize);
@@ -263,12 +284,25 @@ static void ColourLoop (VecInt3 * pvnPos, VecInt3 * pvnCorner, Cube3Complete * a
 		psCelticData->psRenderData->asColour3D[nIndex].aCorner[nCornerIndex] = * psColour;
 		asCompleted[nIndex].aCorner[nCornerIndex] = TRUE;
 
+		/* Lines to an invalid corner aren't drawn, so they break the loop */
+		if ((eLinkStart != TILE_INVALID) && (GetCorner (pvnPos, pvnCorner, psCelticData) != TILE_INVALID)) {
+			AddLoopLink (nLinkIndex, nLinkCornerIndex, psCelticData);
+		}
+		else {
+			EndKnotLoop (FALSE, psCelticData);
+			StartKnotLoop (nColour, psCelticData);
+			boBroken = TRUE;
+		}
+
 		FollowKnotToNext (pvnPos, pvnCorner, psCelticData);
 
 		nIndex = ConvertToIndex (pvnPos, & psCelticData->vnSize);
 		nCornerIndex = ConvertToIndex (pvnCorner, & vnUnitSize);
 		psCelticData->psRenderData->asColour3D[nIndex].aCorner[nCornerIndex] = * psColour;
 	} while (asCompleted[nIndex].aCorner[nCornerIndex] != TRUE);
+
+	/* The loop may have run into one found earlier rather than back round to its start */
+	EndKnotLoop ((!boBroken && (nIndex == nStartIndex) && (nCornerIndex == nStartCornerIndex)), psCelticData);
 }
 
 /* Define a colour for each of the pieces of the string */
@@ -283,6 +317,7 @@ static int ColourTiles (CelticPersist * psCelticData) {
 	VecInt3 vnLoopCorner;
 	int nLoop;
 	int nLoops;
+	int nDraws;
 	TILE eCorner;
 	ColFloats sColour;
 	ColFloats sColStart;
@@ -291,12 +326,14 @@ static int ColourTiles (CelticPersist * psCelticData) {
 
 	srand (psCelticData->psRenderData->uColourSeed);
 
-	if (psCelticData->psRenderData->asColour3D) {
-		free (psCelticData->psRenderData->asColour3D);
-	}
 	nTotal = (psCelticData->vnSize.nY * psCelticData->vnSize.nX * psCelticData->vnSize.nZ);
-	psCelticData->psRenderData->asColour3D = (Cube3Colour *)malloc ((nTotal * sizeof (Cube3Colour)));
-
+	if (psCelticData->psRenderData->nColourTiles != nTotal) {
+		if (psCelticData->psRenderData->asColour3D) {
+			free (psCelticData->psRenderData->asColour3D);
+		}
+		psCelticData->psRenderData->asColour3D = (Cube3Colour *)malloc ((nTotal * sizeof (Cube3Colour)));
+		psCelticData->psRenderData->nColourTiles = nTotal;
+	}
 	asCompleted = (Cube3Complete *)malloc (nTotal * sizeof (Cube3Complete));
 
 	for (nCount = 0; nCount < nTotal; nCount++) {
@@ -310,6 +347,7 @@ static int ColourTiles (CelticPersist * psCelticData) {
 
 	// Count the number of loops
 	nLoops = 0;
+	nDraws = 0;
 	for (vnPos.nX = 0; vnPos.nX < psCelticData->vnSize.nX; vnPos.nX++) {
 		for (vnPos.nY = 0; vnPos.nY < psCelticData->vnSize.nY; vnPos.nY++) {
 			for (vnPos.nZ = 0; vnPos.nZ < psCelticData->vnSize.nZ; vnPos.nZ++) {
@@ -321,16 +359,18 @@ static int ColourTiles (CelticPersist * psCelticData) {
 						eCorner = GetCorner (& vnLoopPos, & vnLoopCorner, psCelticData);
 						SelectColour (& sColour, psCelticData->psRenderData);
 						if (eCorner != TILE_INVALID) {
-							ColourLoop (& vnLoopPos, & vnLoopCorner, asCompleted, & sColour, psCelticData);
+							ColourLoop (& vnLoopPos, & vnLoopCorner, asCompleted, & sColour, nLoops, psCelticData);
 							nLoops++;
 						}
+						nDraws++;
 					}
 				}
 			}
 		}
 	}
 
-	// Reset
+	// Reset, so that only the loops found by the colouring pass are kept
+	ResetKnotLoops (psCelticData);
 	for (nCount = 0; nCount < nTotal; nCount++) {
 		for (nCorner = 0; nCorner < 8; nCorner++) {
 			asCompleted[nCount].aCorner[nCorner] = FALSE;
@@ -338,6 +378,7 @@ static int ColourTiles (CelticPersist * psCelticData) {
 	}
 
 	// Select a random start and end colour for the loops
+	psCelticData->nColourDraws = nDraws;
 	SelectColour (& sColStart, psCelticData->psRenderData);
 	SelectColour (& sColEnd, psCelticData->psRenderData);
 
@@ -358,7 +399,7 @@ static int ColourTiles (CelticPersist * psCelticData) {
 						fPos = (float)nLoop/(float)nLoops;
 						SelectColourSmooth (& sColour, & sColStart, & sColEnd, fPos, psCelticData->psRenderData);
 						if (eCorner != TILE_INVALID) {
-							ColourLoop (& vnLoopPos, & vnLoopCorner, asCompleted, & sColour, psCelticData);
+							ColourLoop (& vnLoopPos, & vnLoopCorner, asCompleted, & sColour, nLoop, psCelticData);
 							nLoop++;
 						}
 					}
@@ -386,6 +427,30 @@ static void SelectColour (ColFloats * psColour, RenderPersist * psRenderData) {
 	}
 }
 
+/* Draw the colour of each loop again, in the same way as when the tiles were coloured */
+static void ColourPalette3D (float * afPalette, CelticPersist * psCelticData) {
+	ColFloats sColour;
+	ColFloats sColStart;
+	ColFloats sColEnd;
+	int nDraw;
+	int nLoop;
+
+	srand (psCelticData->psRenderData->uColourSeed);
+
+	// Skip the colours drawn while counting the loops
+	for (nDraw = 0; nDraw < psCelticData->nColourDraws; nDraw++) {
+		SelectColour (& sColour, psCelticData->psRenderData);
+	}
+
+	SelectColour (& sColStart, psCelticData->psRenderData);
+	SelectColour (& sColEnd, psCelticData->psRenderData);
+
+	for (nLoop = 0; nLoop < psCelticData->nLoops; nLoop++) {
+		SelectColourSmooth (& sColour, & sColStart, & sColEnd, (float)nLoop / (float)psCelticData->nLoops, psCelticData->psRenderData);
+		memcpy (afPalette + (nLoop * BEZ_COL_COMPONENTS), & sColour, sizeof (float) * BEZ_COL_COMPONENTS);
+	}
+}
+
 static void SelectColourSmooth (ColFloats * psColour, ColFloats * psColStart, ColFloats * psColEnd, float fPos, RenderPersist * psRenderData) {
 	if (psRenderData->uColourSeed != 0) {
 		if (psColour && psColStart && psColEnd) {
@@ -858,6 +923,27 @@ static void SymmetrifyTiles (CelticPersist * psCelticData) {
 
 /* Render the knots to the canvas */
 void RenderKnots3D (CelticPersist * psCelticData) {
+	/* Sanity check */
+	g_assert ((psCelticData->psRenderData->nBezierNum <= (psCelticData->nLoopLinks * BEZIERS_PER_LINE)));
+	g_assert ((psCelticData->psRenderData->psBezierStart) || (psCelticData->psRenderData->nBezierNum == 0));
+	
+	// Reset the length for volume calculation
+	psCelticData->psRenderData->fLength = 0.0f;
+
+	// Clear the currently stored beziers if there are any
+	StoreBeziers (FALSE, psCelticData->psRenderData->psBezData);
+
+	// Set the next set of beziers to be stored
+	StoreBeziers (TRUE, psCelticData->psRenderData->psBezData);
+
+	/* Draw the knots */
+	SetKnotBounds (psCelticData);
+	RenderTiles ((psCelticData->vnSize.nX * psCelticData->vnSize.nY * psCelticData->vnSize.nZ), LINES_PER_TILE, RenderTile3D, psCelticData);
+	RenderLoops (LINES_PER_TILE, psCelticData);
+}
+
+/* Render a single tile; the tiles are numbered with y varying fastest, then x, then z */
+static void RenderTile3D (int nTile, RenderPersist * psRenderData, CelticPersist * psCelticData) {
 	int nXPos;
 	int nYPos;
 	int nZPos;
@@ -870,38 +956,25 @@ void RenderKnots3D (CelticPersist * psCelticData) {
 	Cube3Colour sColours;
 	int nIndex;
 
-	/* Sanity check */
-	g_assert ((psCelticData->psRenderData->nBezierNum == (psCelticData->vnSize.nX * psCelticData->vnSize.nY * psCelticData->vnSize.nZ * BEZIERS_PER_TILE)));
-	g_assert (psCelticData->psRenderData->psBezierStart);
-	psCelticData->psRenderData->psBezierCurrent = psCelticData->psRenderData->psBezierStart;
-	
-	// Reset the length for volume calculation
-	psCelticData->psRenderData->fLength = 0.0f;
+	nYPos = nTile % psCelticData->vnSize.nY;
+	nXPos = (nTile / psCelticData->vnSize.nY) % psCelticData->vnSize.nX;
+	nZPos = nTile / (psCelticData->vnSize.nX * psCelticData->vnSize.nY);
 
-	// Clear the currently stored beziers if there are any
-	StoreBeziers (FALSE, psCelticData->psRenderData->psBezData);
-
-	// Set the next set of beziers to be stored
-	StoreBeziers (TRUE, psCelticData->psRenderData->psBezData);
+	SetVecInt3 (vnPos, nXPos, nYPos, nZPos);
+	for (nCorner = 0; nCorner < 8; nCorner++) {
+		SetVecInt3 (vnCorner, (nCorner % 2), ((nCorner / 2) % 2), (nCorner / 4));
+		aeTileEdge[(nCorner % 2)][((nCorner / 2) % 2)][(nCorner / 4)] = GetCorner (& vnPos, & vnCorner, psCelticData);
+	}
+	nIndex = ConvertToIndex (& vnPos, & psCelticData->vnSize);
+	sColours = psRenderData->asColour3D[nIndex];
+	psRenderData->psLineCurrent = psRenderData->asLine + (nIndex * LINES_PER_TILE);
 
-	/* Draw the knots */
-	for (nZPos = 0; nZPos < psCelticData->vnSize.nZ; nZPos++) {
-		for (nXPos = 0; nXPos < psCelticData->vnSize.nX; nXPos++) {
-			for (nYPos = 0; nYPos < psCelticData->vnSize.nY; nYPos++) {
-				SetVecInt3 (vnPos, nXPos, nYPos, nZPos);
-				for (nCorner = 0; nCorner < 8; nCorner++) {
-					SetVecInt3 (vnCorner, (nCorner % 2), ((nCorner / 2) % 2), (nCorner / 4));
-					aeTileEdge[(nCorner % 2)][((nCorner / 2) % 2)][(nCorner / 4)] = GetCorner (& vnPos, & vnCorner, psCelticData);
-				}
-				nIndex = ConvertToIndex (& vnPos, & psCelticData->vnSize);
-				sColours = psCelticData->psRenderData->asColour3D[nIndex];
+	eTileCentre = GetCentre (& vnPos, psCelticData);
+	SetVector3 (vPos, (nXPos * psCelticData->vTileSize.fX), (nYPos * psCelticData->vTileSize.fY), (nZPos * psCelticData->vTileSize.fZ));
+	TileKnot (& vPos, & psCelticData->vTileSize, aeTileEdge, eTileCentre, & sColours, psRenderData);
 
-				eTileCentre = GetCentre (& vnPos, psCelticData);
-				SetVector3 (vPos, (nXPos * psCelticData->vTileSize.fX), (nYPos * psCelticData->vTileSize.fY), (nZPos * psCelticData->vTileSize.fZ));
-				TileKnot (& vPos, & psCelticData->vTileSize, aeTileEdge, eTileCentre, & sColours, psCelticData->psRenderData);
-			}
-		}
-	}
+	/* Check the tile set exactly its own lines */
+	g_assert (psRenderData->psLineCurrent == (psRenderData->asLine + ((nIndex + 1) * LINES_PER_TILE)));
 }
 
 bool ExportModel3D (char const * szFilename, bool boBinary, CelticPersist * psCelticData) {
@@ -980,13 +1053,11 @@ static void ImageBezierSplit (Vector3 const * pvStart, Vector3 const * pvStartDi
 	vMidDirBack = AddVectors (& vMidDirBack, & vShift);
 	vMidDirForward = AddVectors (& vMidDirForward, & vShift);
 
-	g_assert (psRenderData->psBezierCurrent);
-	SetBezierControlPoints (psRenderData->fThickness, vStart, vStartDir, vMid, vMidDirBack, (float const *)psStartColour, (float const *)(& sMidColour), psRenderData->psBezierCurrent, psRenderData->psBezData);
-	psRenderData->psBezierCurrent = GetBezierNext (psRenderData->psBezierCurrent);
+	g_assert (psRenderData->psLineCurrent);
+	SetTileCurveHalf (& psRenderData->psLineCurrent->asHalf[0], & vStart, & vStartDir, & vMid, & vMidDirBack, psStartColour, psMidColour);
 
-	g_assert (psRenderData->psBezierCurrent);
-	SetBezierControlPoints (psRenderData->fThickness, vMid, vMidDirForward, vEnd, vEndDir, (float const *)psMidColour, (float const *)psEndColour, psRenderData->psBezierCurrent, psRenderData->psBezData);
-	psRenderData->psBezierCurrent = GetBezierNext (psRenderData->psBezierCurrent);
+	/* The second half carries straight on from the first */
+	SetTileCurveHalf (& psRenderData->psLineCurrent->asHalf[1], & vMid, & vMidDirForward, & vEnd, & vEndDir, psMidColour, psEndColour);
 }
 
 static Vector3 GetWeaveCorner (VecInt3 const * pvnCorner, RenderPersist * psRenderData) {
@@ -1030,6 +1101,7 @@ static void TileLine (Vector3 const * pvPos, Vector3 const * pvSize, VecInt3 con
 	Vector3 vOverride;
 	Vector3 * pvOverride;
 	int nCount;
+	VecInt3 vnCornerSize;
 	bool boDraw = TRUE;
 
 	for (nCount = 0; nCount < 2; nCount++) {
@@ -1166,16 +1238,15 @@ static void TileLine (Vector3 const * pvPos, Vector3 const * pvSize, VecInt3 con
 	if (boDraw) {
 		ImageBezierSplit (& vPos[0], & vDir[0], & vPos[1], & vDir[1], 0.5f, & vWeaveMid, pvOverride, psStartColour, psEndColour, psRenderData);
 
-	psRenderData->fLength += BezierCalculateLength (vPos[0], vDir[0], vPos[1], vDir[1], psRenderData->psBezData);
+	psRenderData->fLength += BezierCalculateLength (vPos[0], vDir[0], vPos[1], vDir[1]);
 	}
-	else {
-		SetVector3 (vPos[0], 0.0f, 0.0f, 0.0f);
-		SetVector3 (vDir[0], 0.0f, 0.0f, 0.0f);
-		SetVector3 (vPos[1], 0.0f, 0.0f, 0.0f);
-		SetVector3 (vDir[1], 0.0f, 0.0f, 0.0f);
 
-		ImageBezierSplit (& vPos[0], & vDir[0], & vPos[1], & vDir[1], 0.5f, & vWeaveMid, NULL, NULL, NULL, psRenderData);
-	}
+	/* Lines to an invalid corner aren't drawn, and are left out of the loops */
+	SetVecInt3 (vnCornerSize, 2, 2, 2);
+	psRenderData->psLineCurrent->nCornerStart = ConvertToIndex (pvnCornerStart, & vnCornerSize);
+	psRenderData->psLineCurrent->nCornerEnd = ConvertToIndex (pvnCornerEnd, & vnCornerSize);
+	psRenderData->psLineCurrent->boDraw = boDraw;
+	psRenderData->psLineCurrent++;
 }
 
 /* Render a tile */
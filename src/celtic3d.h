@@ -23,7 +23,7 @@
 /* Structures */
 
 /* Function prototypes */
-CelticPersist * NewCelticPersist3D (int nWidth, int nHeight, int nDepth, float fTileX, float fTileY, float fTileZ, BezPersist * psBezData);
+CelticPersist * NewCelticPersist3D (int nWidth, int nHeight, int nDepth, float fTileX, float fTileY, float fTileZ, TaskPersist * psTaskData, BezPersist * psBezData);
 
 #endif /* CELTIC3D_H */
 
@@ -21,6 +21,7 @@
 #define COLOUR_PLAIN_RED (0.7f)
 #define COLOUR_PLAIN_GREEN (0.7f)
 #define COLOUR_PLAIN_BLUE (0.7f)
+#define BEZIERS_PER_LINE (2)
 
 #define CUBE(NAME, DIMENSION, TYPE) typedef struct _Cube##DIMENSION##NAME { \
 	TYPE aCorner[(2 << (DIMENSION))]; \
@@ -42,6 +43,31 @@ CUBE (Complete, 3, bool)
 CUBE (Colour, 2, ColFloats)
 CUBE (Complete, 2, bool)
 
+/* A line across a tile from one corner to another, as two beziers joined in the middle */
+typedef struct _TileCurve {
+	int nCornerStart;
+	int nCornerEnd;
+	bool boDraw;
+	BezChainLink asHalf[BEZIERS_PER_LINE];
+} TileCurve;
+
+/* One step along a loop, following the line across a tile that starts or ends at the given corner */
+typedef struct _LoopLink {
+	int nTile;
+	int nCorner;
+} LoopLink;
+
+/* A loop of the knot as a run of links; a loop that's broken, for example by an invalid corner, isn't closed */
+typedef struct _KnotLoop {
+	int nLinkStart;
+	int nLinks;
+	bool boClosed;
+	int nColour;
+} KnotLoop;
+
+/* Renders the lines of a single tile, setting psRenderData->psLineCurrent to the tile's first line in psRenderData->asLine */
+typedef void (*TileRenderer) (int nTile, RenderPersist * psRenderData, CelticPersist * psCelticData);
+
 struct _RenderPersist {
 	BezPersist * psBezData;
 	float fThickness;
@@ -50,14 +76,17 @@ struct _RenderPersist {
 	float fControlScale;
 	Vector3 vOffset;
 	Bezier * psBezierStart;
-	Bezier * psBezierCurrent;
 	int nBezierNum;
+	TileCurve * asLine;
+	TileCurve * psLineCurrent;
+	int nLines;
 	unsigned int uColourSeed;
 	union {
 		Cube2Colour * asColour2D;
 		Cube3Colour * asColour3D;
 		void * asColour;
 	};
+	int nColourTiles;
 	unsigned int uAccuracyLongitudinal;
 	unsigned int uAccuracyRadial;
 	float fLength;
@@ -69,6 +98,7 @@ struct _CelticPersist {
 	int nLoops;
 	TILE * aeCorner;
 	TILE * aeCentre;
+	VecInt3 vnSizeAllocated;
 	VecInt3 vnSize;
 	Vector3 vTileSize;
 	float fWeirdness;
@@ -76,6 +106,26 @@ struct _CelticPersist {
 	bool boSymmetrify;
 	bool boDebug;
 	RenderPersist * psRenderData;
+	LoopLink * asLoopLink;
+	int nLoopLinks;
+	int nLoopLinksMax;
+	KnotLoop * asKnotLoop;
+	int nKnotLoops;
+	int nKnotLoopsMax;
+	/* The number of colours drawn from the colour seed before each loop's own, so that they can be drawn again */
+	int * anLoopDraw;
+	int nLoopDrawsMax;
+	int nColourDraws;
+	/* Rotations of the knot on to itself, used to draw some of the loops as copies of others */
+	/* Each loop has a mask of the copies it's drawn in, or -1 if it's drawn as a copy of another loop */
+	int nCopies;
+	BezCopy asCopy[BEZ_COPIES_MAX];
+	int * anLoopCopies;
+	int nLoopCopiesMax;
+	/* For each copy in turn, the colour it draws in place of each of the colours */
+	int * anCopyColour;
+	/* The worker threads, which are shared with other knots rather than owned by this one */
+	TaskPersist * psTaskData;
 
 	/* Virtual functions */
 	void (*DeleteCelticPersist) (CelticPersist * psCelticData);
@@ -84,6 +134,7 @@ struct _CelticPersist {
 	void (*RenderKnots) (CelticPersist * psCelticData);
 
 	float (*GetVolume) (CelticPersist * psCelticData);
+	void (*ColourPalette) (float * afPalette, CelticPersist * psCelticData);
 
 	void (*SaveSettingsCeltic) (SettingsPersist * psSettingsData, CelticPersist * psCelticData);
 	void (*LoadSettingsStartCeltic) (SettingsPersist * psSettingsData, CelticPersist * psCelticData);
@@ -99,6 +150,16 @@ void DeleteRenderPersist (RenderPersist * psRenderData);
 void SaveSettingsRender (SettingsPersist * psSettingsData, RenderPersist * psRenderData);
 void LoadSettingsStartRender (SettingsPersist * psSettingsData, RenderPersist * psRenderData);
 void LoadSettingsEndRender (SettingsPersist * psSettingsData, RenderPersist * psRenderData);
+void RenderTiles (int nTiles, int nLinesPerTile, TileRenderer pfRenderTile, CelticPersist * psCelticData);
+void RenderLoops (int nLinesPerTile, CelticPersist * psCelticData);
+void SetKnotBounds (CelticPersist * psCelticData);
+void SetTileCurveHalf (BezChainLink * psHalf, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, ColFloats const * psStartColour, ColFloats const * psEndColour);
+void ResetKnotLoops (CelticPersist * psCelticData);
+void StartKnotLoop (int nColour, CelticPersist * psCelticData);
+void AddLoopLink (int nTile, int nCorner, CelticPersist * psCelticData);
+void EndKnotLoop (bool boClosed, CelticPersist * psCelticData);
+void SetLoopDraw (int nLoop, int nDraw, CelticPersist * psCelticData);
+void DeleteKnotLoops (CelticPersist * psCelticData);
 
 #endif /* CELTIC_PRIVATE_H */
 
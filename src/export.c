@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////
+// Export
+// Buffered, locale-independent output for model exports
+//
+// David Llewellyn-Jones
+// http://www.flypig.co.uk
+//
+// Summer 2011
+///////////////////////////////////////////////////////////////////
+
+
+///////////////////////////////////////////////////////////////////
+// Includes
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "export.h"
+
+///////////////////////////////////////////////////////////////////
+// Defines
+
+// Size of the blocks that exports are gathered into, so that they're written with a few large writes
+#define EXPORT_BLOCK_SIZE (1024 * 1024)
+
+// Magnitude above which a float is formatted by glib, as its whole part may not fit in a 64-bit integer
+// Every float this large is a whole number
+#define EXPORT_WHOLE_MAX (1.0e18)
+
+///////////////////////////////////////////////////////////////////
+// Structures and enumerations
+
+// Output to a file, gathered in memory and written a block at a time
+struct _ExportBuffer {
+	FILE * hFile;
+	char * acBlock;
+	int nUsed;
+	bool boFailed;
+	int nPlaces;
+};
+
+///////////////////////////////////////////////////////////////////
+// Global variables
+
+///////////////////////////////////////////////////////////////////
+// Function prototypes
+
+///////////////////////////////////////////////////////////////////
+// Function definitions
+
+ExportBuffer * NewExportBuffer (FILE * hFile, int nPlaces) {
+	ExportBuffer * psBuffer;
+
+	psBuffer = g_new0 (ExportBuffer, 1);
+	psBuffer->hFile = hFile;
+	psBuffer->acBlock = g_new (char, EXPORT_BLOCK_SIZE);
+	psBuffer->nUsed = 0;
+	psBuffer->boFailed = FALSE;
+	psBuffer->nPlaces = CLAMP (nPlaces, 0, EXPORT_PLACES_MAX);
+
+	return psBuffer;
+}
+
+// Write out anything left in the buffer before freeing it
+// Returns FALSE if any of the output couldn't be written
+bool DeleteExportBuffer (ExportBuffer * psBuffer) {
+	bool boSuccess;
+
+	FlushExportBuffer (psBuffer);
+	boSuccess = !psBuffer->boFailed;
+
+	g_free (psBuffer->acBlock);
+	g_free (psBuffer);
+
+	return boSuccess;
+}
+
+// The number of decimal places floats are written with
+int GetExportPlaces (ExportBuffer const * psBuffer) {
+	return psBuffer->nPlaces;
+}
+
+// Find space for nSize bytes of output at the end of the buffer, writing out the block first if it's too full
+// The space is taken as used, so must be filled straight away
+char * ExportSpace (int nSize, ExportBuffer * psBuffer) {
+	char * pcSpace;
+
+	pcSpace = ExportReserve (nSize, psBuffer);
+	psBuffer->nUsed += nSize;
+
+	return pcSpace;
+}
+
+// Find space for up to nSize bytes of output, without taking it as used
+// Once filled, ExportCommit must be called with the end of what was actually written
+char * ExportReserve (int nSize, ExportBuffer * psBuffer) {
+	g_assert (nSize <= EXPORT_BLOCK_SIZE);
+	if ((psBuffer->nUsed + nSize) > EXPORT_BLOCK_SIZE) {
+		FlushExportBuffer (psBuffer);
+	}
+
+	return psBuffer->acBlock + psBuffer->nUsed;
+}
+
+void ExportCommit (char const * pcEnd, ExportBuffer * psBuffer) {
+	psBuffer->nUsed = (int)(pcEnd - psBuffer->acBlock);
+	g_assert ((psBuffer->nUsed >= 0) && (psBuffer->nUsed <= EXPORT_BLOCK_SIZE));
+}
+
+void FlushExportBuffer (ExportBuffer * psBuffer) {
+	if (psBuffer->nUsed > 0) {
+		if (fwrite (psBuffer->acBlock, 1, psBuffer->nUsed, psBuffer->hFile) != (size_t)psBuffer->nUsed) {
+			psBuffer->boFailed = TRUE;
+		}
+		psBuffer->nUsed = 0;
+	}
+}
+
+// Write a float in fixed point with the given number of decimal places, up to EXPORT_PLACES_MAX, returning the end of the output
+// The output is the same as printf's %.*f in the C locale, but independent of the current locale and much faster
+// At most EXPORT_NUMBER_MAX - 1 characters are written
+char * FormatExportFloat (char * pcOut, float fValue, int nPlaces) {
+	double fMagnitude;
+	double fScaled;
+	guint64 uScale;
+	guint64 uWhole;
+	guint64 uFraction;
+	int nPlace;
+	char acDigits[EXPORT_PLACES_MAX];
+	char acBuffer[EXPORT_NUMBER_MAX];
+	int nLength;
+
+	// As with printf, negative zeroes and NaNs keep their sign
+	if (signbit (fValue)) {
+		* pcOut++ = '-';
+	}
+	if (isnan (fValue)) {
+		memcpy (pcOut, "nan", 3);
+		return pcOut + 3;
+	}
+	if (isinf (fValue)) {
+		memcpy (pcOut, "inf", 3);
+		return pcOut + 3;
+	}
+
+	fMagnitude = fabs ((double)fValue);
+	uScale = 1;
+	for (nPlace = 0; nPlace < nPlaces; nPlace++) {
+		uScale *= 10;
+	}
+
+	if (fMagnitude < EXPORT_WHOLE_MAX) {
+		// Round to the nearest, with exact halves going to even as printf does, carrying into the whole part if need be
+		// The scaled fraction is exact, as a float's mantissa times a power of ten up to 10^9 fits in a double's
+		uWhole = (guint64)fMagnitude;
+		fScaled = (fMagnitude - (double)uWhole) * (double)uScale;
+		uFraction = (guint64)fScaled;
+		fScaled -= (double)uFraction;
+		if ((fScaled > 0.5) || ((fScaled == 0.5) && ((nPlaces > 0 ? uFraction : uWhole) & 1))) {
+			uFraction++;
+		}
+		if (uFraction >= uScale) {
+			uWhole++;
+			uFraction -= uScale;
+		}
+
+		nLength = 0;
+		do {
+			acBuffer[nLength++] = '0' + (char)(uWhole % 10);
+			uWhole /= 10;
+		} while (uWhole > 0);
+		while (nLength > 0) {
+			* pcOut++ = acBuffer[--nLength];
+		}
+	}
+	else {
+		// A whole number, but with too many digits for the integer arithmetic above
+		g_ascii_formatd (acBuffer, sizeof (acBuffer), "%.0f", fMagnitude);
+		nLength = strlen (acBuffer);
+		memcpy (pcOut, acBuffer, nLength);
+		pcOut += nLength;
+		uFraction = 0;
+	}
+
+	if (nPlaces > 0) {
+		* pcOut++ = '.';
+		for (nPlace = nPlaces - 1; nPlace >= 0; nPlace--) {
+			acDigits[nPlace] = '0' + (char)(uFraction % 10);
+			uFraction /= 10;
+		}
+		memcpy (pcOut, acDigits, nPlaces);
+		pcOut += nPlaces;
+	}
+
+	return pcOut;
+}
+
+// Write an integer in decimal, returning the end of the output
+char * FormatExportInt (char * pcOut, int nValue) {
+	unsigned int uValue;
+	char acBuffer[12];
+	int nLength;
+
+	uValue = (unsigned int)nValue;
+	if (nValue < 0) {
+		* pcOut++ = '-';
+		uValue = 0u - uValue;
+	}
+
+	nLength = 0;
+	do {
+		acBuffer[nLength++] = '0' + (char)(uValue % 10);
+		uValue /= 10;
+	} while (uValue > 0);
+	while (nLength > 0) {
+		* pcOut++ = acBuffer[--nLength];
+	}
+
+	return pcOut;
+}
+
+// Quantise a colour component to a byte, rounding to the nearest as GL does for normalised colours
+unsigned char ExportColourByte (float fComponent) {
+	return (unsigned char)((CLAMP (fComponent, 0.0f, 1.0f) * 255.0f) + 0.5f);
+}
+
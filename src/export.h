@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////
+// Export
+// Buffered, locale-independent output for model exports
+//
+// David Llewellyn-Jones
+// http://www.flypig.co.uk
+//
+// Summer 2011
+///////////////////////////////////////////////////////////////////
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+///////////////////////////////////////////////////////////////////
+// Includes
+
+#include <stdio.h>
+
+#include "vector.h"
+
+///////////////////////////////////////////////////////////////////
+// Defines
+
+// Decimal places used for ASCII exports, the default matching printf's %f
+#define EXPORT_PLACES_DEFAULT (6)
+#define EXPORT_PLACES_MAX (9)
+
+// Longest number written to an ASCII export, including its separator
+// This is the sign, the 39 digits of the largest float, the point and the decimal places
+#define EXPORT_NUMBER_MAX (1 + 39 + 1 + EXPORT_PLACES_MAX + 1)
+
+///////////////////////////////////////////////////////////////////
+// Structures and enumerations
+
+typedef struct _ExportBuffer ExportBuffer;
+
+///////////////////////////////////////////////////////////////////
+// Global variables
+
+///////////////////////////////////////////////////////////////////
+// Function prototypes
+
+ExportBuffer * NewExportBuffer (FILE * hFile, int nPlaces);
+bool DeleteExportBuffer (ExportBuffer * psBuffer);
+int GetExportPlaces (ExportBuffer const * psBuffer);
+char * ExportSpace (int nSize, ExportBuffer * psBuffer);
+char * ExportReserve (int nSize, ExportBuffer * psBuffer);
+void ExportCommit (char const * pcEnd, ExportBuffer * psBuffer);
+void FlushExportBuffer (ExportBuffer * psBuffer);
+char * FormatExportFloat (char * pcOut, float fValue, int nPlaces);
+char * FormatExportInt (char * pcOut, int nValue);
+unsigned char ExportColourByte (float fComponent);
+
+///////////////////////////////////////////////////////////////////
+// Function definitions
+
+#endif /* EXPORT_H */
+
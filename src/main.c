@@ -1526,15 +1526,22 @@ bool SaveFile (char const * szFilename, MainPersist * psMainData) {
 bool ExportModelFile (char const * szFilename, MainPersist * psMainData) {
 	bool boSuccess;
 	CelticPersist * psCelticData;
-	LocaleRestore * psRestore;
+	GdkGLContext * psGlContext = gtk_widget_get_gl_context (psMainData->psDrawingArea);
+	GdkGLDrawable * psGlDrawable = gtk_widget_get_gl_drawable (psMainData->psDrawingArea);
 
-	psRestore = ClearLocale ();
+	// OpenGL BEGIN
+	// The tubes are read back from their vertex buffer
+	if (!gdk_gl_drawable_gl_begin (psGlDrawable, psGlContext)) {
+		return FALSE;
+	}
 
+	// Numbers are formatted independently of the locale, so there's no need to clear it
 	psCelticData = GetCelticData (psMainData->psVisData);
 	boSuccess = ExportModel (szFilename, psMainData->boBinary, psCelticData);
 
-	RestoreLocale (psRestore);
-	
+	gdk_gl_drawable_gl_end (psGlDrawable);
+	// OpenGL END
+
 	return boSuccess;
 }
 
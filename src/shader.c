@@ -212,3 +212,7 @@ void DeactivateShader (ShaderPersist * psShaderData) {
 	glUseProgram (0u);
 }
 
+GLuint GetShaderProgram (ShaderPersist * psShaderData) {
+	return psShaderData->uProgram;
+}
+
@@ -30,6 +30,7 @@ void LoadVertexShader (char const * const szFilename, ShaderPersist * psShaderDa
 void LoadFragmentShader (char const * const szFilename, ShaderPersist * psShaderData);
 void ActivateShader (ShaderPersist * psShaderData);
 void DeactivateShader (ShaderPersist * psShaderData);
+GLuint GetShaderProgram (ShaderPersist * psShaderData);
 
 #endif /* CELTIC_H */
 
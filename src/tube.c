@@ -0,0 +1,951 @@
+///////////////////////////////////////////////////////////////////
+// Tube
+// Tessellate bezier tubes on the CPU
+//
+// David Llewellyn-Jones
+// http://www.flypig.co.uk
+//
+// Summer 2011
+///////////////////////////////////////////////////////////////////
+
+
+///////////////////////////////////////////////////////////////////
+// Includes
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "tube.h"
+
+///////////////////////////////////////////////////////////////////
+// Defines
+
+// Position of the basis table for curves split into a given number of pieces
+// Each table holds four weights for each of the (pieces + 1) steps
+#define BASIS_OFFSET(PIECES) (2 * ((PIECES) - 1) * ((PIECES) + 2))
+
+// Below this, lengths are treated as zero when building tube frames
+#define FRAME_EPSILON (1.0e-12f)
+
+// Largest magnitude of a quantised component of a compact vertex
+#define COMPACT_RANGE (32767.0f)
+
+// Number of node pairs used when integrating along a curve
+#define GAUSS_NODES (4)
+
+// The vectorised ring generators are compiled for their own instruction sets whatever the build targets,
+// and the one to use is chosen at run time by what the processor supports
+// Compilers without per-function targets only get the SSE2 version, and only where the build guarantees it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TUBE_SSE2
+#define TUBE_AVX2
+#define TUBE_TARGET(ISA) __attribute__ ((target (ISA)))
+#include <immintrin.h>
+// The lower or upper four components of an eight component vector
+#define TUBE_HALF(VECTOR, HALF) ((HALF) ? _mm256_extractf128_ps ((VECTOR), 1) : _mm256_castps256_ps128 (VECTOR))
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define TUBE_SSE2
+#define TUBE_TARGET(ISA)
+#include <emmintrin.h>
+#endif
+
+///////////////////////////////////////////////////////////////////
+// Structures and enumerations
+
+// Generates the vertices for a single ring of a tube
+typedef void (*RingGenerator) (KnotVertex * asVertex, int nSegments, float const * afSin, float const * afCos, Vector3 const * pvPos, Vector3 const * pvAxisSin, Vector3 const * pvAxisCos, float fRadius, float const * afColour);
+
+// Everything here is only read while tubes are being generated, so any number of threads
+// can generate tubes at once as long as none of the setters are called at the same time
+struct _TubePersist {
+	int nPieces;
+	int nSegments;
+
+	// Bernstein weights at each step along a bezier, four per step
+	// There's a table for each number of pieces up to nPieces, found using BASIS_OFFSET
+	float * afBasis;
+	float * afBasisDeriv;
+
+	// Sine and cosine of each segment's angle, used when generating rings
+	float * afRingSin;
+	float * afRingCos;
+	RingGenerator GenerateRing;
+
+	// If the tolerance is non-zero each bezier is split into only as many pieces as it needs, between nPiecesMin and nPieces
+	float fTolerance;
+	int nPiecesMin;
+
+	// The twist at the end of each tube is a whole number of this many segments
+	int nTwistStride;
+
+	// Compact vertex positions are stored relative to the centre of the bounds, scaled to fill the quantised range
+	Vector3 vCompactCentre;
+	Vector3 vCompactScale;
+	Vector3 vCompactScaleInv;
+};
+
+///////////////////////////////////////////////////////////////////
+// Global variables
+
+// Eight point Gauss-Legendre quadrature over [-1, 1]; each node is used with both signs
+static float const gafGaussNode[GAUSS_NODES] = { 0.1834346425f, 0.5255324099f, 0.7966664774f, 0.9602898565f };
+static float const gafGaussWeight[GAUSS_NODES] = { 0.3626837834f, 0.3137066459f, 0.2223810345f, 0.1012285363f };
+
+///////////////////////////////////////////////////////////////////
+// Function prototypes
+
+Vector3 FixedFrameAxis (Vector3 const * pvTangent);
+Vector3 AlignFrameAxis (Vector3 const * pvAxis, Vector3 const * pvTangent);
+Vector3 TransportFrameAxis (Vector3 const * pvAxis, Vector3 * pvTangent, int nPieces, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, TubePersist const * psTubeData);
+float FrameTwist (Vector3 const * pvAxis, Vector3 const * pvTangent, Vector3 const * pvAxisEnd, TubePersist const * psTubeData);
+Vector3 GenerateTubeRings (void * pVertices, bool boCompact, bool boWelded, int nPieces, float fRadius, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, float const * afStartCol, float const * afEndCol, Vector3 const * pvAxis, Vector3 * pvTangent, float fTwistStart, float fTwistEnd, TubePersist const * psTubeData);
+void GenerateRingScalar (KnotVertex * asVertex, int nSegments, float const * afSin, float const * afCos, Vector3 const * pvPos, Vector3 const * pvAxisSin, Vector3 const * pvAxisCos, float fRadius, float const * afColour);
+#ifdef TUBE_SSE2
+TUBE_TARGET ("sse2") void GenerateRingSSE2 (KnotVertex * asVertex, int nSegments, float const * afSin, float const * afCos, Vector3 const * pvPos, Vector3 const * pvAxisSin, Vector3 const * pvAxisCos, float fRadius, float const * afColour);
+#endif
+#ifdef TUBE_AVX2
+TUBE_TARGET ("avx2") void GenerateRingAVX2 (KnotVertex * asVertex, int nSegments, float const * afSin, float const * afCos, Vector3 const * pvPos, Vector3 const * pvAxisSin, Vector3 const * pvAxisCos, float fRadius, float const * afColour);
+#endif
+void GenerateRingCompact (CompactVertex * asVertex, int nSegments, float const * afSin, float const * afCos, Vector3 const * pvPos, Vector3 const * pvAxisSin, Vector3 const * pvAxisCos, float fRadius, float const * afColour, TubePersist const * psTubeData);
+short QuantiseComponent (float fValue);
+void CreateRingTables (TubePersist * psTubeData);
+RingGenerator SelectRingGenerator ();
+Vector3 BezierTangent (float const * afWeightDeriv, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, Vector3 const * pvPrevious);
+Vector3 ReflectFrameAxis (Vector3 const * pvAxis, Vector3 const * pvPos, Vector3 const * pvTangent, Vector3 const * pvPosNext, Vector3 const * pvTangentNext);
+void CreateBasisTables (TubePersist * psTubeData);
+Vector3 BezierWeightedSum (float const * afWeight, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir);
+
+///////////////////////////////////////////////////////////////////
+// Function definitions
+
+TubePersist * NewTubePersist (int nPieces, int nSegments) {
+	TubePersist * psTubeData;
+
+	psTubeData = g_new0 (TubePersist, 1);
+
+	psTubeData->nPieces = nPieces;
+	psTubeData->nSegments = nSegments;
+
+	psTubeData->afBasis = NULL;
+	psTubeData->afBasisDeriv = NULL;
+	CreateBasisTables (psTubeData);
+
+	psTubeData->afRingSin = NULL;
+	psTubeData->afRingCos = NULL;
+	CreateRingTables (psTubeData);
+	psTubeData->GenerateRing = SelectRingGenerator ();
+
+	// Every bezier uses the full number of pieces unless a tolerance is set
+	psTubeData->fTolerance = 0.0f;
+	psTubeData->nPiecesMin = 1;
+
+	// Tubes may end with any whole number of segments of twist
+	psTubeData->nTwistStride = 1;
+
+	// Compact positions cover the unit box until bounds are set
+	SetVector3 (psTubeData->vCompactCentre, 0.0f, 0.0f, 0.0f);
+	SetVector3 (psTubeData->vCompactScale, 1.0f / COMPACT_RANGE, 1.0f / COMPACT_RANGE, 1.0f / COMPACT_RANGE);
+	SetVector3 (psTubeData->vCompactScaleInv, COMPACT_RANGE, COMPACT_RANGE, COMPACT_RANGE);
+
+	return psTubeData;
+}
+
+void DeleteTubePersist (TubePersist * psTubeData) {
+	g_free (psTubeData->afBasis);
+	psTubeData->afBasis = NULL;
+	g_free (psTubeData->afBasisDeriv);
+	psTubeData->afBasisDeriv = NULL;
+	g_free (psTubeData->afRingSin);
+	psTubeData->afRingSin = NULL;
+	g_free (psTubeData->afRingCos);
+	psTubeData->afRingCos = NULL;
+
+	g_free (psTubeData);
+}
+
+// Set the largest number of pieces along each tube and the number of segments around it
+// All tubes must be generated again after changing these
+void SetTubeAccuracy (int nPieces, int nSegments, TubePersist * psTubeData) {
+	psTubeData->nPieces = nPieces;
+	psTubeData->nSegments = nSegments;
+	CreateBasisTables (psTubeData);
+	CreateRingTables (psTubeData);
+}
+
+// The number of vertices needed to hold a tube split into the given number of pieces
+int TubeVertices (int nPieces, TubePersist const * psTubeData) {
+	return (nPieces + 1) * psTubeData->nSegments;
+}
+
+// Split beziers into as few pieces as possible while keeping within the given distance of the curve
+// A tolerance of zero splits every bezier into the full number of pieces
+void SetTubeTolerance (float fTolerance, int nPiecesMin, TubePersist * psTubeData) {
+	psTubeData->fTolerance = fTolerance;
+	psTubeData->nPiecesMin = MAX (nPiecesMin, 1);
+}
+
+// Restrict the twist at the end of each tube to a whole number of this many segments
+// Coarser tessellations that skip segments need this for their rings to line up
+void SetTubeTwistStride (int nTwistStride, TubePersist * psTubeData) {
+	psTubeData->nTwistStride = MAX (nTwistStride, 1);
+}
+
+// Set the box that all of the tubes lie within, used to quantise compact vertex positions
+// Anything outside the box is clamped to its edge
+void SetTubeBounds (Vector3 vMin, Vector3 vMax, TubePersist * psTubeData) {
+	Vector3 vHalfSize;
+
+	psTubeData->vCompactCentre.fX = (vMin.fX + vMax.fX) / 2.0f;
+	psTubeData->vCompactCentre.fY = (vMin.fY + vMax.fY) / 2.0f;
+	psTubeData->vCompactCentre.fZ = (vMin.fZ + vMax.fZ) / 2.0f;
+
+	// Flat boxes are given some depth to avoid dividing by zero
+	vHalfSize.fX = MAX ((vMax.fX - vMin.fX) / 2.0f, FRAME_EPSILON);
+	vHalfSize.fY = MAX ((vMax.fY - vMin.fY) / 2.0f, FRAME_EPSILON);
+	vHalfSize.fZ = MAX ((vMax.fZ - vMin.fZ) / 2.0f, FRAME_EPSILON);
+
+	psTubeData->vCompactScale = ScaleVector (& vHalfSize, 1.0f / COMPACT_RANGE);
+	psTubeData->vCompactScaleInv.fX = COMPACT_RANGE / vHalfSize.fX;
+	psTubeData->vCompactScaleInv.fY = COMPACT_RANGE / vHalfSize.fY;
+	psTubeData->vCompactScaleInv.fZ = COMPACT_RANGE / vHalfSize.fZ;
+}
+
+// The offset and scale needed to decode compact vertex positions
+void GetTubeBounds (Vector3 * pvCentre, Vector3 * pvScale, TubePersist const * psTubeData) {
+	*pvCentre = psTubeData->vCompactCentre;
+	*pvScale = psTubeData->vCompactScale;
+}
+
+// Recover the position and normal of a compact vertex, as the vertex shader does
+void DecodeCompactVertex (CompactVertex const * psVertex, Vector3 * pvPos, Vector3 * pvNormal, TubePersist const * psTubeData) {
+	float fU;
+	float fV;
+	float fTemp;
+
+	pvPos->fX = psTubeData->vCompactCentre.fX + (psTubeData->vCompactScale.fX * (float)psVertex->anPos[0]);
+	pvPos->fY = psTubeData->vCompactCentre.fY + (psTubeData->vCompactScale.fY * (float)psVertex->anPos[1]);
+	pvPos->fZ = psTubeData->vCompactCentre.fZ + (psTubeData->vCompactScale.fZ * (float)psVertex->anPos[2]);
+
+	// Unfold the lower half of the octahedron from the corners of the square
+	fU = (float)psVertex->anNormal[0] / COMPACT_RANGE;
+	fV = (float)psVertex->anNormal[1] / COMPACT_RANGE;
+	pvNormal->fX = fU;
+	pvNormal->fY = fV;
+	pvNormal->fZ = 1.0f - fabs (fU) - fabs (fV);
+	if (pvNormal->fZ < 0.0f) {
+		fTemp = pvNormal->fX;
+		pvNormal->fX = (1.0f - fabs (pvNormal->fY)) * ((fTemp >= 0.0f) ? 1.0f : -1.0f);
+		pvNormal->fY = (1.0f - fabs (fTemp)) * ((pvNormal->fY >= 0.0f) ? 1.0f : -1.0f);
+	}
+	Normalise (pvNormal);
+}
+
+// Calculate the weights of the four control points at each of the steps along a bezier
+// The weights are ordered start, start direction, end direction, end, as for BEZIER
+void CreateBasisTables (TubePersist * psTubeData) {
+	int nPieces;
+	int nPiece;
+	float fStep;
+	float fStepInv;
+	float * afWeight;
+	float * afWeightDeriv;
+
+	g_free (psTubeData->afBasis);
+	g_free (psTubeData->afBasisDeriv);
+	psTubeData->afBasis = g_new0 (float, BASIS_OFFSET (psTubeData->nPieces + 1));
+	psTubeData->afBasisDeriv = g_new0 (float, BASIS_OFFSET (psTubeData->nPieces + 1));
+
+	// One table for each number of pieces a bezier might be split into
+	for (nPieces = 1; nPieces <= psTubeData->nPieces; nPieces++) {
+		for (nPiece = 0; nPiece <= nPieces; nPiece++) {
+			fStep = ((float)(nPiece)) / ((float)(nPieces));
+			fStepInv = 1.0f - fStep;
+			afWeight = psTubeData->afBasis + BASIS_OFFSET (nPieces) + (nPiece * 4);
+			afWeightDeriv = psTubeData->afBasisDeriv + BASIS_OFFSET (nPieces) + (nPiece * 4);
+
+			afWeight[0] = fStepInv * fStepInv * fStepInv;
+			afWeight[1] = 3.0f * fStepInv * fStepInv * fStep;
+			afWeight[2] = 3.0f * fStepInv * fStep * fStep;
+			afWeight[3] = fStep * fStep * fStep;
+
+			afWeightDeriv[0] = -3.0f * fStepInv * fStepInv;
+			afWeightDeriv[1] = (3.0f * fStepInv * fStepInv) - (6.0f * fStepInv * fStep);
+			afWeightDeriv[2] = (6.0f * fStepInv * fStep) - (3.0f * fStep * fStep);
+			afWeightDeriv[3] = 3.0f * fStep * fStep;
+		}
+	}
+}
+
+// Cache the sine and cosine of each segment's angle around the tube
+void CreateRingTables (TubePersist * psTubeData) {
+	int nSegment;
+	float fTheta;
+
+	g_free (psTubeData->afRingSin);
+	g_free (psTubeData->afRingCos);
+	psTubeData->afRingSin = g_new0 (float, psTubeData->nSegments);
+	psTubeData->afRingCos = g_new0 (float, psTubeData->nSegments);
+
+	for (nSegment = 0; nSegment < psTubeData->nSegments; nSegment++) {
+		fTheta = (float)nSegment * (2.0 * M_PI / (float)psTubeData->nSegments);
+		psTubeData->afRingSin[nSegment] = sin (fTheta);
+		psTubeData->afRingCos[nSegment] = cos (fTheta);
+	}
+}
+
+// Choose the fastest ring generator supported by the processor
+RingGenerator SelectRingGenerator () {
+	RingGenerator GenerateRing;
+
+	GenerateRing = GenerateRingScalar;
+#if defined(TUBE_AVX2)
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("avx2")) {
+		GenerateRing = GenerateRingAVX2;
+	}
+	else if (__builtin_cpu_supports ("sse2")) {
+		GenerateRing = GenerateRingSSE2;
+	}
+#elif defined(TUBE_SSE2)
+	GenerateRing = GenerateRingSSE2;
+#endif
+
+	return GenerateRing;
+}
+
+// Choose how many pieces a bezier should be split into
+// The second differences of the control points bound the second derivative of the curve,
+// and so how far the curve can stray from the straight pieces used to approximate it
+int TubePieces (Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, TubePersist const * psTubeData) {
+	int nPieces;
+	Vector3 vDiff1;
+	Vector3 vDiff2;
+	float fBend;
+
+	nPieces = psTubeData->nPieces;
+	if (psTubeData->fTolerance > 0.0f) {
+		vDiff1.fX = pvStart->fX - (2.0f * pvStartDir->fX) + pvEndDir->fX;
+		vDiff1.fY = pvStart->fY - (2.0f * pvStartDir->fY) + pvEndDir->fY;
+		vDiff1.fZ = pvStart->fZ - (2.0f * pvStartDir->fZ) + pvEndDir->fZ;
+		vDiff2.fX = pvStartDir->fX - (2.0f * pvEndDir->fX) + pvEnd->fX;
+		vDiff2.fY = pvStartDir->fY - (2.0f * pvEndDir->fY) + pvEnd->fY;
+		vDiff2.fZ = pvStartDir->fZ - (2.0f * pvEndDir->fZ) + pvEnd->fZ;
+		fBend = MAX (Length (& vDiff1), Length (& vDiff2));
+
+		// With n pieces the error is at most (6 / 8) * fBend / n^2
+		nPieces = (int)ceil (sqrt ((0.75f * fBend) / psTubeData->fTolerance));
+		nPieces = CLAMP (nPieces, MIN (psTubeData->nPiecesMin, psTubeData->nPieces), psTubeData->nPieces);
+	}
+
+	return nPieces;
+}
+
+// Generate the rings of vertices for a tube, either as KnotVertex or in the compact layout
+// The end rings sit in the same place as those of neighbouring tubes, but their vertices may start from a different segment,
+// so a tube generated on its own can't share a ring with its neighbour (see GenerateTubeChain)
+void GenerateTube (void * pVertices, bool boCompact, int nPieces, float fRadius, Vector3 vStart, Vector3 vStartDir, Vector3 vEnd, Vector3 vEndDir, float const * afStartCol, float const * afEndCol, TubePersist const * psTubeData) {
+	Vector3 vTangent;
+	Vector3 vAxisStart;
+	float fTwist;
+
+	FindTubeFrame (& vAxisStart, & fTwist, nPieces, & vStart, & vStartDir, & vEnd, & vEndDir, psTubeData);
+
+	SetVector3 (vTangent, 1.0f, 0.0f, 0.0f);
+	GenerateTubeRings (pVertices, boCompact, FALSE, nPieces, fRadius, & vStart, & vStartDir, & vEnd, & vEndDir, afStartCol, afEndCol, & vAxisStart, & vTangent, 0.0f, fTwist, psTubeData);
+}
+
+// Find the axis of the frame a tube starts with, and the twist spread along it to bring its end in line, as used by GenerateTube
+// The vertex shader carries the frame along the tube from these in the same way, so that the tubes it generates match
+void FindTubeFrame (Vector3 * pvAxis, float * pfTwist, int nPieces, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, TubePersist const * psTubeData) {
+	Vector3 vTangent;
+	Vector3 vUnit1;
+	Vector3 vAxisEnd;
+	Vector3 vAxis;
+
+	SetVector3 (vUnit1, 1.0f, 0.0f, 0.0f);
+
+	// Each end of the tube is oriented in a fixed way for its direction, so that the rings of neighbouring tubes line up where they join
+	vTangent = BezierTangent (psTubeData->afBasisDeriv + BASIS_OFFSET (nPieces), pvStart, pvStartDir, pvEnd, pvEndDir, & vUnit1);
+	*pvAxis = FixedFrameAxis (& vTangent);
+
+	// Follow the rotation-minimising frame along the curve, then twist it in line with the end orientation
+	vTangent = vUnit1;
+	vAxis = TransportFrameAxis (pvAxis, & vTangent, nPieces, pvStart, pvStartDir, pvEnd, pvEndDir, psTubeData);
+	vAxisEnd = FixedFrameAxis (& vTangent);
+	*pfTwist = FrameTwist (& vAxis, & vTangent, & vAxisEnd, psTubeData);
+}
+
+// Generate the rings for a chain of beziers, each starting where the previous one ends with the same direction
+// The tube follows a single rotation-minimising frame along the whole chain
+// A closed chain ends where it starts, so the twist needed to meet its first ring is spread along the whole chain;
+// the ends of an open chain are oriented in the same way as a single bezier, so they line up with anything joined on to them
+// Each link is split into anPieces pieces and its rings are written to apVertices, leaving out the first ring if it's welded
+void GenerateTubeChain (void * const * apVertices, bool boCompact, bool const * aboWelded, int const * anPieces, int nLinks, TubeLink const * asLink, float fRadius, bool boClosed, TubePersist const * psTubeData) {
+	TubeLink const * psLink;
+	int nLink;
+	int nPiecesTotal;
+	int nPiecesDone;
+	Vector3 vUnit1;
+	Vector3 vTangent;
+	Vector3 vAxisStart;
+	Vector3 vAxisEnd;
+	Vector3 vAxis;
+	float fTwist;
+	float fTwistStart;
+	float fTwistEnd;
+
+	if (nLinks <= 0) {
+		return;
+	}
+
+	// Follow the frame along the whole chain to find how far it's turned by the end
+	SetVector3 (vUnit1, 1.0f, 0.0f, 0.0f);
+	psLink = & asLink[0];
+	vTangent = BezierTangent (psTubeData->afBasisDeriv + BASIS_OFFSET (anPieces[0]), & psLink->vStart, & psLink->vStartDir, & psLink->vEnd, & psLink->vEndDir, & vUnit1);
+	vAxisStart = FixedFrameAxis (& vTangent);
+
+	vAxis = vAxisStart;
+	nPiecesTotal = 0;
+	for (nLink = 0; nLink < nLinks; nLink++) {
+		psLink = & asLink[nLink];
+		vAxis = TransportFrameAxis (& vAxis, & vTangent, anPieces[nLink], & psLink->vStart, & psLink->vStartDir, & psLink->vEnd, & psLink->vEndDir, psTubeData);
+		nPiecesTotal += anPieces[nLink];
+	}
+
+	if (boClosed) {
+		vAxisEnd = vAxisStart;
+	}
+	else {
+		vAxisEnd = FixedFrameAxis (& vTangent);
+	}
+	fTwist = FrameTwist (& vAxis, & vTangent, & vAxisEnd, psTubeData);
+
+	// Generate the rings, spreading the twist evenly over every piece of the chain
+	vAxis = vAxisStart;
+	SetVector3 (vTangent, 1.0f, 0.0f, 0.0f);
+	nPiecesDone = 0;
+	fTwistStart = 0.0f;
+	for (nLink = 0; nLink < nLinks; nLink++) {
+		psLink = & asLink[nLink];
+		nPiecesDone += anPieces[nLink];
+		fTwistEnd = fTwist * (float)nPiecesDone / (float)nPiecesTotal;
+
+		vAxis = GenerateTubeRings (apVertices[nLink], boCompact, aboWelded[nLink], anPieces[nLink], fRadius, & psLink->vStart, & psLink->vStartDir, & psLink->vEnd, & psLink->vEndDir, psLink->afStartCol, psLink->afEndCol, & vAxis, & vTangent, fTwistStart, fTwistEnd, psTubeData);
+
+		fTwistStart = fTwistEnd;
+	}
+}
+
+// The orientation given to the end of a tube, found by rotating the x-axis onto the curve direction
+// It depends only on the direction, so tubes that meet with the same direction have matching rings
+Vector3 FixedFrameAxis (Vector3 const * pvTangent) {
+	Vector3 vUnit1;
+	Vector3 vUnit2;
+	Vector3 vTangent;
+	Matrix3 mRotate;
+
+	SetVector3 (vUnit1, 1.0f, 0.0f, 0.0f);
+	SetVector3 (vUnit2, 0.0f, 1.0f, 0.0f);
+	vTangent = *pvTangent;
+	mRotate = RotationBetweenVectors (& vUnit1, & vTangent);
+
+	return MultMatrixVector (& mRotate, & vUnit2);
+}
+
+// Make a frame axis perpendicular to the tangent again
+// Where beziers are chained together the tangents match, so this only removes rounding errors
+Vector3 AlignFrameAxis (Vector3 const * pvAxis, Vector3 const * pvTangent) {
+	Vector3 vAxis;
+	Vector3 vScaled;
+	float fLength;
+
+	vScaled = ScaleVector (pvTangent, DotProduct (pvAxis, pvTangent));
+	vAxis = SubtractVectors (pvAxis, & vScaled);
+	fLength = Length (& vAxis);
+	if (fLength > FRAME_EPSILON) {
+		vAxis = ScaleVector (& vAxis, 1.0f / fLength);
+	}
+	else {
+		vAxis = *pvAxis;
+	}
+
+	return vAxis;
+}
+
+// Carry the axis of a rotation-minimising frame from the start of a bezier to its end, without generating any rings
+// The tangent is used if the curve has no direction at its start, and is replaced by the tangent at the end
+Vector3 TransportFrameAxis (Vector3 const * pvAxis, Vector3 * pvTangent, int nPieces, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, TubePersist const * psTubeData) {
+	int nPiece;
+	float const * afBasis;
+	float const * afBasisDeriv;
+	Vector3 vPos;
+	Vector3 vPosPrev;
+	Vector3 vTangent;
+	Vector3 vTangentPrev;
+	Vector3 vAxis;
+
+	afBasis = psTubeData->afBasis + BASIS_OFFSET (nPieces);
+	afBasisDeriv = psTubeData->afBasisDeriv + BASIS_OFFSET (nPieces);
+
+	vPos = BezierWeightedSum (afBasis, pvStart, pvStartDir, pvEnd, pvEndDir);
+	vTangent = BezierTangent (afBasisDeriv, pvStart, pvStartDir, pvEnd, pvEndDir, pvTangent);
+	vAxis = AlignFrameAxis (pvAxis, & vTangent);
+	for (nPiece = 1; nPiece <= nPieces; nPiece++) {
+		vPosPrev = vPos;
+		vTangentPrev = vTangent;
+		vPos = BezierWeightedSum (afBasis + (nPiece * 4), pvStart, pvStartDir, pvEnd, pvEndDir);
+		vTangent = BezierTangent (afBasisDeriv + (nPiece * 4), pvStart, pvStartDir, pvEnd, pvEndDir, & vTangentPrev);
+		vAxis = ReflectFrameAxis (& vAxis, & vPosPrev, & vTangentPrev, & vPos, & vTangent);
+	}
+
+	*pvTangent = vTangent;
+	return vAxis;
+}
+
+// Find the twist needed to bring a transported frame in line with the orientation it should end with
+// Rotating a ring by a whole segment leaves it unchanged, so the twist never needs to exceed half a segment,
+// except that the coarser detail levels skip segments, so for them to line up it's taken to the nearest stride
+float FrameTwist (Vector3 const * pvAxis, Vector3 const * pvTangent, Vector3 const * pvAxisEnd, TubePersist const * psTubeData) {
+	Vector3 vAxis;
+	Vector3 vTangent;
+	Vector3 vAxisCos;
+	float fTwist;
+	float fSegmentAngle;
+
+	vAxis = *pvAxis;
+	vTangent = *pvTangent;
+	vAxisCos = CrossProduct (& vTangent, & vAxis);
+	fTwist = atan2 (DotProduct (pvAxisEnd, pvAxis), DotProduct (pvAxisEnd, & vAxisCos)) - (M_PI / 2.0);
+	fSegmentAngle = (2.0f * M_PI * (float)psTubeData->nTwistStride / (float)psTubeData->nSegments);
+	fTwist -= fSegmentAngle * floor ((fTwist / fSegmentAngle) + 0.5f);
+
+	return fTwist;
+}
+
+// Generate the rings of a tube, carrying the frame along from the given start axis
+// The twist changes evenly from fTwistStart at the first ring to fTwistEnd at the last
+// Returns the untwisted axis at the end, and the tangent is updated as for TransportFrameAxis
+Vector3 GenerateTubeRings (void * pVertices, bool boCompact, bool boWelded, int nPieces, float fRadius, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, float const * afStartCol, float const * afEndCol, Vector3 const * pvAxis, Vector3 * pvTangent, float fTwistStart, float fTwistEnd, TubePersist const * psTubeData) {
+	int nPiece;
+	int nSegments;
+	float const * afBasis;
+	float const * afBasisDeriv;
+	Vector3 vPos;
+	Vector3 vPosPrev;
+	Vector3 vTangent;
+	Vector3 vTangentPrev;
+	Vector3 vAxisSin;
+	Vector3 vAxisCos;
+	Vector3 vRingSin;
+	Vector3 vRingCos;
+	float fCosStep;
+	float fSinStep;
+	float fCosTwist;
+	float fSinTwist;
+	float fTemp;
+	float fColScale;
+	float afColour[TUBE_COL_COMPONENTS];
+
+	nSegments = psTubeData->nSegments;
+	afBasis = psTubeData->afBasis + BASIS_OFFSET (nPieces);
+	afBasisDeriv = psTubeData->afBasisDeriv + BASIS_OFFSET (nPieces);
+
+	// The twist is spread evenly along the tube, one step per ring
+	fCosStep = cos ((fTwistEnd - fTwistStart) / (float)nPieces);
+	fSinStep = sin ((fTwistEnd - fTwistStart) / (float)nPieces);
+	fCosTwist = cos (fTwistStart);
+	fSinTwist = sin (fTwistStart);
+
+	vPos = BezierWeightedSum (afBasis, pvStart, pvStartDir, pvEnd, pvEndDir);
+	vTangent = *pvTangent;
+	vAxisSin = *pvAxis;
+	for (nPiece = 0; nPiece <= nPieces; nPiece++) {
+		fColScale = ((float)nPiece / (float)nPieces);
+
+		// Calculate the translation due to the bezier curve and carry the frame along with it
+		vPosPrev = vPos;
+		vTangentPrev = vTangent;
+		vPos = BezierWeightedSum (afBasis + (nPiece * 4), pvStart, pvStartDir, pvEnd, pvEndDir);
+		vTangent = BezierTangent (afBasisDeriv + (nPiece * 4), pvStart, pvStartDir, pvEnd, pvEndDir, & vTangentPrev);
+		if (nPiece > 0) {
+			vAxisSin = ReflectFrameAxis (& vAxisSin, & vPosPrev, & vTangentPrev, & vPos, & vTangent);
+		}
+		else {
+			vAxisSin = AlignFrameAxis (& vAxisSin, & vTangent);
+		}
+		vAxisCos = CrossProduct (& vTangent, & vAxisSin);
+
+		// Adding the twist to every segment's angle is the same as rotating the two axes by it
+		vRingSin.fX = (vAxisSin.fX * fCosTwist) - (vAxisCos.fX * fSinTwist);
+		vRingSin.fY = (vAxisSin.fY * fCosTwist) - (vAxisCos.fY * fSinTwist);
+		vRingSin.fZ = (vAxisSin.fZ * fCosTwist) - (vAxisCos.fZ * fSinTwist);
+		vRingCos.fX = (vAxisSin.fX * fSinTwist) + (vAxisCos.fX * fCosTwist);
+		vRingCos.fY = (vAxisSin.fY * fSinTwist) + (vAxisCos.fY * fCosTwist);
+		vRingCos.fZ = (vAxisSin.fZ * fSinTwist) + (vAxisCos.fZ * fCosTwist);
+
+		afColour[0] = (afEndCol[0] * fColScale) + (afStartCol[0] * (1.0f - fColScale));
+		afColour[1] = (afEndCol[1] * fColScale) + (afStartCol[1] * (1.0f - fColScale));
+		afColour[2] = (afEndCol[2] * fColScale) + (afStartCol[2] * (1.0f - fColScale));
+
+		if (boWelded && (nPiece == 0)) {
+			// The first ring belongs to the previous tube
+		}
+		else if (boCompact) {
+			GenerateRingCompact ((CompactVertex *)pVertices + (nPiece * nSegments), nSegments, psTubeData->afRingSin, psTubeData->afRingCos, & vPos, & vRingSin, & vRingCos, fRadius, afColour, psTubeData);
+		}
+		else {
+			psTubeData->GenerateRing ((KnotVertex *)pVertices + (nPiece * nSegments), nSegments, psTubeData->afRingSin, psTubeData->afRingCos, & vPos, & vRingSin, & vRingCos, fRadius, afColour);
+		}
+
+		// Advance the twist ready for the next ring
+		fTemp = (fCosTwist * fCosStep) - (fSinTwist * fSinStep);
+		fSinTwist = (fSinTwist * fCosStep) + (fCosTwist * fSinStep);
+		fCosTwist = fTemp;
+	}
+
+	*pvTangent = vTangent;
+	return vAxisSin;
+}
+
+// Evaluate a bezier (or its derivative) using one step's worth of weights from the basis tables
+Vector3 BezierWeightedSum (float const * afWeight, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir) {
+	Vector3 vResult;
+
+	vResult.fX = (afWeight[0] * pvStart->fX) + (afWeight[1] * pvStartDir->fX) + (afWeight[2] * pvEndDir->fX) + (afWeight[3] * pvEnd->fX);
+	vResult.fY = (afWeight[0] * pvStart->fY) + (afWeight[1] * pvStartDir->fY) + (afWeight[2] * pvEndDir->fY) + (afWeight[3] * pvEnd->fY);
+	vResult.fZ = (afWeight[0] * pvStart->fZ) + (afWeight[1] * pvStartDir->fZ) + (afWeight[2] * pvEndDir->fZ) + (afWeight[3] * pvEnd->fZ);
+
+	return vResult;
+}
+
+// The unit direction of the curve at a step, using the basis derivative weights
+// Where the curve has no direction (for example a zero length curve) the previous direction is kept
+Vector3 BezierTangent (float const * afWeightDeriv, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, Vector3 const * pvPrevious) {
+	Vector3 vTangent;
+	float fLength;
+
+	vTangent = BezierWeightedSum (afWeightDeriv, pvStart, pvStartDir, pvEnd, pvEndDir);
+	fLength = Length (& vTangent);
+	if (fLength > FRAME_EPSILON) {
+		vTangent = ScaleVector (& vTangent, 1.0f / fLength);
+	}
+	else {
+		vTangent = *pvPrevious;
+	}
+
+	return vTangent;
+}
+
+// Carry the reference axis of a rotation-minimising frame from one ring to the next
+// Uses the double reflection method of Wang et al., which needs no trigonometric functions:
+// the first reflection maps one ring centre onto the next, the second aligns the tangents
+Vector3 ReflectFrameAxis (Vector3 const * pvAxis, Vector3 const * pvPos, Vector3 const * pvTangent, Vector3 const * pvPosNext, Vector3 const * pvTangentNext) {
+	Vector3 vAxis;
+	Vector3 vTangent;
+	Vector3 vReflect;
+	Vector3 vScaled;
+	float fLengthSquared;
+
+	vAxis = *pvAxis;
+	vTangent = *pvTangent;
+
+	vReflect = SubtractVectors (pvPosNext, pvPos);
+	fLengthSquared = DotProduct (& vReflect, & vReflect);
+	if (fLengthSquared > FRAME_EPSILON) {
+		vScaled = ScaleVector (& vReflect, 2.0f * DotProduct (& vReflect, & vAxis) / fLengthSquared);
+		vAxis = SubtractVectors (& vAxis, & vScaled);
+		vScaled = ScaleVector (& vReflect, 2.0f * DotProduct (& vReflect, & vTangent) / fLengthSquared);
+		vTangent = SubtractVectors (& vTangent, & vScaled);
+	}
+
+	vReflect = SubtractVectors (pvTangentNext, & vTangent);
+	fLengthSquared = DotProduct (& vReflect, & vReflect);
+	if (fLengthSquared > FRAME_EPSILON) {
+		vScaled = ScaleVector (& vReflect, 2.0f * DotProduct (& vReflect, & vAxis) / fLengthSquared);
+		vAxis = SubtractVectors (& vAxis, & vScaled);
+	}
+
+	return vAxis;
+}
+
+// Generate a ring of vertices around vPos, one for each segment
+// Each vertex is offset along the two axes by the sine and cosine of its segment's angle
+// This is the reference implementation that any vectorised version should match
+void GenerateRingScalar (KnotVertex * asVertex, int nSegments, float const * afSin, float const * afCos, Vector3 const * pvPos, Vector3 const * pvAxisSin, Vector3 const * pvAxisCos, float fRadius, float const * afColour) {
+	int nSegment;
+	Vector3 vOffset;
+
+	for (nSegment = 0; nSegment < nSegments; nSegment++) {
+		vOffset.fX = (pvAxisSin->fX * afSin[nSegment]) + (pvAxisCos->fX * afCos[nSegment]);
+		vOffset.fY = (pvAxisSin->fY * afSin[nSegment]) + (pvAxisCos->fY * afCos[nSegment]);
+		vOffset.fZ = (pvAxisSin->fZ * afSin[nSegment]) + (pvAxisCos->fZ * afCos[nSegment]);
+
+		asVertex[nSegment].fX = pvPos->fX + (fRadius * vOffset.fX);
+		asVertex[nSegment].fY = pvPos->fY + (fRadius * vOffset.fY);
+		asVertex[nSegment].fZ = pvPos->fZ + (fRadius * vOffset.fZ);
+		asVertex[nSegment].fNX = vOffset.fX;
+		asVertex[nSegment].fNY = vOffset.fY;
+		asVertex[nSegment].fNZ = vOffset.fZ;
+
+		asVertex[nSegment].afColour[0] = afColour[0];
+		asVertex[nSegment].afColour[1] = afColour[1];
+		asVertex[nSegment].afColour[2] = afColour[2];
+	}
+}
+
+#ifdef TUBE_SSE2
+// As GenerateRingScalar, but generating four vertices at a time
+// The components are calculated separately, then transposed into the interleaved vertex layout
+TUBE_TARGET ("sse2") void GenerateRingSSE2 (KnotVertex * asVertex, int nSegments, float const * afSin, float const * afCos, Vector3 const * pvPos, Vector3 const * pvAxisSin, Vector3 const * pvAxisCos, float fRadius, float const * afColour) {
+	int nSegment;
+	int nVertex;
+	__m128 vSin;
+	__m128 vCos;
+	__m128 vRadius;
+	__m128 vX;
+	__m128 vY;
+	__m128 vZ;
+	__m128 vNX;
+	__m128 vNY;
+	__m128 vNZ;
+	__m128 vRed;
+	__m128 vGreen;
+	__m128 avLow[4];
+	__m128 avHigh[4];
+
+	vRadius = _mm_set1_ps (fRadius);
+	vRed = _mm_set1_ps (afColour[0]);
+	vGreen = _mm_set1_ps (afColour[1]);
+
+	for (nSegment = 0; (nSegment + 4) <= nSegments; nSegment += 4) {
+		vSin = _mm_loadu_ps (afSin + nSegment);
+		vCos = _mm_loadu_ps (afCos + nSegment);
+
+		vNX = _mm_add_ps (_mm_mul_ps (_mm_set1_ps (pvAxisSin->fX), vSin), _mm_mul_ps (_mm_set1_ps (pvAxisCos->fX), vCos));
+		vNY = _mm_add_ps (_mm_mul_ps (_mm_set1_ps (pvAxisSin->fY), vSin), _mm_mul_ps (_mm_set1_ps (pvAxisCos->fY), vCos));
+		vNZ = _mm_add_ps (_mm_mul_ps (_mm_set1_ps (pvAxisSin->fZ), vSin), _mm_mul_ps (_mm_set1_ps (pvAxisCos->fZ), vCos));
+
+		vX = _mm_add_ps (_mm_set1_ps (pvPos->fX), _mm_mul_ps (vRadius, vNX));
+		vY = _mm_add_ps (_mm_set1_ps (pvPos->fY), _mm_mul_ps (vRadius, vNY));
+		vZ = _mm_add_ps (_mm_set1_ps (pvPos->fZ), _mm_mul_ps (vRadius, vNZ));
+
+		// Each vertex is x, y, z, nx followed by ny, nz, red, green, and then blue
+		avLow[0] = vX;
+		avLow[1] = vY;
+		avLow[2] = vZ;
+		avLow[3] = vNX;
+		_MM_TRANSPOSE4_PS (avLow[0], avLow[1], avLow[2], avLow[3]);
+		avHigh[0] = vNY;
+		avHigh[1] = vNZ;
+		avHigh[2] = vRed;
+		avHigh[3] = vGreen;
+		_MM_TRANSPOSE4_PS (avHigh[0], avHigh[1], avHigh[2], avHigh[3]);
+
+		for (nVertex = 0; nVertex < 4; nVertex++) {
+			_mm_storeu_ps (& asVertex[nSegment + nVertex].fX, avLow[nVertex]);
+			_mm_storeu_ps (& asVertex[nSegment + nVertex].fNY, avHigh[nVertex]);
+			asVertex[nSegment + nVertex].afColour[2] = afColour[2];
+		}
+	}
+
+	// Any remaining vertices
+	if (nSegment < nSegments) {
+		GenerateRingScalar (asVertex + nSegment, nSegments - nSegment, afSin + nSegment, afCos + nSegment, pvPos, pvAxisSin, pvAxisCos, fRadius, afColour);
+	}
+}
+#endif
+
+#ifdef TUBE_AVX2
+// As GenerateRingSSE2, but calculating eight vertices at a time
+// Each half of the components is then transposed into the vertex layout in the same way
+TUBE_TARGET ("avx2") void GenerateRingAVX2 (KnotVertex * asVertex, int nSegments, float const * afSin, float const * afCos, Vector3 const * pvPos, Vector3 const * pvAxisSin, Vector3 const * pvAxisCos, float fRadius, float const * afColour) {
+	int nSegment;
+	int nHalf;
+	int nVertex;
+	__m256 vSin;
+	__m256 vCos;
+	__m256 vRadius;
+	__m256 vX;
+	__m256 vY;
+	__m256 vZ;
+	__m256 vNX;
+	__m256 vNY;
+	__m256 vNZ;
+	__m128 vRed;
+	__m128 vGreen;
+	__m128 avLow[4];
+	__m128 avHigh[4];
+
+	vRadius = _mm256_set1_ps (fRadius);
+	vRed = _mm_set1_ps (afColour[0]);
+	vGreen = _mm_set1_ps (afColour[1]);
+
+	for (nSegment = 0; (nSegment + 8) <= nSegments; nSegment += 8) {
+		vSin = _mm256_loadu_ps (afSin + nSegment);
+		vCos = _mm256_loadu_ps (afCos + nSegment);
+
+		// Multiplies and adds are kept separate so that the results match GenerateRingScalar
+		vNX = _mm256_add_ps (_mm256_mul_ps (_mm256_set1_ps (pvAxisSin->fX), vSin), _mm256_mul_ps (_mm256_set1_ps (pvAxisCos->fX), vCos));
+		vNY = _mm256_add_ps (_mm256_mul_ps (_mm256_set1_ps (pvAxisSin->fY), vSin), _mm256_mul_ps (_mm256_set1_ps (pvAxisCos->fY), vCos));
+		vNZ = _mm256_add_ps (_mm256_mul_ps (_mm256_set1_ps (pvAxisSin->fZ), vSin), _mm256_mul_ps (_mm256_set1_ps (pvAxisCos->fZ), vCos));
+
+		vX = _mm256_add_ps (_mm256_set1_ps (pvPos->fX), _mm256_mul_ps (vRadius, vNX));
+		vY = _mm256_add_ps (_mm256_set1_ps (pvPos->fY), _mm256_mul_ps (vRadius, vNY));
+		vZ = _mm256_add_ps (_mm256_set1_ps (pvPos->fZ), _mm256_mul_ps (vRadius, vNZ));
+
+		for (nHalf = 0; nHalf < 2; nHalf++) {
+			avLow[0] = TUBE_HALF (vX, nHalf);
+			avLow[1] = TUBE_HALF (vY, nHalf);
+			avLow[2] = TUBE_HALF (vZ, nHalf);
+			avLow[3] = TUBE_HALF (vNX, nHalf);
+			_MM_TRANSPOSE4_PS (avLow[0], avLow[1], avLow[2], avLow[3]);
+			avHigh[0] = TUBE_HALF (vNY, nHalf);
+			avHigh[1] = TUBE_HALF (vNZ, nHalf);
+			avHigh[2] = vRed;
+			avHigh[3] = vGreen;
+			_MM_TRANSPOSE4_PS (avHigh[0], avHigh[1], avHigh[2], avHigh[3]);
+
+			for (nVertex = 0; nVertex < 4; nVertex++) {
+				_mm_storeu_ps (& asVertex[nSegment + (nHalf * 4) + nVertex].fX, avLow[nVertex]);
+				_mm_storeu_ps (& asVertex[nSegment + (nHalf * 4) + nVertex].fNY, avHigh[nVertex]);
+				asVertex[nSegment + (nHalf * 4) + nVertex].afColour[2] = afColour[2];
+			}
+		}
+	}
+
+	// Any remaining vertices
+	if (nSegment < nSegments) {
+		GenerateRingScalar (asVertex + nSegment, nSegments - nSegment, afSin + nSegment, afCos + nSegment, pvPos, pvAxisSin, pvAxisCos, fRadius, afColour);
+	}
+}
+#endif
+
+// As GenerateRingScalar, but packing each vertex into the compact layout
+// The normal is projected onto an octahedron, and its lower half folded out over the upper half
+// to give two coordinates in the range -1 to 1
+void GenerateRingCompact (CompactVertex * asVertex, int nSegments, float const * afSin, float const * afCos, Vector3 const * pvPos, Vector3 const * pvAxisSin, Vector3 const * pvAxisCos, float fRadius, float const * afColour, TubePersist const * psTubeData) {
+	int nSegment;
+	int nComponent;
+	Vector3 vOffset;
+	Vector3 vVertex;
+	float fSum;
+	float fU;
+	float fV;
+	float fTemp;
+	unsigned char aucColour[4];
+
+	// The colour is the same all of the way around the ring
+	for (nComponent = 0; nComponent < 4; nComponent++) {
+		aucColour[nComponent] = 255;
+	}
+	for (nComponent = 0; nComponent < TUBE_COL_COMPONENTS; nComponent++) {
+		aucColour[nComponent] = (unsigned char)((CLAMP (afColour[nComponent], 0.0f, 1.0f) * 255.0f) + 0.5f);
+	}
+
+	for (nSegment = 0; nSegment < nSegments; nSegment++) {
+		vOffset.fX = (pvAxisSin->fX * afSin[nSegment]) + (pvAxisCos->fX * afCos[nSegment]);
+		vOffset.fY = (pvAxisSin->fY * afSin[nSegment]) + (pvAxisCos->fY * afCos[nSegment]);
+		vOffset.fZ = (pvAxisSin->fZ * afSin[nSegment]) + (pvAxisCos->fZ * afCos[nSegment]);
+
+		vVertex.fX = pvPos->fX + (fRadius * vOffset.fX) - psTubeData->vCompactCentre.fX;
+		vVertex.fY = pvPos->fY + (fRadius * vOffset.fY) - psTubeData->vCompactCentre.fY;
+		vVertex.fZ = pvPos->fZ + (fRadius * vOffset.fZ) - psTubeData->vCompactCentre.fZ;
+		asVertex[nSegment].anPos[0] = QuantiseComponent (vVertex.fX * psTubeData->vCompactScaleInv.fX);
+		asVertex[nSegment].anPos[1] = QuantiseComponent (vVertex.fY * psTubeData->vCompactScaleInv.fY);
+		asVertex[nSegment].anPos[2] = QuantiseComponent (vVertex.fZ * psTubeData->vCompactScaleInv.fZ);
+		asVertex[nSegment].anPos[3] = 1;
+
+		fSum = fabs (vOffset.fX) + fabs (vOffset.fY) + fabs (vOffset.fZ);
+		if (fSum < FRAME_EPSILON) {
+			fSum = 1.0f;
+		}
+		fU = vOffset.fX / fSum;
+		fV = vOffset.fY / fSum;
+		if (vOffset.fZ < 0.0f) {
+			fTemp = fU;
+			fU = (1.0f - fabs (fV)) * ((fTemp >= 0.0f) ? 1.0f : -1.0f);
+			fV = (1.0f - fabs (fTemp)) * ((fV >= 0.0f) ? 1.0f : -1.0f);
+		}
+		asVertex[nSegment].anNormal[0] = QuantiseComponent (fU * COMPACT_RANGE);
+		asVertex[nSegment].anNormal[1] = QuantiseComponent (fV * COMPACT_RANGE);
+
+		memcpy (asVertex[nSegment].aucColour, aucColour, sizeof (aucColour));
+	}
+}
+
+// Round a value to the nearest 16-bit integer within the quantised range
+short QuantiseComponent (float fValue) {
+	return (short)floor (CLAMP (fValue, -COMPACT_RANGE, COMPACT_RANGE) + 0.5f);
+}
+
+// The length of a bezier, found by integrating the speed along the curve using Gauss-Legendre quadrature
+// This doesn't depend on how finely the curve is tessellated, so needs no TubePersist
+float BezierCalculateLength (Vector3 vStart, Vector3 vStartDir, Vector3 vEnd, Vector3 vEndDir) {
+	int nNode;
+	int nSide;
+	float fT;
+	float fS;
+	float fLength;
+	Vector3 vDelta1;
+	Vector3 vDelta2;
+	Vector3 vDelta3;
+	Vector3 vDeriv;
+
+	// The derivative is a quadratic bezier through the differences between the control points
+	vDelta1 = SubtractVectors (& vStartDir, & vStart);
+	vDelta2 = SubtractVectors (& vEndDir, & vStartDir);
+	vDelta3 = SubtractVectors (& vEnd, & vEndDir);
+
+	fLength = 0.0f;
+	for (nNode = 0; nNode < GAUSS_NODES; nNode++) {
+		for (nSide = -1; nSide <= 1; nSide += 2) {
+			// Map the node from [-1, 1] on to [0, 1]
+			fT = 0.5f + (0.5f * (float)nSide * gafGaussNode[nNode]);
+			fS = 1.0f - fT;
+
+			vDeriv.fX = 3.0f * ((fS * fS * vDelta1.fX) + (2.0f * fS * fT * vDelta2.fX) + (fT * fT * vDelta3.fX));
+			vDeriv.fY = 3.0f * ((fS * fS * vDelta1.fY) + (2.0f * fS * fT * vDelta2.fY) + (fT * fT * vDelta3.fY));
+			vDeriv.fZ = 3.0f * ((fS * fS * vDelta1.fZ) + (2.0f * fS * fT * vDelta2.fZ) + (fT * fT * vDelta3.fZ));
+
+			fLength += gafGaussWeight[nNode] * Length (& vDeriv);
+		}
+	}
+
+	// Account for the change of interval
+	return (0.5f * fLength);
+}
+
+// Use De Casteljau's algorithm to split a bezier curve into two subcurves
+void SplitBezier (Vector3 vStart, Vector3 * pvStartDir, Vector3 vEnd, Vector3 * pvEndDir, float fRatio, Vector3 * pvMid, Vector3 * pvMidDirBack, Vector3 * pvMidDirForward) {
+	Vector3 vMid0;
+	Vector3 vMid1;
+	Vector3 vMid2;
+
+	if (pvStartDir && pvEndDir) {
+		vMid0 = SplitLine (vStart, *pvStartDir, fRatio);
+		vMid1 = SplitLine (*pvStartDir, *pvEndDir, fRatio);
+		vMid2 = SplitLine (*pvEndDir, vEnd, fRatio);
+
+		if (pvMidDirBack && pvMidDirForward && pvMid) {
+			*pvMidDirBack = SplitLine (vMid0, vMid1, fRatio);
+			*pvMidDirForward = SplitLine (vMid1, vMid2, fRatio);
+			*pvMid = SplitLine (*pvMidDirBack, *pvMidDirForward, fRatio);
+		}
+		
+		*pvStartDir = vMid0;
+		*pvEndDir = vMid2;
+	}
+}
+
+// Find the point along a line between two points based on a proportion of the distance between them
+Vector3 SplitLine (Vector3 vStart, Vector3 vEnd, float fRatio) {
+	Vector3 vMid;
+	
+	vMid.fX = (vStart.fX * (1.0f - fRatio)) + (vEnd.fX * (fRatio));
+	vMid.fY = (vStart.fY * (1.0f - fRatio)) + (vEnd.fY * (fRatio));
+	vMid.fZ = (vStart.fZ * (1.0f - fRatio)) + (vEnd.fZ * (fRatio));
+	
+	return vMid;
+}
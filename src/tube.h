@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////
+// Tube
+// Tessellate bezier tubes on the CPU
+//
+// David Llewellyn-Jones
+// http://www.flypig.co.uk
+//
+// Summer 2011
+///////////////////////////////////////////////////////////////////
+
+#ifndef TUBE_H
+#define TUBE_H
+
+///////////////////////////////////////////////////////////////////
+// Includes
+
+#include "vector.h"
+
+///////////////////////////////////////////////////////////////////
+// Defines
+
+#define TUBE_COL_COMPONENTS (3)
+
+///////////////////////////////////////////////////////////////////
+// Structures and enumerations
+
+// The tessellation tables and settings shared by every tube
+// Nothing here uses OpenGL, so tubes can be generated on any thread, or without a display at all
+typedef struct _TubePersist TubePersist;
+
+typedef struct _KnotVertex {
+	float fX;
+	float fY;
+	float fZ;
+	float fNX;
+	float fNY;
+	float fNZ;
+	float afColour[TUBE_COL_COMPONENTS];
+	//float fPadding[2];
+} KnotVertex;
+
+// A vertex in the compact layout, which must be decoded by the vertex shader
+// The position is quantised within the bounds, the normal is octahedrally encoded,
+// and the fourth position component is always one so that vertices stay four byte aligned
+typedef struct _CompactVertex {
+	short anPos[4];
+	short anNormal[2];
+	unsigned char aucColour[4];
+} CompactVertex;
+
+// One bezier of a chain, which starts where the previous one ends
+typedef struct _TubeLink {
+	Vector3 vStart;
+	Vector3 vStartDir;
+	Vector3 vEnd;
+	Vector3 vEndDir;
+	float afStartCol[TUBE_COL_COMPONENTS];
+	float afEndCol[TUBE_COL_COMPONENTS];
+} TubeLink;
+
+///////////////////////////////////////////////////////////////////
+// Global variables
+
+///////////////////////////////////////////////////////////////////
+// Function prototypes
+
+TubePersist * NewTubePersist (int nPieces, int nSegments);
+void DeleteTubePersist (TubePersist * psTubeData);
+void SetTubeAccuracy (int nPieces, int nSegments, TubePersist * psTubeData);
+void SetTubeTolerance (float fTolerance, int nPiecesMin, TubePersist * psTubeData);
+void SetTubeTwistStride (int nTwistStride, TubePersist * psTubeData);
+void SetTubeBounds (Vector3 vMin, Vector3 vMax, TubePersist * psTubeData);
+void GetTubeBounds (Vector3 * pvCentre, Vector3 * pvScale, TubePersist const * psTubeData);
+void DecodeCompactVertex (CompactVertex const * psVertex, Vector3 * pvPos, Vector3 * pvNormal, TubePersist const * psTubeData);
+int TubeVertices (int nPieces, TubePersist const * psTubeData);
+int TubePieces (Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, TubePersist const * psTubeData);
+void FindTubeFrame (Vector3 * pvAxis, float * pfTwist, int nPieces, Vector3 const * pvStart, Vector3 const * pvStartDir, Vector3 const * pvEnd, Vector3 const * pvEndDir, TubePersist const * psTubeData);
+void GenerateTube (void * pVertices, bool boCompact, int nPieces, float fRadius, Vector3 vStart, Vector3 vStartDir, Vector3 vEnd, Vector3 vEndDir, float const * afStartCol, float const * afEndCol, TubePersist const * psTubeData);
+void GenerateTubeChain (void * const * apVertices, bool boCompact, bool const * aboWelded, int const * anPieces, int nLinks, TubeLink const * asLink, float fRadius, bool boClosed, TubePersist const * psTubeData);
+void SplitBezier (Vector3 vStart, Vector3 * pvStartDir, Vector3 vEnd, Vector3 * pvEndDir, float fRatio, Vector3 * pvMid, Vector3 * pvMidDirBack, Vector3 * pvMidDirForward);
+Vector3 SplitLine (Vector3 vStart, Vector3 vEnd, float fRatio);
+float BezierCalculateLength (Vector3 vStart, Vector3 vStartDir, Vector3 vEnd, Vector3 vEndDir);
+
+///////////////////////////////////////////////////////////////////
+// Function definitions
+
+#endif /* TUBE_H */
+
@@ -1,6 +1,6 @@
 ///////////////////////////////////////////////////////////////////
-// Utils
-// Generally useful definitions, structures, functions, etc.
+// Vector
+// Three dimensional vectors and matrices
 //
 // David Llewellyn-Jones
 // Liverpool John Moores University
@@ -12,7 +12,10 @@
 ///////////////////////////////////////////////////////////////////
 // Includes
 
-#include "utils.h"
+#include <stdio.h>
+#include <glib.h>
+
+#include "vector.h"
 
 ///////////////////////////////////////////////////////////////////
 // Defines
@@ -212,6 +215,10 @@ Vector3 CrossProduct (Vector3 * v1, Vector3 * v2) {
 	return vResult;
 }
 
+float DotProduct (Vector3 const * v1, Vector3 const * v2) {
+	return (v1->fX * v2->fX) + (v1->fY * v2->fY) + (v1->fZ * v2->fZ);
+}
+
 Matrix3 MultMatrixMatrix (Matrix3 * m1, Matrix3 * m2) {
 	Matrix3 mResult;
 	
@@ -303,29 +310,29 @@ Vector3 PerpendicularVector (Vector3 * pvVector) {
 	Vector3 vOrth;
 	int nDim;
 	int nDimMin;
-	GLfloat fMin;
+	float fMin;
 	
 	vVector = * pvVector;
 	Normalise (& vVector);
 
 	// Choose the dimension vector that's smallest
 	nDimMin = 0;
-	fMin = ((GLfloat *)& vVector)[nDimMin];
+	fMin = ((float *)& vVector)[nDimMin];
 	for (nDim = 1; nDim < 3; nDim++) {
-		if (absf(((GLfloat *)& vVector)[nDim]) < fMin) {
+		if (absf(((float *)& vVector)[nDim]) < fMin) {
 			nDimMin = nDim;
-			fMin = absf(((GLfloat *)& vVector)[nDim]);
+			fMin = absf(((float *)& vVector)[nDim]);
 		}
 	}
 
-	fMin = ((GLfloat *)& vVector)[nDimMin];
+	fMin = ((float *)& vVector)[nDimMin];
 	vOrth.fX = 0.0f;
 	vOrth.fY = 0.0f;
 	vOrth.fZ = 0.0f;
-	((GLfloat *)& vOrth)[nDimMin] = 1.0f;
+	((float *)& vOrth)[nDimMin] = 1.0f;
 	
 	for (nDim = 0; nDim < 3; nDim++) {
-		((GLfloat *)& vOrth)[nDim] -= fMin * ((GLfloat *)& vVector)[nDim];
+		((float *)& vOrth)[nDim] -= fMin * ((float *)& vVector)[nDim];
 	}
 
 	Normalise (& vOrth);
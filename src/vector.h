@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////
+// Vector
+// Three dimensional vectors and matrices
+// Nothing here uses OpenGL or GTK, so it can be used by code that runs without a display
+//
+// David Llewellyn-Jones
+// Liverpool John Moores University
+//
+// Spring 2008
+///////////////////////////////////////////////////////////////////
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+///////////////////////////////////////////////////////////////////
+// Includes
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+///////////////////////////////////////////////////////////////////
+// Defines
+
+#define SetVector3(SET, X, Y, Z) (SET).fX = (X); (SET).fY = (Y); (SET).fZ = (Z);
+
+///////////////////////////////////////////////////////////////////
+// Structures and enumerations
+
+typedef int bool;
+
+typedef struct _Vector3 {
+	float fX;
+	float fY;
+	float fZ;
+} Vector3;
+
+// [ a1 b1 c1 ]
+// [ a2 b2 c2 ]
+// [ a3 b3 c3 ]
+typedef struct _Matrix3 {
+	float fA1;
+	float fA2;
+	float fA3;
+	float fB1;
+	float fB2;
+	float fB3;
+	float fC1;
+	float fC2;
+	float fC3;
+} Matrix3;
+
+///////////////////////////////////////////////////////////////////
+// Global variables
+
+///////////////////////////////////////////////////////////////////
+// Function prototypes
+
+float absf (float fValue);
+Vector3 Normal (Vector3 * v1, Vector3 * v2);
+Vector3 AddVectors (Vector3 const * v1, Vector3 const * v2);
+Vector3 SubtractVectors (Vector3 const * v1, Vector3 const * v2);
+Vector3 MultiplyVectors (Vector3 const * v1, Vector3 const * v2);
+Vector3 ScaleVector (Vector3 const * v1, float fScale);
+void Normalise (Vector3 * v1);
+void Normalise3f (float * pfX, float * pfY, float * pfZ);
+float Length (Vector3 * v1);
+Matrix3 Invert (Matrix3 * m1);
+float Determinant (Matrix3 * m1);
+float DotProdAngle (float fX1, float fY1, float fX2, float fY2);
+float DotProdAngleVector (Vector3 * v1, Vector3 * v2);
+Vector3 MultMatrixVector (Matrix3 * m1, Vector3 * v1);
+void PrintMatrix (Matrix3 * m1);
+void PrintVector (Vector3 * v1);
+Vector3 CrossProduct (Vector3 * v1, Vector3 * v2);
+float DotProduct (Vector3 const * v1, Vector3 const * v2);
+Matrix3 MultMatrixMatrix (Matrix3 * m1, Matrix3 * m2);
+void SetIdentity (Matrix3 * m1);
+Matrix3 RotationBetweenVectors (Vector3 * v1, Vector3 * v2);
+Matrix3 RotationAngleAxis (Vector3 * vAxis, float fAngle);
+Vector3 PerpendicularVector (Vector3 * pvVector);
+
+///////////////////////////////////////////////////////////////////
+// Function definitions
+
+#endif /* VECTOR_H */
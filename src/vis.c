@@ -43,6 +43,7 @@
 #define SELBUFSIZE					(512)
 
 #define VIEW_RADIUS					(15.0f)
+#define VIEW_ANGLE					(60.0f)
 
 #define TEXT_FONT						(GLUT_BITMAP_HELVETICA_10)
 #define TEXT_XOFF						(12)
@@ -57,6 +58,9 @@
 
 #define TUBE_PIECES 				(10)
 #define TUBE_SEGMENTS 			(24)
+#define TUBE_TOLERANCE 			(0.01f)
+#define TUBE_PIECES_MIN 		(2)
+#define TUBE_LEVELS 				(3)
 
 #define NUMBER_STRING_MAX (16)
 #define LINEHEIGHT (12)
@@ -114,6 +118,7 @@ struct _VisPersist {
 	bool boClearWhite;
 	bool aboKeyDown[MAXKEYS];
 	bool boDebug;
+	bool boShaderTubes;
 	float fMomentum;
 	float fXMomentum;
 	float fYMomentum;
@@ -125,18 +130,9 @@ struct _VisPersist {
 	BezPersist * psBezData;
 	CelticPersist * psCelticData;
 	ShaderPersist * psShaderData;
+	TaskPersist * psTaskData;
 };
 
-typedef struct _KnotVertex {
-	float fX;
-	float fY;
-	float fZ;
-	float fNX;
-	float fNY;
-	float fNZ;
-	//float fPadding[2];
-} KnotVertex;
-
 ///////////////////////////////////////////////////////////////////
 // Global variables
 
@@ -193,6 +189,7 @@ VisPersist * NewVisPersist (void) {
 	psVisData->boFullScreen = false;
 	psVisData->boClearWhite = false;
 	psVisData->boDebug = false;
+	psVisData->boShaderTubes = false;
 
 	psVisData->fMomentum = 0.0f;
 	psVisData->fXMomentum = 0.0f;
@@ -203,9 +200,12 @@ VisPersist * NewVisPersist (void) {
 	
 	psVisData->psBezData = NULL;
 	
+	// Every knot shares the same worker threads
+	psVisData->psTaskData = NewTaskPersist ();
+
 	psVisData->nDimensions = 2;
-	//psVisData->psCelticData = NewCelticPersist3D (3, 4, 3, 3.0f, 3.0f, 3.0f, psVisData->psBezData);
-	psVisData->psCelticData = NewCelticPersist2D (5, 6, 3.0f, 3.0f, psVisData->psBezData);
+	//psVisData->psCelticData = NewCelticPersist3D (3, 4, 3, 3.0f, 3.0f, 3.0f, psVisData->psTaskData, psVisData->psBezData);
+	psVisData->psCelticData = NewCelticPersist2D (5, 6, 3.0f, 3.0f, psVisData->psTaskData, psVisData->psBezData);
 	SetDepth (5, psVisData->psCelticData);
 	SetTileZ (3.0f, psVisData->psCelticData);
 	psVisData->psShaderData = NULL;
@@ -229,6 +229,11 @@ void DeleteVisPersist (VisPersist * psVisData) {
 		psVisData->psShaderData = NULL;
 	}
 
+	if (psVisData->psTaskData) {
+		DeleteTaskPersist (psVisData->psTaskData);
+		psVisData->psTaskData = NULL;
+	}
+
 	g_free (psVisData);
 }
 
@@ -237,6 +242,10 @@ void Realise (VisPersist * psVisData) {
 	GLfloat light_diffuse[] = { 1.0, 1.0, 1.0, 1.0, 0.5, 0.3, 0.0, 1.0 };
 	GLfloat light_specular[] = { 1.0, 1.0, 1.0, 1.0, 0.3, 0.5, 1.0, 0.0 };
 	GLfloat light_position[] = { 1.0, 1.0, 1.0, 0.0, 1.0, 1.0, 1.0, 0.0 };
+	// Tessellations used as the tubes get smaller on screen, with the tube radius in pixels below which each is used
+	int const anLevelSegments[TUBE_LEVELS] = { TUBE_SEGMENTS, 12, 6 };
+	int const anLevelPieces[TUBE_LEVELS] = { TUBE_PIECES, 6, 4 };
+	float const afLevelPixels[TUBE_LEVELS] = { 0.0f, 6.0f, 2.0f };
 
 	gluLookAt (0.0, VIEW_RADIUS, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0);
 
@@ -268,6 +277,14 @@ void Realise (VisPersist * psVisData) {
 	InitShaders (psVisData);
 
 	psVisData->psBezData = NewBezPersist (TUBE_PIECES, TUBE_SEGMENTS);
+	SetBezierShader (GetShaderProgram (psVisData->psShaderData), psVisData->psBezData);
+	// Tubes are tessellated on the CPU unless the settings ask for the shader to generate them,
+	// as the CPU tubes can be welded, copied and drawn at coarser levels
+	SetBezierInstanced (psVisData->boShaderTubes, psVisData->psBezData);
+	SetBezierCompact (TRUE, psVisData->psBezData);
+	SetBezierWeld (TRUE, psVisData->psBezData);
+	SetBezierTolerance (TUBE_TOLERANCE, TUBE_PIECES_MIN, psVisData->psBezData);
+	SetBezierDetailLevels (TUBE_LEVELS, anLevelSegments, anLevelPieces, afLevelPixels, psVisData->psBezData);
 	SetCelticBezData (psVisData->psBezData, psVisData->psCelticData);
 
 	//psVisData->psCelticData = NewCelticPersist (7, 7, 10, 10);
@@ -372,6 +389,9 @@ void DeleteDisplayLists (VisPersist * psVisData) {
 }
 
 void Render (VisPersist * psVisData) {
+	Vector3 vEye;
+	float fPixelScale;
+
 	glLoadIdentity ();
 	gluLookAt ((psVisData->fViewRadius) * psVisData->fX, (psVisData->fViewRadius) * psVisData->fY, (psVisData->fViewRadius) * psVisData->fZ, 0.0, 0.0, 0.0, psVisData->fXn, psVisData->fYn, psVisData->fZn);
 
@@ -381,6 +401,10 @@ void Render (VisPersist * psVisData) {
 
 	DrawObject (0.0, 0.0, 0.0, psVisData);
 
+	// The detail used for the tubes depends on how large they appear on screen
+	SetVector3 (vEye, (psVisData->fViewRadius) * psVisData->fX, (psVisData->fViewRadius) * psVisData->fY, (psVisData->fViewRadius) * psVisData->fZ);
+	fPixelScale = (float)psVisData->nScreenHeight / (2.0f * tan (VIEW_ANGLE * M_PI / 360.0f));
+	SetBezierView (vEye, fPixelScale, psVisData->psBezData);
 	DisplayBeziers (psVisData->psBezData);
 
 	glFlush ();
@@ -414,7 +438,7 @@ void SelectVisObject (SelectInfo * psSelectData, VisPersist * psVisData) {
 	glLoadIdentity ();
 	gluPickMatrix (psSelectData->nXPos, anViewPort[3] - psSelectData->nYPos, 1, 1, anViewPort);
 
-	gluPerspective (60, (float)psVisData->nScreenWidth / (float)psVisData->nScreenHeight, 1, 100);
+	gluPerspective (VIEW_ANGLE, (float)psVisData->nScreenWidth / (float)psVisData->nScreenHeight, 1, 100);
 	glMatrixMode (GL_MODELVIEW);
 	glPushMatrix ();
 	glLoadIdentity ();
@@ -560,7 +584,7 @@ void Reshape (int nWidth, int nHeight, VisPersist * psVisData) {
 		psVisData->nPrevScreenHeight = psVisData->nScreenHeight;
 	}
 
-	gluPerspective (60, (float)nWidth / (float)nHeight, 1, 100);
+	gluPerspective (VIEW_ANGLE, (float)nWidth / (float)nHeight, 1, 100);
 	glMatrixMode (GL_MODELVIEW);
 	glLoadIdentity ();
 }
@@ -682,7 +706,7 @@ void SetDimensions (int nDimensions, VisPersist * psVisData) {
 		switch (nDimensions) {
 		case 2:
 			psVisData->nDimensions = nDimensions;
-			psCelticData = NewCelticPersist2D (3, 3, 3.0f, 3.0f, psVisData->psBezData);
+			psCelticData = NewCelticPersist2D (3, 3, 3.0f, 3.0f, psVisData->psTaskData, psVisData->psBezData);
 			CopyCelticPersistParams (psVisData->psCelticData, psCelticData);
 			DeleteCelticPersist (psVisData->psCelticData);
 			psVisData->psCelticData = psCelticData;
@@ -690,7 +714,7 @@ void SetDimensions (int nDimensions, VisPersist * psVisData) {
 			break;
 		case 3:
 			psVisData->nDimensions = nDimensions;
-			psCelticData = NewCelticPersist3D (3, 4, 3, 3.0f, 3.0f, 3.0f, psVisData->psBezData);
+			psCelticData = NewCelticPersist3D (3, 4, 3, 3.0f, 3.0f, 3.0f, psVisData->psTaskData, psVisData->psBezData);
 			CopyCelticPersistParams (psVisData->psCelticData, psCelticData);
 			DeleteCelticPersist (psVisData->psCelticData);
 			psVisData->psCelticData = psCelticData;
@@ -800,14 +824,16 @@ void Key (unsigned char key, int x, int y, unsigned int uKeyModifiers, VisPersis
 			uSeed++;
 			//uSeed = GetRandomSeed ();
 			SetColourSeed (uSeed, psVisData->psCelticData);
-			GenerateKnot (psVisData->psCelticData);
-			RenderKnots (psVisData->psCelticData);
+			if (RecolourKnots (psVisData->psCelticData)) {
+				RenderKnots (psVisData->psCelticData);
+			}
 			break;
 		case 'z':
 			// Set colour seed to zero;
 			SetColourSeed (0, psVisData->psCelticData);
-			GenerateKnot (psVisData->psCelticData);
-			RenderKnots (psVisData->psCelticData);
+			if (RecolourKnots (psVisData->psCelticData)) {
+				RenderKnots (psVisData->psCelticData);
+			}
 			break;
 		case 'x':
 			// New knot seed;
@@ -964,6 +990,7 @@ void SaveSettingsVis (SettingsPersist * psSettingsData, VisPersist * psVisData)
 	SettingsPrintBool (psSettingsData, "FullScreen", psVisData->boFullScreen);
 	SettingsPrintBool (psSettingsData, "ClearWhite", psVisData->boClearWhite);
 	SettingsPrintBool (psSettingsData, "Debug", psVisData->boDebug);
+	SettingsPrintBool (psSettingsData, "ShaderTubes", psVisData->boShaderTubes);
 	SettingsPrintFloat (psSettingsData, "ViewRadius", psVisData->fViewRadius);
 	SettingsPrintFloat (psSettingsData, "ViewX", psVisData->fX);
 	SettingsPrintFloat (psSettingsData, "ViewY", psVisData->fY);
@@ -1012,6 +1039,9 @@ void VisLoadProperty (SETTINGTYPE const eType, char const * szName, void const *
 		else if (stricmp (szName, "Debug") == 0) {
 			psVisData->boDebug = *((bool*)(psValue));
 		}
+		else if (stricmp (szName, "ShaderTubes") == 0) {
+			psVisData->boShaderTubes = *((bool*)(psValue));
+		}
 	case SETTINGTYPE_FLOAT:
 		if (stricmp (szName, "ViewRadius") == 0) {
 			psVisData->fViewRadius = *((float*)(psValue));
@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////
+// Test Export
+// Check that exported numbers are formatted exactly as printf formats them
+//
+// David Llewellyn-Jones
+// http://www.flypig.co.uk
+///////////////////////////////////////////////////////////////////
+
+
+///////////////////////////////////////////////////////////////////
+// Includes
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <limits.h>
+#include <glib.h>
+
+#include "export.h"
+
+///////////////////////////////////////////////////////////////////
+// Defines
+
+// Number of floats with random bit patterns to check at each number of decimal places
+#define TEST_RANDOM_FLOATS (200000)
+
+///////////////////////////////////////////////////////////////////
+// Function prototypes
+
+float FloatFromBits (guint32 uBits);
+int CheckFloat (float fValue, int nPlaces);
+int CheckInt (int nValue);
+
+///////////////////////////////////////////////////////////////////
+// Function definitions
+
+float FloatFromBits (guint32 uBits) {
+	float fValue;
+
+	memcpy (& fValue, & uBits, sizeof (fValue));
+
+	return fValue;
+}
+
+// Returns the number of mismatches, which is zero or one
+int CheckFloat (float fValue, int nPlaces) {
+	char szExpected[512];
+	char szActual[EXPORT_NUMBER_MAX + 1];
+	char * pcEnd;
+
+	snprintf (szExpected, sizeof (szExpected), "%.*f", nPlaces, (double)fValue);
+	pcEnd = FormatExportFloat (szActual, fValue, nPlaces);
+	* pcEnd = '\0';
+
+	if (((pcEnd - szActual) >= EXPORT_NUMBER_MAX) || (strcmp (szExpected, szActual) != 0)) {
+		fprintf (stderr, "FormatExportFloat: %a with %d places: expected \"%s\", got \"%s\"\n", (double)fValue, nPlaces, szExpected, szActual);
+		return 1;
+	}
+
+	return 0;
+}
+
+int CheckInt (int nValue) {
+	char szExpected[32];
+	char szActual[32];
+	char * pcEnd;
+
+	snprintf (szExpected, sizeof (szExpected), "%d", nValue);
+	pcEnd = FormatExportInt (szActual, nValue);
+	* pcEnd = '\0';
+
+	if (strcmp (szExpected, szActual) != 0) {
+		fprintf (stderr, "FormatExportInt: expected \"%s\", got \"%s\"\n", szExpected, szActual);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main (int argc, char * argv[]) {
+	float const afEdge[] = {
+		0.0f, 1.0f, 0.5f, 1.5f, 2.5f, 0.125f, 0.375f, 0.0625f, 9.9999995f, 99.99999f, 0.99999994f,
+		0.1f, 0.05f, 0.005f, 0.0005f, 5.0e-10f, 1.0e-10f, 123456.789f, 16777215.0f, 16777216.0f, 16777217.0f,
+		4294967296.0f, 9.2233720e18f, 1.0e18f, 9.9999998e17f, 1.0e19f, 1.0e20f, 1.8446744e19f, 3.0e38f,
+		FLT_MAX, FLT_MIN, FLT_EPSILON, 1.0e-45f
+	};
+	int const anInt[] = { 0, 1, -1, 9, 10, 255, -255, 123456789, INT_MAX, INT_MIN };
+	int nFailures;
+	int nPlaces;
+	int nValue;
+	int nRandom;
+	guint32 uBits;
+
+	nFailures = 0;
+	for (nPlaces = 0; nPlaces <= EXPORT_PLACES_MAX; nPlaces++) {
+		// Each edge case, both positive and negative, including negative zero
+		for (nValue = 0; nValue < (int)(sizeof (afEdge) / sizeof (float)); nValue++) {
+			nFailures += CheckFloat (afEdge[nValue], nPlaces);
+			nFailures += CheckFloat (-afEdge[nValue], nPlaces);
+		}
+
+		nFailures += CheckFloat (FloatFromBits (0x7f800000u), nPlaces);
+		nFailures += CheckFloat (FloatFromBits (0xff800000u), nPlaces);
+		nFailures += CheckFloat (FloatFromBits (0x7fc00000u), nPlaces);
+		nFailures += CheckFloat (FloatFromBits (0xffc00000u), nPlaces);
+
+		// Floats of every magnitude, picked by their bits
+		srand (nPlaces + 1);
+		for (nRandom = 0; nRandom < TEST_RANDOM_FLOATS; nRandom++) {
+			uBits = ((guint32)(rand () & 0xffff) << 16) | (guint32)(rand () & 0xffff);
+			nFailures += CheckFloat (FloatFromBits (uBits), nPlaces);
+		}
+	}
+
+	for (nValue = 0; nValue < (int)(sizeof (anInt) / sizeof (int)); nValue++) {
+		nFailures += CheckInt (anInt[nValue]);
+	}
+
+	printf ("FormatExportFloat and FormatExportInt: %s\n", (nFailures == 0) ? "pass" : "FAIL");
+
+	return (nFailures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////
+// Test Tube
+// Check that the vectorised ring generators match the scalar one
+//
+// David Llewellyn-Jones
+// http://www.flypig.co.uk
+///////////////////////////////////////////////////////////////////
+
+
+///////////////////////////////////////////////////////////////////
+// Includes
+
+// The ring generators are internal to the tube module
+#include "../src/tube.c"
+
+///////////////////////////////////////////////////////////////////
+// Defines
+
+// Largest number of segments in a ring to test
+#define TEST_SEGMENTS_MAX (40)
+
+// Number of random rings to generate for each number of segments
+#define TEST_RINGS (64)
+
+// Largest difference allowed between a vectorised and a scalar component
+#define TEST_TOLERANCE (1.0e-5f)
+
+///////////////////////////////////////////////////////////////////
+// Function prototypes
+
+float RandomRange (float fMin, float fMax);
+Vector3 RandomVector (float fMin, float fMax);
+int CompareRings (KnotVertex const * asExpected, KnotVertex const * asActual, int nSegments, char const * szName);
+int TestRingGenerator (RingGenerator GenerateRing, char const * szName);
+
+///////////////////////////////////////////////////////////////////
+// Function definitions
+
+float RandomRange (float fMin, float fMax) {
+	return fMin + ((fMax - fMin) * ((float)rand () / (float)RAND_MAX));
+}
+
+Vector3 RandomVector (float fMin, float fMax) {
+	Vector3 vVector;
+
+	vVector.fX = RandomRange (fMin, fMax);
+	vVector.fY = RandomRange (fMin, fMax);
+	vVector.fZ = RandomRange (fMin, fMax);
+
+	return vVector;
+}
+
+// Returns the number of components that differ by more than the tolerance
+int CompareRings (KnotVertex const * asExpected, KnotVertex const * asActual, int nSegments, char const * szName) {
+	int nSegment;
+	int nComponent;
+	int nFailures;
+	float const * afExpected;
+	float const * afActual;
+
+	nFailures = 0;
+	for (nSegment = 0; nSegment < nSegments; nSegment++) {
+		afExpected = & asExpected[nSegment].fX;
+		afActual = & asActual[nSegment].fX;
+		for (nComponent = 0; nComponent < (int)(sizeof (KnotVertex) / sizeof (float)); nComponent++) {
+			if (!(fabs (afExpected[nComponent] - afActual[nComponent]) <= TEST_TOLERANCE)) {
+				fprintf (stderr, "%s: segment %d of %d, component %d: expected %f, got %f\n", szName, nSegment, nSegments, nComponent, afExpected[nComponent], afActual[nComponent]);
+				nFailures++;
+			}
+		}
+	}
+
+	return nFailures;
+}
+
+// Generate random rings of every size up to the maximum with both generators and compare them
+int TestRingGenerator (RingGenerator GenerateRing, char const * szName) {
+	int nSegments;
+	int nSegment;
+	int nRing;
+	int nFailures;
+	float afSin[TEST_SEGMENTS_MAX];
+	float afCos[TEST_SEGMENTS_MAX];
+	float afColour[TUBE_COL_COMPONENTS];
+	KnotVertex asExpected[TEST_SEGMENTS_MAX];
+	KnotVertex asActual[TEST_SEGMENTS_MAX + 1];
+	Vector3 vPos;
+	Vector3 vAxisSin;
+	Vector3 vAxisCos;
+	float fRadius;
+
+	nFailures = 0;
+	for (nSegments = 1; nSegments <= TEST_SEGMENTS_MAX; nSegments++) {
+		for (nSegment = 0; nSegment < nSegments; nSegment++) {
+			afSin[nSegment] = sin ((2.0 * M_PI * nSegment) / nSegments);
+			afCos[nSegment] = cos ((2.0 * M_PI * nSegment) / nSegments);
+		}
+
+		for (nRing = 0; nRing < TEST_RINGS; nRing++) {
+			vPos = RandomVector (-10.0f, 10.0f);
+			vAxisSin = RandomVector (-1.0f, 1.0f);
+			Normalise (& vAxisSin);
+			vAxisCos = PerpendicularVector (& vAxisSin);
+			Normalise (& vAxisCos);
+			fRadius = RandomRange (0.01f, 2.0f);
+			afColour[0] = RandomRange (0.0f, 1.0f);
+			afColour[1] = RandomRange (0.0f, 1.0f);
+			afColour[2] = RandomRange (0.0f, 1.0f);
+
+			// The vertex after the ring must be left untouched
+			memset (asActual, 0, sizeof (asActual));
+			GenerateRingScalar (asExpected, nSegments, afSin, afCos, & vPos, & vAxisSin, & vAxisCos, fRadius, afColour);
+			GenerateRing (asActual, nSegments, afSin, afCos, & vPos, & vAxisSin, & vAxisCos, fRadius, afColour);
+
+			nFailures += CompareRings (asExpected, asActual, nSegments, szName);
+			if ((asActual[nSegments].fX != 0.0f) || (asActual[nSegments].afColour[2] != 0.0f)) {
+				fprintf (stderr, "%s: wrote past the end of a ring of %d segments\n", szName, nSegments);
+				nFailures++;
+			}
+		}
+	}
+
+	printf ("%s: %s\n", szName, (nFailures == 0) ? "pass" : "FAIL");
+
+	return nFailures;
+}
+
+int main (int argc, char * argv[]) {
+	int nFailures;
+
+	srand (1);
+	nFailures = 0;
+
+#if defined(TUBE_AVX2)
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("avx2")) {
+		nFailures += TestRingGenerator (GenerateRingAVX2, "GenerateRingAVX2");
+	}
+	else {
+		printf ("GenerateRingAVX2: skipped, not supported by this processor\n");
+	}
+	if (__builtin_cpu_supports ("sse2")) {
+		nFailures += TestRingGenerator (GenerateRingSSE2, "GenerateRingSSE2");
+	}
+	else {
+		printf ("GenerateRingSSE2: skipped, not supported by this processor\n");
+	}
+#elif defined(TUBE_SSE2)
+	nFailures += TestRingGenerator (GenerateRingSSE2, "GenerateRingSSE2");
+#endif
+
+	// Whichever generator is chosen at run time must match too
+	nFailures += TestRingGenerator (SelectRingGenerator (), "SelectRingGenerator");
+
+	return (nFailures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}